@@ -48,6 +48,7 @@
 
 #if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
 #include <linux/iomonitor/iomonitor.h>
+#include <linux/iomonitor/iolat.h>
 #endif /*OPLUS_FEATURE_IOMONITOR*/
 
 #if defined(OPLUS_FEATURE_SCHED_ASSIST) && defined(CONFIG_OPLUS_FEATURE_UXIO_FIRST)
@@ -1494,6 +1495,7 @@ static struct request *__get_request(struct request_list *rl, unsigned int op,
 		ioc->nr_batch_requests--;
 #if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
 	iomonitor_init_reqstats(rq);
+	rq->req_uid = iomonitor_iolat_uid();
 #endif /*OPLUS_FEATURE_IOMONITOR*/
 	trace_block_getrq(q, bio, op);
 	return rq;
@@ -3135,6 +3137,8 @@ bool blk_update_request(struct request *req, blk_status_t error,
 	trace_block_rq_complete(req, blk_status_to_errno(error), nr_bytes);
 #if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
 	iomonitor_record_reqstats(req, nr_bytes);
+	if (nr_bytes >= blk_rq_bytes(req))
+		iomonitor_record_iolat(req);
 #endif /*OPLUS_FEATURE_IOMONITOR*/
 
 	if (!req->bio)
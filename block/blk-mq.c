@@ -37,6 +37,10 @@
 #include "blk-mq-sched.h"
 #include "blk-rq-qos.h"
 
+#if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
+#include <linux/iomonitor/iolat.h>
+#endif /*OPLUS_FEATURE_IOMONITOR*/
+
 static bool blk_mq_poll(struct request_queue *q, blk_qc_t cookie);
 static void blk_mq_poll_stats_start(struct request_queue *q);
 static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb);
@@ -311,6 +315,10 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	rq->part = NULL;
 	rq->start_time_ns = ktime_get_ns();
 	rq->io_start_time_ns = 0;
+#if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
+	rq->req_td = 0;
+	rq->req_uid = iomonitor_iolat_uid();
+#endif /*OPLUS_FEATURE_IOMONITOR*/
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
 	rq->nr_integrity_segments = 0;
@@ -640,6 +648,9 @@ void blk_mq_start_request(struct request *rq)
 
 	blk_mq_sched_started_request(rq);
 
+#if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
+	rq->req_td = ktime_get();
+#endif /*OPLUS_FEATURE_IOMONITOR*/
 	trace_block_rq_issue(q, rq);
 
 	if (test_bit(QUEUE_FLAG_STATS, &q->queue_flags)) {
@@ -0,0 +1,555 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * MQ Anxiety I/O Scheduler
+ *
+ * blk-mq port of the Anxiety scheduler. Requests are split into UX, sync
+ * and async queues per hardware queue. UX requests go first, sync requests
+ * are batched over async ones and both lower classes get a bounded share so
+ * nothing starves. The sync batch grows while foreground read latency is
+ * over target and shrinks back once it is comfortably under. Bios merge
+ * into queued requests through the elevator hash, as with mq-deadline.
+ *
+ * Copyright (c) 2020, Tyler Nijmeh <tylernij@gmail.com>
+ */
+
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/elevator.h>
+#include <linux/llist.h>
+#include <linux/module.h>
+#include <linux/sbitmap.h>
+#include <linux/slab.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+#include "blk-mq-tag.h"
+
+/* Minimum sync requests dispatched for each async one */
+#define	DEFAULT_SYNC_RATIO	(8)
+
+/* Sync batch may grow up to sync_ratio times this */
+#define DEFAULT_BATCH_COUNT	(4)
+
+/* UX requests dispatched for each sync one while both are waiting */
+#define DEFAULT_UX_RATIO	(16)
+
+/* Foreground read latency target */
+#define DEFAULT_TARGET_LAT_NSEC	(2 * NSEC_PER_MSEC)
+
+/* Share of the scheduler tags async requests may hold */
+#define ASYNC_PERCENT		(75)
+
+/* Completions between two batch size adjustments */
+#define ADJUST_SAMPLES		(8)
+
+enum {
+	ANXIETY_HEAD,
+	ANXIETY_UX,
+	ANXIETY_SYNC,
+	ANXIETY_ASYNC,
+	ANXIETY_NR_QUEUES,
+};
+
+struct anxiety_data {
+	/* Tunables */
+	unsigned int sync_ratio;
+	unsigned int batch_count;
+	unsigned int ux_ratio;
+	u64 target_lat_nsec;
+
+	/* Current sync batch, in [sync_ratio, sync_ratio * batch_count] */
+	unsigned int batch;
+	u64 lat_avg;
+	atomic_t lat_samples;
+
+	unsigned int async_depth;
+
+	/*
+	 * Protects the FIFO queues of every hctx along with the elevator hash
+	 * and q->last_merge, which are shared by the whole queue.
+	 */
+	spinlock_t lock;
+};
+
+struct anxiety_hctx_data {
+	/*
+	 * Insertion is lock-free: requests are pushed onto the pending lists
+	 * through rq->csd.llist, which is unused until the request has been
+	 * dispatched. They are moved onto the FIFO queues under the lock,
+	 * and only there do they become merge candidates.
+	 */
+	struct llist_head pending[ANXIETY_NR_QUEUES];
+
+	struct list_head queue[ANXIETY_NR_QUEUES];
+
+	/* Dispatches that skipped a waiting async / sync request */
+	unsigned int async_starved;
+	unsigned int sync_starved;
+};
+
+static inline bool anxiety_rq_is_ux(struct request *rq)
+{
+#ifdef OPLUS_FEATURE_SCHED_ASSIST
+	return rq->cmd_flags & REQ_UX;
+#else
+	return false;
+#endif
+}
+
+static inline int anxiety_rq_queue(struct request *rq, bool at_head)
+{
+	if (unlikely(at_head))
+		return ANXIETY_HEAD;
+
+	if (anxiety_rq_is_ux(rq))
+		return ANXIETY_UX;
+
+	return rq_is_sync(rq) ? ANXIETY_SYNC : ANXIETY_ASYNC;
+}
+
+static void anxiety_insert_requests(struct blk_mq_hw_ctx *hctx,
+		struct list_head *rq_list, bool at_head)
+{
+	struct anxiety_hctx_data *ahd = hctx->sched_data;
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, rq_list, queuelist) {
+		list_del_init(&rq->queuelist);
+		blk_mq_sched_request_inserted(rq);
+		llist_add(&rq->csd.llist,
+			&ahd->pending[anxiety_rq_queue(rq, at_head)]);
+	}
+}
+
+/* Must hold adata->lock */
+static void anxiety_flush_pending(struct request_queue *q,
+		struct anxiety_hctx_data *ahd)
+{
+	struct llist_node *node;
+	struct request *rq, *next;
+	LIST_HEAD(head);
+	int i;
+
+	/* Head insertions keep their LIFO order and go in front */
+	node = llist_del_all(&ahd->pending[ANXIETY_HEAD]);
+	llist_for_each_entry_safe(rq, next, node, csd.llist)
+		list_add_tail(&rq->queuelist, &head);
+	list_splice(&head, &ahd->queue[ANXIETY_HEAD]);
+
+	for (i = ANXIETY_UX; i < ANXIETY_NR_QUEUES; i++) {
+		node = llist_del_all(&ahd->pending[i]);
+		if (!node)
+			continue;
+
+		node = llist_reverse_order(node);
+		llist_for_each_entry_safe(rq, next, node, csd.llist) {
+			list_add_tail(&rq->queuelist, &ahd->queue[i]);
+			if (rq_mergeable(rq)) {
+				elv_rqhash_add(q, rq);
+				if (!q->last_merge)
+					q->last_merge = rq;
+			}
+		}
+	}
+}
+
+/* Must hold adata->lock */
+static void anxiety_remove_request(struct request_queue *q, struct request *rq)
+{
+	list_del_init(&rq->queuelist);
+	elv_rqhash_del(q, rq);
+	if (q->last_merge == rq)
+		q->last_merge = NULL;
+}
+
+static inline struct request *anxiety_next_entry(struct request_queue *q,
+		struct list_head *queue)
+{
+	struct request *rq = list_first_entry(queue, struct request,
+		queuelist);
+
+	anxiety_remove_request(q, rq);
+
+	return rq;
+}
+
+/* Must hold adata->lock */
+static struct request *__anxiety_dispatch(struct request_queue *q,
+		struct anxiety_data *adata, struct anxiety_hctx_data *ahd)
+{
+	bool ux = !list_empty(&ahd->queue[ANXIETY_UX]);
+	bool sync = !list_empty(&ahd->queue[ANXIETY_SYNC]);
+	bool async = !list_empty(&ahd->queue[ANXIETY_ASYNC]);
+
+	if (!list_empty(&ahd->queue[ANXIETY_HEAD]))
+		return anxiety_next_entry(q, &ahd->queue[ANXIETY_HEAD]);
+
+	/* Submit one async request after each sync batch to avoid starvation */
+	if (async && ahd->async_starved >= READ_ONCE(adata->batch)) {
+		ahd->async_starved = 0;
+		return anxiety_next_entry(q, &ahd->queue[ANXIETY_ASYNC]);
+	}
+
+	if (ux && !(sync && ahd->sync_starved >= adata->ux_ratio)) {
+		ahd->async_starved += async;
+		ahd->sync_starved += sync;
+		return anxiety_next_entry(q, &ahd->queue[ANXIETY_UX]);
+	}
+
+	if (sync) {
+		ahd->async_starved += async;
+		ahd->sync_starved = 0;
+		return anxiety_next_entry(q, &ahd->queue[ANXIETY_SYNC]);
+	}
+
+	if (async) {
+		ahd->async_starved = 0;
+		return anxiety_next_entry(q, &ahd->queue[ANXIETY_ASYNC]);
+	}
+
+	return NULL;
+}
+
+static struct request *anxiety_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct anxiety_data *adata = hctx->queue->elevator->elevator_data;
+	struct anxiety_hctx_data *ahd = hctx->sched_data;
+	struct request *rq;
+
+	spin_lock(&adata->lock);
+	anxiety_flush_pending(hctx->queue, ahd);
+	rq = __anxiety_dispatch(hctx->queue, adata, ahd);
+	spin_unlock(&adata->lock);
+
+	return rq;
+}
+
+static bool anxiety_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio)
+{
+	struct request_queue *q = hctx->queue;
+	struct anxiety_data *adata = q->elevator->elevator_data;
+	struct request *free = NULL;
+	bool ret;
+
+	spin_lock(&adata->lock);
+	/* let requests still on the pending lists take the bio too */
+	anxiety_flush_pending(q, hctx->sched_data);
+	ret = blk_mq_sched_try_merge(q, bio, &free);
+	spin_unlock(&adata->lock);
+
+	if (free)
+		blk_mq_free_request(free);
+
+	return ret;
+}
+
+/*
+ * The request ending where rq starts, so that a front merge into rq can
+ * be followed by merging rq into it. Called under adata->lock.
+ */
+static struct request *anxiety_former_request(struct request_queue *q,
+		struct request *rq)
+{
+	return elv_rqhash_find(q, blk_rq_pos(rq));
+}
+
+/* next was merged into rq and is freed by the caller. Called under adata->lock */
+static void anxiety_merged_requests(struct request_queue *q,
+		struct request *rq, struct request *next)
+{
+	anxiety_remove_request(q, next);
+}
+
+static bool anxiety_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct anxiety_hctx_data *ahd = hctx->sched_data;
+	int i;
+
+	for (i = 0; i < ANXIETY_NR_QUEUES; i++) {
+		if (!llist_empty(&ahd->pending[i]) ||
+		    !list_empty_careful(&ahd->queue[i]))
+			return true;
+	}
+
+	return false;
+}
+
+static void anxiety_completed_request(struct request *rq)
+{
+	struct anxiety_data *adata = rq->q->elevator->elevator_data;
+	unsigned int batch, min_batch, max_batch;
+	u64 now, lat, avg;
+
+	/* Only foreground reads drive the batch size */
+	if (req_op(rq) != REQ_OP_READ || !rq_is_sync(rq))
+		return;
+
+	now = ktime_get_ns();
+	if (now < rq->start_time_ns)
+		return;
+
+	/* Queueing time included, that is what the foreground waits for */
+	lat = now - rq->start_time_ns;
+	avg = READ_ONCE(adata->lat_avg);
+	avg = avg - (avg >> 3) + (lat >> 3);
+	WRITE_ONCE(adata->lat_avg, avg);
+
+	if (atomic_inc_return(&adata->lat_samples) % ADJUST_SAMPLES)
+		return;
+
+	min_batch = adata->sync_ratio;
+	max_batch = adata->sync_ratio * adata->batch_count;
+	batch = READ_ONCE(adata->batch);
+
+	if (avg > adata->target_lat_nsec)
+		batch = min(batch + 1, max_batch);
+	else if (avg < adata->target_lat_nsec / 2 && batch > min_batch)
+		batch--;
+
+	WRITE_ONCE(adata->batch, clamp(batch, min_batch, max_batch));
+}
+
+static void anxiety_limit_depth(unsigned int op, struct blk_mq_alloc_data *data)
+{
+	/*
+	 * Keep part of the scheduler tags free of background writeback so
+	 * that sync requests can always be allocated.
+	 */
+	if (!op_is_sync(op)) {
+		struct anxiety_data *adata = data->q->elevator->elevator_data;
+
+		data->shallow_depth = adata->async_depth;
+	}
+}
+
+static void anxiety_depth_updated(struct blk_mq_hw_ctx *hctx)
+{
+	struct anxiety_data *adata = hctx->queue->elevator->elevator_data;
+	struct blk_mq_tags *tags = hctx->sched_tags;
+	unsigned int shift = tags->bitmap_tags.sb.shift;
+
+	adata->async_depth = (1U << shift) * ASYNC_PERCENT / 100U;
+
+	sbitmap_queue_min_shallow_depth(&tags->bitmap_tags, adata->async_depth);
+}
+
+static int anxiety_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct anxiety_hctx_data *ahd;
+	int i;
+
+	ahd = kzalloc_node(sizeof(*ahd), GFP_KERNEL, hctx->numa_node);
+	if (!ahd)
+		return -ENOMEM;
+
+	for (i = 0; i < ANXIETY_NR_QUEUES; i++) {
+		init_llist_head(&ahd->pending[i]);
+		INIT_LIST_HEAD(&ahd->queue[i]);
+	}
+
+	hctx->sched_data = ahd;
+	anxiety_depth_updated(hctx);
+
+	return 0;
+}
+
+static void anxiety_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	kfree(hctx->sched_data);
+}
+
+static int anxiety_init_sched(struct request_queue *q, struct elevator_type *e)
+{
+	struct anxiety_data *adata;
+	struct elevator_queue *eq;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	adata = kzalloc_node(sizeof(*adata), GFP_KERNEL, q->node);
+	if (!adata) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+
+	adata->sync_ratio = DEFAULT_SYNC_RATIO;
+	adata->batch_count = DEFAULT_BATCH_COUNT;
+	adata->ux_ratio = DEFAULT_UX_RATIO;
+	adata->target_lat_nsec = DEFAULT_TARGET_LAT_NSEC;
+	adata->batch = DEFAULT_SYNC_RATIO;
+	atomic_set(&adata->lat_samples, 0);
+	spin_lock_init(&adata->lock);
+
+	eq->elevator_data = adata;
+	q->elevator = eq;
+
+	return 0;
+}
+
+static void anxiety_exit_sched(struct elevator_queue *e)
+{
+	kfree(e->elevator_data);
+}
+
+/* Sysfs access */
+static ssize_t anxiety_sync_ratio_show(struct elevator_queue *e, char *page)
+{
+	struct anxiety_data *adata = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%u\n", adata->sync_ratio);
+}
+
+static ssize_t anxiety_sync_ratio_store(struct elevator_queue *e,
+		const char *page, size_t count)
+{
+	struct anxiety_data *adata = e->elevator_data;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(page, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	adata->sync_ratio = clamp(val, 1U, 255U);
+	WRITE_ONCE(adata->batch, adata->sync_ratio);
+
+	return count;
+}
+
+static ssize_t anxiety_batch_count_show(struct elevator_queue *e, char *page)
+{
+	struct anxiety_data *adata = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%u\n", adata->batch_count);
+}
+
+static ssize_t anxiety_batch_count_store(struct elevator_queue *e,
+		const char *page, size_t count)
+{
+	struct anxiety_data *adata = e->elevator_data;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(page, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	adata->batch_count = clamp(val, 1U, 255U);
+	WRITE_ONCE(adata->batch, adata->sync_ratio);
+
+	return count;
+}
+
+static ssize_t anxiety_ux_ratio_show(struct elevator_queue *e, char *page)
+{
+	struct anxiety_data *adata = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%u\n", adata->ux_ratio);
+}
+
+static ssize_t anxiety_ux_ratio_store(struct elevator_queue *e,
+		const char *page, size_t count)
+{
+	struct anxiety_data *adata = e->elevator_data;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(page, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	adata->ux_ratio = max(val, 1U);
+
+	return count;
+}
+
+static ssize_t anxiety_target_lat_us_show(struct elevator_queue *e, char *page)
+{
+	struct anxiety_data *adata = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%llu\n",
+		adata->target_lat_nsec / NSEC_PER_USEC);
+}
+
+static ssize_t anxiety_target_lat_us_store(struct elevator_queue *e,
+		const char *page, size_t count)
+{
+	struct anxiety_data *adata = e->elevator_data;
+	u64 val;
+	int ret;
+
+	ret = kstrtou64(page, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	if (!val)
+		return -EINVAL;
+
+	adata->target_lat_nsec = val * NSEC_PER_USEC;
+
+	return count;
+}
+
+static ssize_t anxiety_batch_show(struct elevator_queue *e, char *page)
+{
+	struct anxiety_data *adata = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%u %llu\n", READ_ONCE(adata->batch),
+		READ_ONCE(adata->lat_avg) / NSEC_PER_USEC);
+}
+
+static struct elv_fs_entry anxiety_attrs[] = {
+	__ATTR(sync_ratio, 0644, anxiety_sync_ratio_show,
+		anxiety_sync_ratio_store),
+	__ATTR(batch_count, 0644, anxiety_batch_count_show,
+		anxiety_batch_count_store),
+	__ATTR(ux_ratio, 0644, anxiety_ux_ratio_show,
+		anxiety_ux_ratio_store),
+	__ATTR(target_lat_us, 0644, anxiety_target_lat_us_show,
+		anxiety_target_lat_us_store),
+	__ATTR(batch, 0444, anxiety_batch_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type mq_anxiety = {
+	.ops.mq = {
+		.init_sched		= anxiety_init_sched,
+		.exit_sched		= anxiety_exit_sched,
+		.init_hctx		= anxiety_init_hctx,
+		.exit_hctx		= anxiety_exit_hctx,
+		.depth_updated		= anxiety_depth_updated,
+		.limit_depth		= anxiety_limit_depth,
+		.insert_requests	= anxiety_insert_requests,
+		.dispatch_request	= anxiety_dispatch_request,
+		.bio_merge		= anxiety_bio_merge,
+		.former_request		= anxiety_former_request,
+		.requests_merged	= anxiety_merged_requests,
+		.has_work		= anxiety_has_work,
+		.completed_request	= anxiety_completed_request,
+	},
+	.uses_mq = true,
+	.elevator_attrs = anxiety_attrs,
+	.elevator_name = "mq-anxiety",
+	.elevator_alias = "anxiety",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init mq_anxiety_init(void)
+{
+	return elv_register(&mq_anxiety);
+}
+
+static void __exit mq_anxiety_exit(void)
+{
+	elv_unregister(&mq_anxiety);
+}
+
+module_init(mq_anxiety_init);
+module_exit(mq_anxiety_exit);
+
+MODULE_AUTHOR("Tyler Nijmeh");
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("MQ Anxiety I/O scheduler");
@@ -166,10 +166,28 @@ struct binder_notify {
 	struct task_struct *binder_task;
 	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
 	bool pending_async;
+	unsigned long *filter_cache;
+};
+
+#define BINDER_NOTIFY_TRANSACTION 0
+#define BINDER_NOTIFY_LATENCY 1
+
+/* sent once per transaction: at dequeue for oneway, at reply otherwise */
+struct binder_latency_notify {
+	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
+	unsigned int code;
+	bool oneway;
+	u64 queue_ns;	/* send -> dequeue by the target thread */
+	u64 exec_ns;	/* dequeue -> reply, 0 for oneway */
 };
 
 static ATOMIC_NOTIFIER_HEAD(binderevent_notif_chain);
 
+static inline bool binderevent_has_notifiers(void)
+{
+	return rcu_access_pointer(binderevent_notif_chain.head) != NULL;
+}
+
 int register_binderevent_notifier(struct notifier_block *nb) {
     return atomic_notifier_chain_register(&binderevent_notif_chain, nb);
 }
@@ -413,6 +431,8 @@ struct binder_node {
 	struct list_head async_todo;
 #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
+	/* owned by binder_stats: filter decision cached for this node */
+	unsigned long stats_filter_cache;
 #endif
 };
 
@@ -688,6 +708,12 @@ struct binder_transaction {
 	 * during thread teardown
 	 */
 	spinlock_t lock;
+#if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
+	/* latency stamps, send_ns is 0 when nobody listens */
+	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
+	u64 send_ns;
+	u64 dequeue_ns;
+#endif
 };
 
 /**
@@ -760,6 +786,31 @@ static void oplus_parse_service_name(struct binder_transaction_data *tr,
 	}
 }
 
+static void oplus_binder_latency_notify(struct binder_transaction *t)
+{
+	struct binder_latency_notify ln;
+
+	if (!t->send_ns || !t->dequeue_ns)
+		return;
+
+	memcpy(ln.service_name, t->service_name, OPLUS_MAX_SERVICE_NAME_LEN);
+	ln.code = t->code;
+	ln.oneway = !!(t->flags & TF_ONE_WAY);
+	ln.queue_ns = t->dequeue_ns - t->send_ns;
+	ln.exec_ns = ln.oneway ? 0 : ktime_get_ns() - t->dequeue_ns;
+	call_binderevent_notifiers(BINDER_NOTIFY_LATENCY, (void *)&ln);
+}
+
+static void oplus_binder_latency_dequeue(struct binder_transaction *t)
+{
+	if (!t->send_ns)
+		return;
+
+	t->dequeue_ns = ktime_get_ns();
+	if (t->flags & TF_ONE_WAY)
+		oplus_binder_latency_notify(t);
+}
+
 #endif // #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 
 /**
@@ -3359,6 +3410,7 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 		strncpy(binder_notify_obj.service_name, node->service_name, OPLUS_MAX_SERVICE_NAME_LEN);
 		binder_notify_obj.service_name[OPLUS_MAX_SERVICE_NAME_LEN-1] = '\0';
 		binder_notify_obj.pending_async = pending_async;
+		binder_notify_obj.filter_cache = &node->stats_filter_cache;
 	}
 #endif
 
@@ -3366,7 +3418,7 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 		if (NULL != thread && NULL != thread->task) {
 			binder_notify_obj.binder_task = thread->task;
-			call_binderevent_notifiers(0, (void *)&binder_notify_obj);
+			call_binderevent_notifiers(BINDER_NOTIFY_TRANSACTION, (void *)&binder_notify_obj);
 		}
 #endif
 #ifdef OPLUS_FEATURE_SCHED_ASSIST
@@ -3392,7 +3444,7 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 		if (NULL != proc && NULL != proc->tsk) {
 			binder_notify_obj.binder_task = proc->tsk;
-			call_binderevent_notifiers(0, (void *)&binder_notify_obj);
+			call_binderevent_notifiers(BINDER_NOTIFY_TRANSACTION, (void *)&binder_notify_obj);
 		}
 #endif
 #ifdef CONFIG_OPLUS_BINDER_STRATEGY
@@ -3404,7 +3456,7 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 		if (NULL != proc && NULL != proc->tsk) {
 			binder_notify_obj.binder_task = proc->tsk;
-			call_binderevent_notifiers(0, (void *)&binder_notify_obj);
+			call_binderevent_notifiers(BINDER_NOTIFY_TRANSACTION, (void *)&binder_notify_obj);
 		}
 #endif
 		binder_enqueue_work_ilocked(&t->work, &node->async_todo);
@@ -3760,6 +3812,13 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
+#if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
+	if (!reply && binderevent_has_notifiers()) {
+		memcpy(t->service_name, target_node->service_name,
+		       OPLUS_MAX_SERVICE_NAME_LEN);
+		t->send_ns = ktime_get_ns();
+	}
+#endif
 	if (!(t->flags & TF_ONE_WAY) &&
 	    binder_supported_policy(current->policy)) {
 		/* Inherit supported policies for synchronous transactions */
@@ -4124,6 +4183,9 @@ static void binder_transaction(struct binder_proc *proc,
 		binder_inner_proc_lock(proc);
 		obwork_check_restrict_off(proc);
 		binder_inner_proc_unlock(proc);
+#endif
+#if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
+		oplus_binder_latency_notify(in_reply_to);
 #endif
 		binder_restore_priority(current, in_reply_to->saved_priority);
 		binder_free_transaction(in_reply_to);
@@ -5074,6 +5136,10 @@ static int binder_thread_read(struct binder_proc *proc,
 			struct binder_node *target_node = t->buffer->target_node;
 			struct binder_priority node_prio;
 
+#if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
+			oplus_binder_latency_dequeue(t);
+#endif
+
 			trd->target.ptr = target_node->ptr;
 			trd->cookie =  target_node->cookie;
 			node_prio.sched_policy = target_node->sched_policy;
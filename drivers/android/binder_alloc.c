@@ -38,6 +38,7 @@
 #endif /*OPLUS_FEATURE_HANS_FREEZE*/
 
 struct list_lru binder_alloc_lru;
+struct list_lru binder_alloc_reserve_lru;
 
 static DEFINE_MUTEX(binder_alloc_mmap_lock);
 
@@ -52,6 +53,11 @@ static uint32_t binder_alloc_debug_mask = BINDER_DEBUG_USER_ERROR;
 module_param_named(debug_mask, binder_alloc_debug_mask,
 		   uint, 0644);
 
+static uint32_t binder_alloc_reserve_pages = 16;
+
+module_param_named(reserve_pages, binder_alloc_reserve_pages,
+		   uint, 0644);
+
 #define binder_alloc_debug(mask, x...) \
 	do { \
 		if (binder_alloc_debug_mask & mask) \
@@ -76,6 +82,17 @@ static size_t binder_alloc_buffer_size(struct binder_alloc *alloc,
 	return binder_buffer_next(buffer)->user_data - buffer->user_data;
 }
 
+static unsigned int binder_size_class(size_t size)
+{
+	unsigned int class;
+
+	if (size < (1U << BINDER_ALLOC_CLASS_MIN_SHIFT))
+		return BINDER_ALLOC_NO_CLASS;
+
+	class = ilog2(size) - BINDER_ALLOC_CLASS_MIN_SHIFT;
+	return class < BINDER_ALLOC_NR_CLASSES ? class : BINDER_ALLOC_NO_CLASS;
+}
+
 static void binder_insert_free_buffer(struct binder_alloc *alloc,
 				      struct binder_buffer *new_buffer)
 {
@@ -84,6 +101,7 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	size_t new_buffer_size;
+	unsigned int class;
 
 	BUG_ON(!new_buffer->free);
 
@@ -93,6 +111,15 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 		     "%d: add free buffer, size %zd, at %pK\n",
 		      alloc->pid, new_buffer_size, new_buffer);
 
+	class = binder_size_class(new_buffer_size);
+	new_buffer->size_class = class;
+	if (class != BINDER_ALLOC_NO_CLASS) {
+		/* LIFO, the most recently freed buffer likely has its pages */
+		list_add(&new_buffer->class_entry, &alloc->free_classes[class]);
+		__set_bit(class, &alloc->free_class_map);
+		return;
+	}
+
 	while (*p) {
 		parent = *p;
 		buffer = rb_entry(parent, struct binder_buffer, rb_node);
@@ -109,6 +136,117 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 	rb_insert_color(&new_buffer->rb_node, &alloc->free_buffers);
 }
 
+static void binder_remove_free_buffer(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer)
+{
+	unsigned int class = buffer->size_class;
+
+	BUG_ON(!buffer->free);
+
+	if (class == BINDER_ALLOC_NO_CLASS) {
+		rb_erase(&buffer->rb_node, &alloc->free_buffers);
+		return;
+	}
+
+	list_del(&buffer->class_entry);
+	if (list_empty(&alloc->free_classes[class]))
+		__clear_bit(class, &alloc->free_class_map);
+}
+
+/* how many buffers of its own class a request looks at before going up */
+#define BINDER_ALLOC_CLASS_SCAN		4
+
+/* the first of up to @max buffers on class list @class that holds @size */
+static struct binder_buffer *binder_alloc_class_scan(struct binder_alloc *alloc,
+						     unsigned int class,
+						     size_t size,
+						     unsigned int max)
+{
+	struct binder_buffer *buffer;
+
+	list_for_each_entry(buffer, &alloc->free_classes[class], class_entry) {
+		if (binder_alloc_buffer_size(alloc, buffer) >= size)
+			return buffer;
+		if (!--max)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Every buffer on class list n is at least 8 << n bytes, so the head of the
+ * first non-empty class whose lower bound covers @size is a fit.  The list
+ * @size itself falls in may hold fits as well, so a few of its buffers are
+ * tried first, and all of them only once no larger class has any.  This is
+ * a good fit rather than a best fit, in exchange for not walking the tree,
+ * which only holds buffers too large for any class.
+ */
+static struct binder_buffer *binder_alloc_class_fit(struct binder_alloc *alloc,
+						    size_t size)
+{
+	unsigned int own = binder_size_class(size);
+	unsigned int class = order_base_2(size);
+	struct binder_buffer *buffer;
+
+	if (class < BINDER_ALLOC_CLASS_MIN_SHIFT)
+		class = 0;
+	else
+		class -= BINDER_ALLOC_CLASS_MIN_SHIFT;
+	/* a power of two fits every buffer of its own class */
+	if (own == class)
+		own = BINDER_ALLOC_NO_CLASS;
+
+	if (own != BINDER_ALLOC_NO_CLASS) {
+		buffer = binder_alloc_class_scan(alloc, own, size,
+						 BINDER_ALLOC_CLASS_SCAN);
+		if (buffer)
+			return buffer;
+	}
+
+	if (class < BINDER_ALLOC_NR_CLASSES) {
+		class = find_next_bit(&alloc->free_class_map,
+				      BINDER_ALLOC_NR_CLASSES, class);
+		if (class < BINDER_ALLOC_NR_CLASSES)
+			return list_first_entry(&alloc->free_classes[class],
+						struct binder_buffer,
+						class_entry);
+	}
+
+	if (own != BINDER_ALLOC_NO_CLASS)
+		return binder_alloc_class_scan(alloc, own, size, UINT_MAX);
+
+	return NULL;
+}
+
+static struct binder_buffer *binder_alloc_tree_fit(struct binder_alloc *alloc,
+						   size_t size)
+{
+	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *best_fit = NULL;
+	struct binder_buffer *buffer;
+	size_t buffer_size;
+
+	while (n) {
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		BUG_ON(!buffer->free);
+		buffer_size = binder_alloc_buffer_size(alloc, buffer);
+
+		if (size < buffer_size) {
+			best_fit = n;
+			n = n->rb_left;
+		} else if (size > buffer_size)
+			n = n->rb_right;
+		else {
+			best_fit = n;
+			break;
+		}
+	}
+
+	return best_fit ? rb_entry(best_fit, struct binder_buffer, rb_node) :
+			  NULL;
+}
+
 static void binder_insert_allocated_buffer_locked(
 		struct binder_alloc *alloc, struct binder_buffer *new_buffer)
 {
@@ -189,136 +327,192 @@ struct binder_buffer *binder_alloc_prepare_to_free(struct binder_alloc *alloc,
 	return buffer;
 }
 
-static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
-				    void __user *start, void __user *end)
+/*
+ * Pages of freed buffers stay mapped on an lru until the shrinker takes
+ * them.  The first binder_alloc_reserve_pages of each proc go on a reserve
+ * lru instead, which the shrinker only drains once the main lru is empty,
+ * so that every proc keeps a few mapped pages for its next transactions.
+ */
+static void binder_lru_page_add(struct binder_alloc *alloc,
+				struct binder_lru_page *page)
 {
-	void __user *page_addr;
-	unsigned long user_page_addr;
+	bool ret;
+
+	if (alloc->reserve_pages < binder_alloc_reserve_pages) {
+		page->reserved = true;
+		alloc->reserve_pages++;
+		ret = list_lru_add(&binder_alloc_reserve_lru, &page->lru);
+	} else {
+		ret = list_lru_add(&binder_alloc_lru, &page->lru);
+	}
+	WARN_ON(!ret);
+}
+
+static bool binder_lru_page_del(struct binder_alloc *alloc,
+				struct binder_lru_page *page)
+{
+	if (page->reserved) {
+		page->reserved = false;
+		alloc->reserve_pages--;
+		return list_lru_del(&binder_alloc_reserve_lru, &page->lru);
+	}
+	return list_lru_del(&binder_alloc_lru, &page->lru);
+}
+
+#define BINDER_INSTALL_BATCH 16
+
+/*
+ * Make the pages backing [@start, @end) resident and mapped.  Pages still
+ * on an lru are claimed back as they are.  Missing pages are allocated a
+ * batch at a time before mmap_sem is taken, so direct reclaim never runs
+ * with the target's mmap_sem held, and each batch is then mapped under a
+ * single lock hold.
+ */
+static int binder_install_page_range(struct binder_alloc *alloc,
+				     void __user *start, void __user *end)
+{
+	size_t first = (start - alloc->buffer) / PAGE_SIZE;
+	size_t last = (end - alloc->buffer) / PAGE_SIZE;
+	size_t batch[BINDER_INSTALL_BATCH];
 	struct binder_lru_page *page;
-	struct vm_area_struct *vma = NULL;
+	struct vm_area_struct *vma;
 	struct mm_struct *mm = NULL;
-	bool need_mm = false;
+	unsigned int nr = 0, mapped = 0;
+	size_t index = first;
+	bool on_lru;
+	int ret = 0;
 
-	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
-		     "%d: %s pages %pK-%pK\n", alloc->pid,
-		     allocate ? "allocate" : "free", start, end);
+	while (index < last) {
+		nr = mapped = 0;
+		for (; index < last && nr < BINDER_INSTALL_BATCH; index++) {
+			page = &alloc->pages[index];
 
-	if (end <= start)
-		return 0;
+			if (page->page_ptr) {
+				trace_binder_alloc_lru_start(alloc, index);
 
-	trace_binder_update_page_range(alloc, allocate, start, end);
-
-	if (allocate == 0)
-		goto free_range;
+				on_lru = binder_lru_page_del(alloc, page);
+				WARN_ON(!on_lru);
 
-	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
-		page = &alloc->pages[(page_addr - alloc->buffer) / PAGE_SIZE];
-		if (!page->page_ptr) {
-			need_mm = true;
-			break;
+				trace_binder_alloc_lru_end(alloc, index);
+				continue;
+			}
+
+			trace_binder_alloc_page_start(alloc, index);
+			page->page_ptr = alloc_page(GFP_KERNEL |
+						    __GFP_HIGHMEM |
+						    __GFP_ZERO);
+			if (!page->page_ptr) {
+				pr_err("%d: binder_alloc_buf failed for page at %pK\n",
+				       alloc->pid, alloc->buffer + index * PAGE_SIZE);
+				ret = -ENOMEM;
+				goto err;
+			}
+			page->alloc = alloc;
+			INIT_LIST_HEAD(&page->lru);
+			batch[nr++] = index;
 		}
-	}
+		if (!nr)
+			continue;
 
-	if (need_mm && mmget_not_zero(alloc->vma_vm_mm))
-		mm = alloc->vma_vm_mm;
+		if (!mm) {
+			if (!mmget_not_zero(alloc->vma_vm_mm)) {
+				ret = -ESRCH;
+				goto err_no_vma;
+			}
+			mm = alloc->vma_vm_mm;
+		}
 
-	if (mm) {
 		down_read(&mm->mmap_sem);
 		vma = alloc->vma;
-	}
+		if (!vma) {
+			up_read(&mm->mmap_sem);
+			ret = -ESRCH;
+			goto err_no_vma;
+		}
 
-	if (!vma && need_mm) {
-		binder_alloc_debug(BINDER_DEBUG_USER_ERROR,
-				   "%d: binder_alloc_buf failed to map pages in userspace, no vma\n",
-				   alloc->pid);
-		goto err_no_vma;
+		/* index stays the scan cursor, everything below it is ours */
+		for (; mapped < nr; mapped++) {
+			unsigned long user_page_addr;
+			size_t i = batch[mapped];
+
+			page = &alloc->pages[i];
+			user_page_addr = (uintptr_t)alloc->buffer +
+					 i * PAGE_SIZE;
+			ret = vm_insert_page(vma, user_page_addr,
+					     page->page_ptr);
+			if (ret) {
+				up_read(&mm->mmap_sem);
+				pr_err("%d: binder_alloc_buf failed to map page at %lx in userspace\n",
+				       alloc->pid, user_page_addr);
+				ret = -ENOMEM;
+				goto err;
+			}
+
+			if (i + 1 > alloc->pages_high)
+				alloc->pages_high = i + 1;
+
+			trace_binder_alloc_page_end(alloc, i);
+			/* vm_insert_page does not seem to increment the refcount */
+		}
+		up_read(&mm->mmap_sem);
 	}
 
-	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
-		int ret;
-		bool on_lru;
-		size_t index;
+	if (mm)
+		mmput_async(mm);
+	return 0;
 
-		index = (page_addr - alloc->buffer) / PAGE_SIZE;
+err_no_vma:
+	binder_alloc_debug(BINDER_DEBUG_USER_ERROR,
+			   "%d: binder_alloc_buf failed to map pages in userspace, no vma\n",
+			   alloc->pid);
+err:
+	/* drop what was allocated but never mapped, park the rest */
+	for (; mapped < nr; mapped++) {
+		page = &alloc->pages[batch[mapped]];
+		__free_page(page->page_ptr);
+		page->page_ptr = NULL;
+	}
+	while (index-- > first) {
 		page = &alloc->pages[index];
+		if (page->page_ptr)
+			binder_lru_page_add(alloc, page);
+	}
+	if (mm)
+		mmput_async(mm);
+	return ret;
+}
 
-		if (page->page_ptr) {
-			trace_binder_alloc_lru_start(alloc, index);
-
-			on_lru = list_lru_del(&binder_alloc_lru, &page->lru);
-			WARN_ON(!on_lru);
+static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
+				    void __user *start, void __user *end)
+{
+	void __user *page_addr;
 
-			trace_binder_alloc_lru_end(alloc, index);
-			continue;
-		}
+	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
+		     "%d: %s pages %pK-%pK\n", alloc->pid,
+		     allocate ? "allocate" : "free", start, end);
 
-		if (WARN_ON(!vma))
-			goto err_page_ptr_cleared;
-
-		trace_binder_alloc_page_start(alloc, index);
-		page->page_ptr = alloc_page(GFP_KERNEL |
-					    __GFP_HIGHMEM |
-					    __GFP_ZERO);
-		if (!page->page_ptr) {
-			pr_err("%d: binder_alloc_buf failed for page at %pK\n",
-				alloc->pid, page_addr);
-			goto err_alloc_page_failed;
-		}
-		page->alloc = alloc;
-		INIT_LIST_HEAD(&page->lru);
-
-		user_page_addr = (uintptr_t)page_addr;
-		ret = vm_insert_page(vma, user_page_addr, page[0].page_ptr);
-		if (ret) {
-			pr_err("%d: binder_alloc_buf failed to map page at %lx in userspace\n",
-			       alloc->pid, user_page_addr);
-			goto err_vm_insert_page_failed;
-		}
+	if (end <= start)
+		return 0;
 
-		if (index + 1 > alloc->pages_high)
-			alloc->pages_high = index + 1;
+	trace_binder_update_page_range(alloc, allocate, start, end);
 
-		trace_binder_alloc_page_end(alloc, index);
-		/* vm_insert_page does not seem to increment the refcount */
-	}
-	if (mm) {
-		up_read(&mm->mmap_sem);
-		mmput_async(mm);
-	}
-	return 0;
+	if (allocate)
+		return binder_install_page_range(alloc, start, end);
 
-free_range:
 	for (page_addr = end - PAGE_SIZE; 1; page_addr -= PAGE_SIZE) {
-		bool ret;
 		size_t index;
 
 		index = (page_addr - alloc->buffer) / PAGE_SIZE;
-		page = &alloc->pages[index];
 
 		trace_binder_free_lru_start(alloc, index);
 
-		ret = list_lru_add(&binder_alloc_lru, &page->lru);
-		WARN_ON(!ret);
+		binder_lru_page_add(alloc, &alloc->pages[index]);
 
 		trace_binder_free_lru_end(alloc, index);
 		if (page_addr == start)
 			break;
-		continue;
-
-err_vm_insert_page_failed:
-		__free_page(page->page_ptr);
-		page->page_ptr = NULL;
-err_alloc_page_failed:
-err_page_ptr_cleared:
-		if (page_addr == start)
-			break;
-	}
-err_no_vma:
-	if (mm) {
-		up_read(&mm->mmap_sem);
-		mmput_async(mm);
 	}
-	return vma ? -ENOMEM : -ESRCH;
+	return 0;
 }
 
 
@@ -395,10 +589,9 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				int is_async,
 				int pid)
 {
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
 	void __user *has_page_addr;
 	void __user *end_page_addr;
 	size_t size, data_offsets_size;
@@ -454,22 +647,10 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 		return ERR_PTR(-ENOSPC);
 	}
 
-	while (n) {
-		buffer = rb_entry(n, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-
-		if (size < buffer_size) {
-			best_fit = n;
-			n = n->rb_left;
-		} else if (size > buffer_size)
-			n = n->rb_right;
-		else {
-			best_fit = n;
-			break;
-		}
-	}
-	if (best_fit == NULL) {
+	buffer = binder_alloc_class_fit(alloc, size);
+	if (!buffer)
+		buffer = binder_alloc_tree_fit(alloc, size);
+	if (!buffer) {
 		size_t allocated_buffers = 0;
 		size_t largest_alloc_size = 0;
 		size_t total_alloc_size = 0;
@@ -486,9 +667,9 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 			if (buffer_size > largest_alloc_size)
 				largest_alloc_size = buffer_size;
 		}
-		for (n = rb_first(&alloc->free_buffers); n != NULL;
-		     n = rb_next(n)) {
-			buffer = rb_entry(n, struct binder_buffer, rb_node);
+		list_for_each_entry(buffer, &alloc->buffers, entry) {
+			if (!buffer->free)
+				continue;
 			buffer_size = binder_alloc_buffer_size(alloc, buffer);
 			free_buffers++;
 			total_free_size += buffer_size;
@@ -505,10 +686,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 				   free_buffers, largest_free_size);
 		return ERR_PTR(-ENOSPC);
 	}
-	if (n == NULL) {
-		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-	}
+	buffer_size = binder_alloc_buffer_size(alloc, buffer);
 
 	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: binder_alloc_buf size %zd got buffer %pK size %zd\n",
@@ -516,7 +694,6 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 
 	has_page_addr = (void __user *)
 		(((uintptr_t)buffer->user_data + buffer_size) & PAGE_MASK);
-	WARN_ON(n && buffer_size != size);
 	end_page_addr =
 		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data + size);
 	if (end_page_addr > has_page_addr)
@@ -541,7 +718,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 		binder_insert_free_buffer(alloc, new_buffer);
 	}
 
-	rb_erase(best_fit, &alloc->free_buffers);
+	binder_remove_free_buffer(alloc, buffer);
 	buffer->free = 0;
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
@@ -715,7 +892,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 		struct binder_buffer *next = binder_buffer_next(buffer);
 
 		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_remove_free_buffer(alloc, next);
 			binder_delete_free_buffer(alloc, next);
 		}
 	}
@@ -724,7 +901,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 
 		if (prev->free) {
 			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			binder_remove_free_buffer(alloc, prev);
 			buffer = prev;
 		}
 	}
@@ -860,8 +1037,7 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 			if (!alloc->pages[i].page_ptr)
 				continue;
 
-			on_lru = list_lru_del(&binder_alloc_lru,
-					      &alloc->pages[i].lru);
+			on_lru = binder_lru_page_del(alloc, &alloc->pages[i]);
 			page_addr = alloc->buffer + i * PAGE_SIZE;
 			binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
 				     "%s: %d: page %d at %pK %s\n",
@@ -944,6 +1120,7 @@ void binder_alloc_print_pages(struct seq_file *m,
 	mutex_unlock(&alloc->mutex);
 	seq_printf(m, "  pages: %d:%d:%d\n", active, lru, free);
 	seq_printf(m, "  pages high watermark: %zu\n", alloc->pages_high);
+	seq_printf(m, "  pages reserved: %zu\n", alloc->reserve_pages);
 }
 
 /**
@@ -1021,6 +1198,11 @@ enum lru_status binder_alloc_free_page(struct list_head *item,
 	list_lru_isolate(lru, item);
 	spin_unlock(lock);
 
+	if (page->reserved) {
+		page->reserved = false;
+		alloc->reserve_pages--;
+	}
+
 	if (vma) {
 		trace_binder_unmap_user_start(alloc, index);
 
@@ -1054,7 +1236,8 @@ enum lru_status binder_alloc_free_page(struct list_head *item,
 static unsigned long
 binder_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
 {
-	unsigned long ret = list_lru_count(&binder_alloc_lru);
+	unsigned long ret = list_lru_count(&binder_alloc_lru) +
+			    list_lru_count(&binder_alloc_reserve_lru);
 	return ret;
 }
 
@@ -1065,6 +1248,11 @@ binder_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 
 	ret = list_lru_walk(&binder_alloc_lru, binder_alloc_free_page,
 			    NULL, sc->nr_to_scan);
+	/* reserves go last */
+	if (ret < sc->nr_to_scan && !list_lru_count(&binder_alloc_lru))
+		ret += list_lru_walk(&binder_alloc_reserve_lru,
+				     binder_alloc_free_page, NULL,
+				     sc->nr_to_scan - ret);
 	return ret;
 }
 
@@ -1077,6 +1265,7 @@ static struct shrinker binder_shrinker = {
 void binder_alloc_shrinker_exit(void)
 {
 	unregister_shrinker(&binder_shrinker);
+	list_lru_destroy(&binder_alloc_reserve_lru);
 	list_lru_destroy(&binder_alloc_lru);
 }
 
@@ -1089,20 +1278,35 @@ void binder_alloc_shrinker_exit(void)
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int i;
+
 	alloc->pid = current->group_leader->pid;
 	mutex_init(&alloc->mutex);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (i = 0; i < BINDER_ALLOC_NR_CLASSES; i++)
+		INIT_LIST_HEAD(&alloc->free_classes[i]);
 }
 
 int binder_alloc_shrinker_init(void)
 {
 	int ret = list_lru_init(&binder_alloc_lru);
 
-	if (ret == 0) {
-		ret = register_shrinker(&binder_shrinker);
-		if (ret)
-			list_lru_destroy(&binder_alloc_lru);
-	}
+	if (ret)
+		return ret;
+
+	ret = list_lru_init(&binder_alloc_reserve_lru);
+	if (ret)
+		goto err_reserve_lru;
+
+	ret = register_shrinker(&binder_shrinker);
+	if (ret)
+		goto err_register_shrinker;
+	return 0;
+
+err_register_shrinker:
+	list_lru_destroy(&binder_alloc_reserve_lru);
+err_reserve_lru:
+	list_lru_destroy(&binder_alloc_lru);
 	return ret;
 }
 
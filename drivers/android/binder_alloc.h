@@ -25,12 +25,22 @@
 #include <uapi/linux/android/binder.h>
 
 extern struct list_lru binder_alloc_lru;
+extern struct list_lru binder_alloc_reserve_lru;
 struct binder_transaction;
 
+/*
+ * Free buffers of [8 << n, 8 << (n + 1)) bytes are kept on size class list n
+ * instead of the free_buffers rb tree, which then only holds the large ones.
+ */
+#define BINDER_ALLOC_CLASS_MIN_SHIFT	3
+#define BINDER_ALLOC_NR_CLASSES		10
+#define BINDER_ALLOC_NO_CLASS		0xff
+
 /**
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
  * @rb_node:            node for allocated_buffers/free_buffers rb trees
+ * @class_entry:        entry in alloc->free_classes (shares @rb_node)
  * @free:               %true if buffer is free
  * @allow_user_free:    %true if user is allowed to free buffer
  * @async_transaction:  %true if buffer is in use for an async txn
@@ -42,17 +52,23 @@ struct binder_transaction;
  * @extra_buffers_size: size of space for other objects (like sg lists)
  * @user_data:          user pointer to base of buffer space
  * @pid:                pid to attribute the buffer to (caller)
+ * @size_class:         size class list of a free buffer, or
+ *                      %BINDER_ALLOC_NO_CLASS if it is in free_buffers
  *
  * Bookkeeping structure for binder transaction buffers
  */
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head class_entry; /* small free entry */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
 	unsigned debug_id:29;
+	u8 size_class;
 
 	struct binder_transaction *transaction;
 
@@ -67,13 +83,15 @@ struct binder_buffer {
 /**
  * struct binder_lru_page - page object used for binder shrinker
  * @page_ptr: pointer to physical page in mmap'd space
- * @lru:      entry in binder_alloc_lru
+ * @lru:      entry in binder_alloc_lru or binder_alloc_reserve_lru
  * @alloc:    binder_alloc for a proc
+ * @reserved: %true if @lru is on binder_alloc_reserve_lru
  */
 struct binder_lru_page {
 	struct list_head lru;
 	struct page *page_ptr;
 	struct binder_alloc *alloc;
+	bool reserved;
 };
 
 /**
@@ -86,7 +104,9 @@ struct binder_lru_page {
  * @buffer:             base of per-proc address space mapped via mmap
  * @buffers:            list of all buffers for this proc
  * @free_buffers:       rb tree of buffers available for allocation
- *                      sorted by size
+ *                      sorted by size, for buffers too large for a size class
+ * @free_classes:       lists of small free buffers, one per size class
+ * @free_class_map:     bitmap of the non-empty @free_classes
  * @allocated_buffers:  rb tree of allocated buffers sorted by address
  * @free_async_space:   VA space available for async buffers. This is
  *                      initialized at mmap time to 1/2 the full VA space
@@ -94,6 +114,7 @@ struct binder_lru_page {
  * @buffer_size:        size of address space specified via mmap
  * @pid:                pid for associated binder_proc (invariant after init)
  * @pages_high:         high watermark of offset in @pages
+ * @reserve_pages:      pages of this proc on binder_alloc_reserve_lru
  *
  * Bookkeeping structure for per-proc address space management for binder
  * buffers. It is normally initialized during binder_init() and binder_mmap()
@@ -107,6 +128,8 @@ struct binder_alloc {
 	void __user *buffer;
 	struct list_head buffers;
 	struct rb_root free_buffers;
+	struct list_head free_classes[BINDER_ALLOC_NR_CLASSES];
+	unsigned long free_class_map;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 	struct binder_lru_page *pages;
@@ -114,6 +137,7 @@ struct binder_alloc {
 	uint32_t buffer_free;
 	int pid;
 	size_t pages_high;
+	size_t reserve_pages;
 };
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_SELFTEST
@@ -19,11 +19,16 @@
 
 #include <linux/mm_types.h>
 #include <linux/err.h>
+#include <linux/random.h>
+#include <linux/timekeeping.h>
 #include "binder_alloc.h"
 
 #define BUFFER_NUM 5
 #define BUFFER_MIN_SIZE (PAGE_SIZE / 8)
 
+#define BENCH_ITERATIONS 20000
+#define BENCH_LIVE 32
+
 static bool binder_selftest_run = true;
 static int binder_selftest_failures;
 static DEFINE_MUTEX(binder_selftest_lock);
@@ -171,6 +176,10 @@ static void binder_selftest_free_page(struct binder_alloc *alloc)
 		list_lru_walk(&binder_alloc_lru, binder_alloc_free_page,
 			      NULL, count);
 	}
+	while ((count = list_lru_count(&binder_alloc_reserve_lru))) {
+		list_lru_walk(&binder_alloc_reserve_lru, binder_alloc_free_page,
+			      NULL, count);
+	}
 
 	for (i = 0; i < (alloc->buffer_size / PAGE_SIZE); i++) {
 		if (alloc->pages[i].page_ptr) {
@@ -192,13 +201,143 @@ static void binder_selftest_alloc_free(struct binder_alloc *alloc,
 
 	/* Allocate from lru. */
 	binder_selftest_alloc_buf(alloc, buffers, sizes, seq);
-	if (list_lru_count(&binder_alloc_lru))
+	if (list_lru_count(&binder_alloc_lru) ||
+	    list_lru_count(&binder_alloc_reserve_lru))
 		pr_err("lru list should be empty but is not\n");
 
 	binder_selftest_free_buf(alloc, buffers, sizes, seq, end);
 	binder_selftest_free_page(alloc);
 }
 
+/*
+ * Approximate mix of system_server transaction buffer sizes during app
+ * launch, as a histogram of upper bounds; @weight is the share per 1024
+ * transactions.
+ */
+static const struct {
+	size_t size;
+	unsigned int weight;
+} binder_bench_sizes[] = {
+	{ 64,		96 },
+	{ 128,		160 },
+	{ 256,		232 },
+	{ 512,		208 },
+	{ 1024,		144 },
+	{ 2048,		88 },
+	{ 4096,		56 },
+	{ 8192,		28 },
+	{ 16384,	12 },
+};
+
+static size_t binder_bench_pick_size(struct rnd_state *rnd)
+{
+	unsigned int r = prandom_u32_state(rnd) % 1024;
+	size_t size = binder_bench_sizes[0].size;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(binder_bench_sizes); i++) {
+		size = binder_bench_sizes[i].size;
+		if (r < binder_bench_sizes[i].weight)
+			break;
+		r -= binder_bench_sizes[i].weight;
+	}
+
+	/* spread uniformly over the upper half of the bucket */
+	return size - (prandom_u32_state(rnd) % (size / 2));
+}
+
+static void binder_bench_free_space(struct binder_alloc *alloc,
+				    size_t *nr_free, size_t *total_free,
+				    size_t *largest_free)
+{
+	struct binder_buffer *buffer, *next;
+	size_t size;
+
+	*nr_free = *total_free = *largest_free = 0;
+
+	mutex_lock(&alloc->mutex);
+	list_for_each_entry(buffer, &alloc->buffers, entry) {
+		if (!buffer->free)
+			continue;
+		if (list_is_last(&buffer->entry, &alloc->buffers)) {
+			size = alloc->buffer + alloc->buffer_size -
+				buffer->user_data;
+		} else {
+			next = list_next_entry(buffer, entry);
+			size = next->user_data - buffer->user_data;
+		}
+		(*nr_free)++;
+		*total_free += size;
+		*largest_free = max(*largest_free, size);
+	}
+	mutex_unlock(&alloc->mutex);
+}
+
+/**
+ * binder_selftest_bench() - Measure alloc/free cost and fragmentation.
+ * @alloc: Pointer to alloc struct.
+ *
+ * Replay a random mix of allocations and frees drawn from
+ * binder_bench_sizes with up to BENCH_LIVE buffers in flight, then
+ * report the mean cost of each operation and how fragmented the free
+ * space is while those buffers are still live.
+ */
+static void binder_selftest_bench(struct binder_alloc *alloc)
+{
+	struct binder_buffer *live[BENCH_LIVE] = { NULL };
+	struct binder_buffer *buffer;
+	struct rnd_state rnd;
+	u64 alloc_ns = 0, free_ns = 0, start;
+	unsigned int nr_alloc = 0, nr_freed = 0, failed = 0;
+	size_t nr_free, total_free, largest_free;
+	int i, slot;
+
+	prandom_seed_state(&rnd, 0x62696e646572ULL);
+
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		slot = prandom_u32_state(&rnd) % BENCH_LIVE;
+		if (live[slot]) {
+			start = ktime_get_ns();
+			binder_alloc_free_buf(alloc, live[slot]);
+			free_ns += ktime_get_ns() - start;
+			live[slot] = NULL;
+			nr_freed++;
+			continue;
+		}
+
+		start = ktime_get_ns();
+		buffer = binder_alloc_new_buf(alloc,
+					      binder_bench_pick_size(&rnd),
+					      0, 0, 0, 0);
+		alloc_ns += ktime_get_ns() - start;
+		if (IS_ERR(buffer)) {
+			failed++;
+			continue;
+		}
+		live[slot] = buffer;
+		nr_alloc++;
+	}
+
+	binder_bench_free_space(alloc, &nr_free, &total_free, &largest_free);
+
+	for (slot = 0; slot < BENCH_LIVE; slot++) {
+		if (live[slot])
+			binder_alloc_free_buf(alloc, live[slot]);
+	}
+	binder_selftest_free_page(alloc);
+
+	if (failed) {
+		pr_err("bench: %u allocations failed\n", failed);
+		binder_selftest_failures++;
+	}
+	pr_info("bench: alloc %u x %llu ns, free %u x %llu ns\n",
+		nr_alloc, nr_alloc ? div_u64(alloc_ns, nr_alloc) : 0,
+		nr_freed, nr_freed ? div_u64(free_ns, nr_freed) : 0);
+	pr_info("bench: %zu free buffers, largest %zu of %zu bytes, fragmentation %zu%%\n",
+		nr_free, largest_free, total_free,
+		total_free ? 100 - largest_free * 100 / total_free : 0);
+}
+
 static bool is_dup(int *seq, int index, int val)
 {
 	int i;
@@ -287,7 +426,8 @@ static void binder_selftest_alloc_offset(struct binder_alloc *alloc,
  * Allocate BUFFER_NUM buffers to cover all page alignment cases,
  * then free them in all orders possible. Check that pages are
  * correctly allocated, put onto lru when buffers are freed, and
- * are freed when binder_alloc_free_page is called.
+ * are freed when binder_alloc_free_page is called. Finally run a
+ * short allocator benchmark, see binder_selftest_bench().
  */
 void binder_selftest_alloc(struct binder_alloc *alloc)
 {
@@ -300,6 +440,7 @@ void binder_selftest_alloc(struct binder_alloc *alloc)
 		goto done;
 	pr_info("STARTED\n");
 	binder_selftest_alloc_offset(alloc, end_offset, 0);
+	binder_selftest_bench(alloc);
 	binder_selftest_run = false;
 	if (binder_selftest_failures > 0)
 		pr_info("%d tests FAILED\n", binder_selftest_failures);
@@ -295,6 +295,8 @@ struct binder_node {
 	struct list_head async_todo;
 #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
+	/* owned by binder_stats: filter decision cached for this node */
+	unsigned long stats_filter_cache;
 #endif
 };
 
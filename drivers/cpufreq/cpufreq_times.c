@@ -429,7 +429,8 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 	spin_unlock_irqrestore(&uid_lock, flags);
 
 #ifdef CONFIG_OPLUS_FEATURE_MIDAS
-	midas_record_task_times(uid, cputime, p, state);
+	midas_record_task_times(uid, cputime, p, state,
+				freqs->freq_table[state - freqs->offset]);
 #endif
 	rcu_read_lock();
 	uid_entry = find_uid_entry_rcu(uid);
@@ -23,6 +23,7 @@ static int __init game_ctrl_init(void)
 	cpu_load_init();
 	cpufreq_limits_init();
 	task_util_init();
+	task_place_init();
 	rt_info_init();
 	dstate_dump_init();
 
@@ -31,6 +32,7 @@ static int __init game_ctrl_init(void)
 
 static void __exit game_ctrl_exit(void)
 {
+	task_place_exit();
 }
 
 module_init(game_ctrl_init);
@@ -53,6 +53,12 @@ struct task_util {
 	struct task_util_info info[MAX_TASK_NR];
 };
 
+struct task_demand {
+	pid_t tid;
+	u16 util;
+	u32 wakeups;
+};
+
 struct cpu_freq_info {
 	/* ex: 0:960000 4:1440000 7:2284800 */
 	char buf[128];
@@ -78,12 +84,17 @@ extern struct proc_dir_entry *game_opt_dir;
 int cpu_load_init(void);
 int cpufreq_limits_init(void);
 int task_util_init(void);
+int task_place_init(void);
+void task_place_exit(void);
+void task_util_account_wakeup(struct task_struct *task);
+int task_util_get_demand(struct task_demand *demand, int max, u64 window_ns, pid_t *tgid);
 int rt_info_init(void);
 void rt_task_dead(struct task_struct *task);
 int dstate_dump_init(void);
 void rt_set_dstate_interested_threads(pid_t *tids, int num);
 extern void g_time_in_state_update_idle(int cpu, unsigned int new_idle_index);
 extern void g_rt_try_to_wake_up(struct task_struct *task);
+extern int g_rt_coloc_select_cpu(struct task_struct *p, int prev_cpu, int target_cpu);
 extern void g_update_task_runtime(struct task_struct *task, u64 runtime);
 extern void g_rt_task_dead(struct task_struct *task);
 extern void g_sched_stat_blocked(struct task_struct *task, u64 delay_ns);
@@ -17,8 +17,10 @@
 #include <linux/slab.h>
 #include <linux/gfp.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include "game_ctrl.h"
+#include "../../../../kernel/sched/walt.h"
 
 /*
  * render thread information
@@ -38,8 +40,45 @@ struct rt_waker_info_t {
 	u64 total;
 	u32 increment;
 	u64 last_wake_ts;
+	u32 coloc_cnt;
 };
 
+/*
+ * Top wakers of each render thread, refreshed every rt_coloc_period_ms
+ * from the waker graph and consulted by g_rt_coloc_select_cpu() when one
+ * of them wakes up. Protected by rt_info_rwlock.
+ */
+#define RT_COLOC_MAX_WAKERS 4
+
+struct rt_coloc_info_t {
+	pid_t waker_tid[RT_COLOC_MAX_WAKERS];
+	u32 wake_cnt[RT_COLOC_MAX_WAKERS];
+	int num;
+};
+
+static struct rt_coloc_info_t rt_coloc_info[MAX_RT_NUM];
+
+/*
+ * Tunables are read locklessly from select_task_rq() and the refresh work,
+ * rt_coloc_mutex only serializes writers.
+ */
+static DEFINE_MUTEX(rt_coloc_mutex);
+
+static int rt_coloc_enable = 0;
+static unsigned int rt_coloc_period_ms = 100;
+static unsigned int rt_coloc_top_wakers = 3;
+static unsigned int rt_coloc_min_wakes = 5;		/* per period */
+static unsigned int rt_coloc_xcluster_cost_us = 150;	/* per wakeup */
+static unsigned int rt_coloc_migrate_cost_us = 500;	/* cache refill */
+
+static atomic_t rt_coloc_hit = ATOMIC_INIT(0);
+static atomic_t rt_coloc_moved = ATOMIC_INIT(0);
+static atomic_t rt_coloc_skip_cost = ATOMIC_INIT(0);
+static atomic_t rt_coloc_skip_fit = ATOMIC_INIT(0);
+
+static void rt_coloc_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(rt_coloc_work, rt_coloc_work_fn);
+
 static DEFINE_RWLOCK(rt_info_rwlock);
 static atomic_t need_stat_wake = ATOMIC_INIT(0);
 static unsigned int rt_num = 0;
@@ -109,6 +148,7 @@ static void add_rt_waker_stat(struct render_thread_info_t *info)
 		if (waker->waker_tid == waker_tid) {
 			waker->total++;
 			waker->increment++;
+			waker->coloc_cnt++;
 			waker->last_wake_ts = ts;
 			return;
 		}
@@ -119,6 +159,7 @@ static void add_rt_waker_stat(struct render_thread_info_t *info)
 		new_waker->waker_tid = waker_tid;
 		new_waker->total = 1;
 		new_waker->increment = 1;
+		new_waker->coloc_cnt = 1;
 		new_waker->last_wake_ts = ts;
 		list_add_tail(&new_waker->node, &info->waker_list);
 	}
@@ -130,6 +171,8 @@ void g_rt_try_to_wake_up(struct task_struct *task)
 	pid_t wakee_tid = task->pid;
 	unsigned long flags;
 
+	task_util_account_wakeup(task);
+
 	if (atomic_read(&need_stat_wake) == 0)
 		return;
 
@@ -150,6 +193,167 @@ void g_rt_try_to_wake_up(struct task_struct *task)
 	}
 }
 
+/* must hold rt_info_rwlock for write */
+static void rt_coloc_refresh_locked(void)
+{
+	struct list_head *pos;
+	struct rt_waker_info_t *waker;
+	struct rt_coloc_info_t *coloc;
+	unsigned int top = READ_ONCE(rt_coloc_top_wakers);
+	unsigned int min_wakes = READ_ONCE(rt_coloc_min_wakes);
+	int i, j, k;
+
+	for (i = 0; i < MAX_RT_NUM; i++) {
+		coloc = &rt_coloc_info[i];
+		coloc->num = 0;
+		if (i >= rt_num)
+			continue;
+
+		/* insertion into a tiny descending array keeps the top-K */
+		list_for_each(pos, &render_thread_info[i].waker_list) {
+			waker = list_entry(pos, struct rt_waker_info_t, node);
+			if (waker->coloc_cnt < min_wakes ||
+			    waker->waker_tid == render_thread_info[i].rt_tid) {
+				waker->coloc_cnt = 0;
+				continue;
+			}
+
+			for (j = 0; j < coloc->num; j++) {
+				if (waker->coloc_cnt > coloc->wake_cnt[j])
+					break;
+			}
+			if (j < top) {
+				if (coloc->num < top)
+					coloc->num++;
+				for (k = coloc->num - 1; k > j; k--) {
+					coloc->waker_tid[k] = coloc->waker_tid[k - 1];
+					coloc->wake_cnt[k] = coloc->wake_cnt[k - 1];
+				}
+				coloc->waker_tid[j] = waker->waker_tid;
+				coloc->wake_cnt[j] = waker->coloc_cnt;
+			}
+			waker->coloc_cnt = 0;
+		}
+	}
+}
+
+static void rt_coloc_work_fn(struct work_struct *work)
+{
+	unsigned long flags;
+
+	write_lock_irqsave(&rt_info_rwlock, flags);
+	rt_coloc_refresh_locked();
+	write_unlock_irqrestore(&rt_info_rwlock, flags);
+
+	if (READ_ONCE(rt_coloc_enable) && atomic_read(&need_stat_wake))
+		schedule_delayed_work(&rt_coloc_work,
+				      msecs_to_jiffies(READ_ONCE(rt_coloc_period_ms)));
+}
+
+static inline bool rt_coloc_cpu_usable(struct task_struct *p, int cpu)
+{
+	return cpumask_test_cpu(cpu, &p->cpus_allowed) && cpu_active(cpu) &&
+		!cpu_isolated(cpu);
+}
+
+/*
+ * Called from find_energy_efficient_cpu() with the chosen CPU. When @p is
+ * one of the top wakers of a render thread and was about to be placed on
+ * another cluster, move it to the render thread's cluster if the expected
+ * cross-cluster wakeup cost over a period outweighs the cache refill cost
+ * of leaving a cache-hot prev_cpu. Within the cluster prev_cpu is kept when
+ * it is cheap to run on, otherwise an idle or least loaded sibling of the
+ * render thread's CPU is used.
+ */
+int g_rt_coloc_select_cpu(struct task_struct *p, int prev_cpu, int target_cpu)
+{
+#ifdef CONFIG_SCHED_WALT
+	struct task_struct *rt_task = NULL;
+	unsigned int wake_cnt = 0, best_nr = UINT_MAX;
+	int i, j, rt_cpu, cpu, best_cpu = -1;
+	u64 saving, cost = 0;
+	unsigned long util;
+
+	if (!READ_ONCE(rt_coloc_enable) || atomic_read(&need_stat_wake) == 0)
+		return target_cpu;
+
+	if (target_cpu < 0 || !read_trylock(&rt_info_rwlock))
+		return target_cpu;
+
+	for (i = 0; i < rt_num && !rt_task; i++) {
+		if (p->tgid != render_thread_info[i].rt_task->tgid)
+			continue;
+		for (j = 0; j < rt_coloc_info[i].num; j++) {
+			if (rt_coloc_info[i].waker_tid[j] == p->pid) {
+				rt_task = render_thread_info[i].rt_task;
+				wake_cnt = rt_coloc_info[i].wake_cnt[j];
+				break;
+			}
+		}
+	}
+
+	if (!rt_task) {
+		read_unlock(&rt_info_rwlock);
+		return target_cpu;
+	}
+
+	rt_cpu = task_cpu(rt_task);
+	read_unlock(&rt_info_rwlock);
+
+	if (same_cluster(target_cpu, rt_cpu)) {
+		atomic_inc(&rt_coloc_hit);
+		return target_cpu;
+	}
+
+	util = task_util(p);
+	if (util * 1280 > capacity_orig_of(rt_cpu) * 1024) {
+		atomic_inc(&rt_coloc_skip_fit);
+		return target_cpu;
+	}
+
+	saving = (u64)wake_cnt * READ_ONCE(rt_coloc_xcluster_cost_us);
+	if (!same_cluster(prev_cpu, rt_cpu) &&
+	    task_rq(p)->clock_task - p->se.exec_start < sysctl_sched_migration_cost)
+		cost = READ_ONCE(rt_coloc_migrate_cost_us);
+	if (saving <= cost) {
+		atomic_inc(&rt_coloc_skip_cost);
+		return target_cpu;
+	}
+
+	if (same_cluster(prev_cpu, rt_cpu) && prev_cpu != rt_cpu &&
+	    rt_coloc_cpu_usable(p, prev_cpu) && cpu_rq(prev_cpu)->nr_running <= 1) {
+		best_cpu = prev_cpu;
+		goto out;
+	}
+
+	for_each_cpu(cpu, &cpu_rq(rt_cpu)->cluster->cpus) {
+		unsigned int nr;
+
+		if (!rt_coloc_cpu_usable(p, cpu))
+			continue;
+		if (idle_cpu(cpu) && cpu != rt_cpu) {
+			best_cpu = cpu;
+			break;
+		}
+		/* sharing the render thread's own CPU is the last resort */
+		nr = cpu_rq(cpu)->nr_running + (cpu == rt_cpu);
+		if (nr < best_nr) {
+			best_nr = nr;
+			best_cpu = cpu;
+		}
+	}
+
+out:
+	if (best_cpu < 0)
+		return target_cpu;
+
+	atomic_inc(&rt_coloc_moved);
+	return best_cpu;
+#else
+	return target_cpu;
+#endif
+}
+
 void rt_task_dead(struct task_struct *task)
 {
 	int i;
@@ -353,6 +557,8 @@ static ssize_t rt_info_proc_write(struct file *file, const char __user *buf, siz
 		}
 	}
 
+	memset(rt_coloc_info, 0, sizeof(rt_coloc_info));
+
 	if (rt_num) {
 		if (!g_waker_mempool) {
 			g_waker_mempool = waker_mempool_create();
@@ -376,6 +582,10 @@ static ssize_t rt_info_proc_write(struct file *file, const char __user *buf, siz
 
 	write_unlock_irqrestore(&rt_info_rwlock, flags);
 
+	if (rt_num && READ_ONCE(rt_coloc_enable))
+		mod_delayed_work(system_wq, &rt_coloc_work,
+				 msecs_to_jiffies(READ_ONCE(rt_coloc_period_ms)));
+
 	return count;
 }
 
@@ -429,6 +639,90 @@ static const struct file_operations rt_num_proc_ops = {
 	.release	= single_release,
 };
 
+static int rt_coloc_show(struct seq_file *m, void *v)
+{
+	unsigned long flags;
+	int i, j;
+
+	mutex_lock(&rt_coloc_mutex);
+	seq_printf(m, "enable:%d period_ms:%u top_wakers:%u min_wakes:%u xcluster_cost_us:%u migrate_cost_us:%u\n",
+		rt_coloc_enable, rt_coloc_period_ms, rt_coloc_top_wakers, rt_coloc_min_wakes,
+		rt_coloc_xcluster_cost_us, rt_coloc_migrate_cost_us);
+	mutex_unlock(&rt_coloc_mutex);
+	seq_printf(m, "hit:%d moved:%d skip_cost:%d skip_fit:%d\n",
+		atomic_read(&rt_coloc_hit), atomic_read(&rt_coloc_moved),
+		atomic_read(&rt_coloc_skip_cost), atomic_read(&rt_coloc_skip_fit));
+
+	read_lock_irqsave(&rt_info_rwlock, flags);
+	for (i = 0; i < rt_num; i++) {
+		for (j = 0; j < rt_coloc_info[i].num; j++)
+			seq_printf(m, "%d;%d;%u\n", render_thread_info[i].rt_tid,
+				rt_coloc_info[i].waker_tid[j], rt_coloc_info[i].wake_cnt[j]);
+	}
+	read_unlock_irqrestore(&rt_info_rwlock, flags);
+
+	return 0;
+}
+
+static int rt_coloc_proc_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, rt_coloc_show, inode);
+}
+
+/*
+ * input: "enable [period_ms top_wakers min_wakes xcluster_cost_us migrate_cost_us]"
+ */
+static ssize_t rt_coloc_proc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	char page[128] = {0};
+	int enable, ret;
+	unsigned int period, top, min_wakes, xcost, mcost;
+
+	if (count > sizeof(page) - 1)
+		count = sizeof(page) - 1;
+	if (copy_from_user(page, buf, count))
+		return -EFAULT;
+
+	ret = sscanf(page, "%d %u %u %u %u %u", &enable, &period, &top, &min_wakes, &xcost, &mcost);
+	if (ret != 1 && ret != 6)
+		return -EINVAL;
+
+	if (ret == 6 && (period < 10 || !top || top > RT_COLOC_MAX_WAKERS))
+		return -EINVAL;
+
+	mutex_lock(&rt_coloc_mutex);
+	if (ret == 6) {
+		WRITE_ONCE(rt_coloc_period_ms, period);
+		WRITE_ONCE(rt_coloc_top_wakers, top);
+		WRITE_ONCE(rt_coloc_min_wakes, min_wakes);
+		WRITE_ONCE(rt_coloc_xcluster_cost_us, xcost);
+		WRITE_ONCE(rt_coloc_migrate_cost_us, mcost);
+	}
+
+	WRITE_ONCE(rt_coloc_enable, enable > 0);
+	if (enable > 0) {
+		atomic_set(&rt_coloc_hit, 0);
+		atomic_set(&rt_coloc_moved, 0);
+		atomic_set(&rt_coloc_skip_cost, 0);
+		atomic_set(&rt_coloc_skip_fit, 0);
+		mod_delayed_work(system_wq, &rt_coloc_work,
+				 msecs_to_jiffies(rt_coloc_period_ms));
+	} else {
+		cancel_delayed_work_sync(&rt_coloc_work);
+	}
+	mutex_unlock(&rt_coloc_mutex);
+
+	return count;
+}
+
+static const struct file_operations rt_coloc_proc_ops = {
+	.open		= rt_coloc_proc_open,
+	.write		= rt_coloc_proc_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int rt_info_init(void)
 {
 	if (unlikely(!game_opt_dir))
@@ -436,6 +730,7 @@ int rt_info_init(void)
 
 	proc_create_data("render_thread_info", 0664, game_opt_dir, &rt_info_proc_ops, NULL);
 	proc_create_data("rt_num", 0444, game_opt_dir, &rt_num_proc_ops, NULL);
+	proc_create_data("rt_coloc", 0664, game_opt_dir, &rt_coloc_proc_ops, NULL);
 
 	return 0;
 }
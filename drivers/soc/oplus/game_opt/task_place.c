@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (C) 2022 Oplus. All rights reserved.
+ */
+
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/seq_file.h>
+#include <linux/proc_fs.h>
+#include <linux/workqueue.h>
+#include <linux/tpd/tpd.h>
+
+#include "game_ctrl.h"
+
+/*
+ * Automatic placement of game threads by measured demand.
+ *
+ * Every period the capacity-scaled runtime and wakeup count of each game
+ * thread is read from task_util. Threads whose demand stays heavy are kept
+ * off the silver cluster, light and rarely waking threads are confined to
+ * silver, everything else is left to EAS. A new class must be observed for
+ * place_stable consecutive periods before the tpd tag is changed, so a
+ * single spiky window does not bounce threads between clusters. The tag a
+ * thread carried before it was first placed is put back once it drops to
+ * PLACE_NONE, unless someone else retagged it in the meantime.
+ */
+
+enum place_class {
+	PLACE_NONE,
+	PLACE_LIGHT,
+	PLACE_HEAVY,
+};
+
+struct place_info {
+	pid_t tid;
+	u16 util_avg;
+	u32 wake_rate;
+	u8 cls;
+	u8 pending_cls;
+	u8 pending_cnt;
+	bool seen;
+	int prev_tpd;
+};
+
+static DEFINE_MUTEX(place_mutex);
+static bool place_enable;
+static bool place_tpd_held;
+static pid_t place_tgid;
+static u64 place_window_start;
+
+static unsigned int place_period_ms = 200;
+static unsigned int place_heavy_util = 400;
+static unsigned int place_light_util = 60;
+static unsigned int place_wake_rate = 200;	/* wakeups per second */
+static unsigned int place_stable = 2;
+
+static struct place_info place_infos[MAX_TID_COUNT];
+static int place_num;
+static struct task_demand *place_demand;
+
+static void place_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(place_work, place_work_fn);
+
+static int place_decision(u8 cls)
+{
+	switch (cls) {
+	case PLACE_HEAVY:
+		return TPD_TYPE_PG;
+	case PLACE_LIGHT:
+		return TPD_TYPE_S;
+	default:
+		return 0;
+	}
+}
+
+static u8 place_classify(struct place_info *info)
+{
+	if (info->util_avg >= place_heavy_util)
+		return PLACE_HEAVY;
+
+	/* frequent short wakeups are latency bound, leave them to EAS */
+	if (info->util_avg <= place_light_util && info->wake_rate < place_wake_rate)
+		return PLACE_LIGHT;
+
+	return PLACE_NONE;
+}
+
+static void place_apply(pid_t tgid, struct place_info *info, u8 cls)
+{
+	struct task_struct *task;
+	int tpd;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(info->tid);
+	if (task && task->tgid == tgid) {
+		tpd = READ_ONCE(task->tpd);
+		if (info->cls == PLACE_NONE)
+			info->prev_tpd = tpd;
+		/* only touch a tag that is still the one we set */
+		if (info->cls == PLACE_NONE || tpd == place_decision(info->cls))
+			tpd_auto_tag(task, cls == PLACE_NONE ? info->prev_tpd :
+				     place_decision(cls));
+	}
+	rcu_read_unlock();
+
+	info->cls = cls;
+}
+
+static struct place_info *place_find_or_add(pid_t tid)
+{
+	int i;
+
+	for (i = 0; i < place_num; i++) {
+		if (place_infos[i].tid == tid)
+			return &place_infos[i];
+	}
+
+	if (place_num >= MAX_TID_COUNT)
+		return NULL;
+
+	memset(&place_infos[place_num], 0, sizeof(struct place_info));
+	place_infos[place_num].tid = tid;
+
+	return &place_infos[place_num++];
+}
+
+/* must hold place_mutex */
+static void place_reset_locked(void)
+{
+	int i;
+
+	for (i = 0; i < place_num; i++) {
+		if (place_infos[i].cls != PLACE_NONE)
+			place_apply(place_tgid, &place_infos[i], PLACE_NONE);
+	}
+	place_num = 0;
+	place_tgid = 0;
+
+	if (place_tpd_held) {
+		tpd_auto_enable(false);
+		place_tpd_held = false;
+	}
+}
+
+static void place_evaluate_locked(void)
+{
+	struct place_info *info;
+	pid_t tgid = 0;
+	u64 now, window;
+	int i, num, tagged = 0;
+
+	now = ktime_get_ns();
+	window = now - place_window_start;
+	place_window_start = now;
+
+	num = task_util_get_demand(place_demand, MAX_TID_COUNT, window, &tgid);
+	if (num < 0 || tgid != place_tgid) {
+		place_reset_locked();
+		if (num < 0)
+			return;
+		place_tgid = tgid;
+	}
+
+	for (i = 0; i < place_num; i++)
+		place_infos[i].seen = false;
+
+	for (i = 0; i < num; i++) {
+		u8 cls;
+
+		info = place_find_or_add(place_demand[i].tid);
+		if (!info)
+			break;
+
+		info->seen = true;
+		info->util_avg = (info->util_avg * 3 + place_demand[i].util) >> 2;
+		info->wake_rate = div64_u64((u64)place_demand[i].wakeups * NSEC_PER_SEC,
+					    max_t(u64, window, 1));
+
+		cls = place_classify(info);
+		if (cls == info->cls) {
+			info->pending_cnt = 0;
+			continue;
+		}
+
+		if (cls != info->pending_cls) {
+			info->pending_cls = cls;
+			info->pending_cnt = 0;
+		}
+		if (++info->pending_cnt < place_stable)
+			continue;
+
+		info->pending_cnt = 0;
+		place_apply(tgid, info, cls);
+	}
+
+	/* drop threads that went inactive or exited, compacting the table */
+	for (i = 0; i < place_num; ) {
+		info = &place_infos[i];
+		if (info->seen) {
+			tagged += info->cls != PLACE_NONE;
+			i++;
+			continue;
+		}
+		if (info->cls != PLACE_NONE)
+			place_apply(tgid, info, PLACE_NONE);
+		*info = place_infos[--place_num];
+	}
+
+	if (tagged && !place_tpd_held) {
+		tpd_auto_enable(true);
+		place_tpd_held = true;
+	} else if (!tagged && place_tpd_held) {
+		tpd_auto_enable(false);
+		place_tpd_held = false;
+	}
+}
+
+static void place_work_fn(struct work_struct *work)
+{
+	mutex_lock(&place_mutex);
+
+	if (place_enable) {
+		place_evaluate_locked();
+		schedule_delayed_work(&place_work, msecs_to_jiffies(place_period_ms));
+	}
+
+	mutex_unlock(&place_mutex);
+}
+
+static void place_set_enable(bool enable)
+{
+	mutex_lock(&place_mutex);
+
+	if (enable == place_enable) {
+		mutex_unlock(&place_mutex);
+		return;
+	}
+
+	place_enable = enable;
+	if (enable) {
+		place_window_start = ktime_get_ns();
+		schedule_delayed_work(&place_work, msecs_to_jiffies(place_period_ms));
+	} else {
+		place_reset_locked();
+	}
+
+	mutex_unlock(&place_mutex);
+
+	if (enable)
+		return;
+
+	cancel_delayed_work_sync(&place_work);
+
+	/* re-enabled while we were cancelling, its work may be gone */
+	mutex_lock(&place_mutex);
+	if (place_enable)
+		schedule_delayed_work(&place_work, msecs_to_jiffies(place_period_ms));
+	mutex_unlock(&place_mutex);
+}
+
+static ssize_t auto_place_proc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	char page[32] = {0};
+	int ret, enable;
+
+	ret = simple_write_to_buffer(page, sizeof(page) - 1, ppos, buf, count);
+	if (ret <= 0)
+		return ret;
+
+	if (sscanf(page, "%d", &enable) != 1)
+		return -EINVAL;
+
+	if (!place_demand)
+		return -ENOMEM;
+
+	place_set_enable(enable > 0);
+
+	return count;
+}
+
+static int auto_place_show(struct seq_file *m, void *v)
+{
+	struct place_info *info;
+	int i;
+
+	mutex_lock(&place_mutex);
+
+	seq_printf(m, "enable:%d tgid:%d tracked:%d\n", place_enable, place_tgid, place_num);
+	for (i = 0; i < place_num; i++) {
+		info = &place_infos[i];
+		seq_printf(m, "%d;%u;%u;%d\n", info->tid, info->util_avg,
+			info->wake_rate, place_decision(info->cls));
+	}
+
+	mutex_unlock(&place_mutex);
+
+	return 0;
+}
+
+static int auto_place_proc_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, auto_place_show, inode);
+}
+
+static const struct file_operations auto_place_proc_ops = {
+	.open		= auto_place_proc_open,
+	.write		= auto_place_proc_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * input: "period_ms heavy_util light_util wake_rate stable"
+ * util is capacity scaled in [0, 1024], wake_rate is wakeups per second
+ */
+static ssize_t auto_place_tunables_proc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	char page[64] = {0};
+	unsigned int period, heavy, light, wake, stable;
+	int ret;
+
+	ret = simple_write_to_buffer(page, sizeof(page) - 1, ppos, buf, count);
+	if (ret <= 0)
+		return ret;
+
+	ret = sscanf(page, "%u %u %u %u %u", &period, &heavy, &light, &wake, &stable);
+	if (ret != 5)
+		return -EINVAL;
+
+	if (period < 10 || heavy > 1024 || light >= heavy || !stable)
+		return -EINVAL;
+
+	mutex_lock(&place_mutex);
+	place_period_ms = period;
+	place_heavy_util = heavy;
+	place_light_util = light;
+	place_wake_rate = wake;
+	place_stable = stable;
+	mutex_unlock(&place_mutex);
+
+	return count;
+}
+
+static ssize_t auto_place_tunables_proc_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	char page[64] = {0};
+	int len;
+
+	mutex_lock(&place_mutex);
+	len = snprintf(page, sizeof(page), "%u %u %u %u %u\n", place_period_ms,
+		place_heavy_util, place_light_util, place_wake_rate, place_stable);
+	mutex_unlock(&place_mutex);
+
+	return simple_read_from_buffer(buf, count, ppos, page, len);
+}
+
+static const struct file_operations auto_place_tunables_proc_ops = {
+	.write		= auto_place_tunables_proc_write,
+	.read		= auto_place_tunables_proc_read,
+};
+
+int task_place_init(void)
+{
+	if (unlikely(!game_opt_dir))
+		return -ENOTDIR;
+
+	place_demand = kcalloc(MAX_TID_COUNT, sizeof(struct task_demand), GFP_KERNEL);
+	if (!place_demand)
+		return -ENOMEM;
+
+	proc_create_data("auto_place", 0664, game_opt_dir, &auto_place_proc_ops, NULL);
+	proc_create_data("auto_place_tunables", 0664, game_opt_dir, &auto_place_tunables_proc_ops, NULL);
+
+	return 0;
+}
+
+void task_place_exit(void)
+{
+	place_set_enable(false);
+	kfree(place_demand);
+	place_demand = NULL;
+}
@@ -4,11 +4,9 @@
  */
 
 #include <linux/atomic.h>
-#include <linux/list.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
-#include <linux/sort.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/syscore_ops.h>
@@ -16,76 +14,239 @@
 #include <linux/proc_fs.h>
 #include <linux/cpufreq.h>
 #include <linux/sched/cpufreq.h>
+#include <linux/percpu.h>
+#include <linux/hash.h>
+#include <linux/timex.h>
 
 #include "game_ctrl.h"
 
-struct task_runtime_info {
-	struct list_head node;
-	pid_t tid;
-	u64 sum_exec_scale;
+/*
+ * Per-task runtime accounting for the game process.
+ *
+ * The update hook runs from update_curr()/update_curr_rt() with the rq lock
+ * of the task's CPU held, so every CPU owns a fixed-size open-addressed
+ * table keyed by tid and updates it without taking any further lock. A
+ * thread that migrates simply has one slot on each CPU it ran on; readers
+ * merge the tables by tid.
+ *
+ * Slots hold cumulative counters. Each reader keeps its own snapshot in
+ * the slot and consumes the delta, so heavy_task_info and task_place see
+ * independent windows. A slot is reclaimed once it has been inactive for
+ * MAX_TASK_INACTIVE_TIME; its generation changes so stale snapshots are
+ * ignored. Changing the game bumps the table generation and every CPU
+ * lazily clears its table on the next update.
+ *
+ * Readers copy a slot and retry if its tid or generation changed under
+ * them. A dying thread is not under the rq lock, so it only posts its tid
+ * in dead_tid and the owner reclaims the slot on a later insert.
+ */
+
+#define TU_TABLE_BITS		7
+#define TU_TABLE_SIZE		(1 << TU_TABLE_BITS)
+#define TU_TABLE_MASK		(TU_TABLE_SIZE - 1)
+#define TU_MAX_PROBE		16
+
+enum {
+	TU_READER_HEAVY,
+	TU_READER_PLACE,
+	TU_READER_NR,
+};
+
+struct tu_slot {
+	pid_t tid;			/* 0 means empty */
+	u32 gen;
+	u64 exec_scale;
 	u64 last_update_ts;
+	atomic_t wakeups;
+	pid_t dead_tid;			/* written by g_rt_task_dead() */
+	/* reader owned */
+	u32 snap_gen[TU_READER_NR];
+	u32 snap_wakeups[TU_READER_NR];
+	u64 snap_exec[TU_READER_NR];
 };
 
-static LIST_HEAD(running_task_list);
+struct tu_table {
+	u32 table_gen;
+	u32 drops;
+	struct tu_slot slots[TU_TABLE_SIZE];
+};
+
+struct tu_merged {
+	pid_t tid;
+	u32 wakeups;
+	u64 exec_scale;
+};
 
 /* exclusive file ops */
 static DEFINE_MUTEX(g_mutex);
-static DEFINE_RAW_SPINLOCK(g_lock);
+/* serialises the merge scratch buffers between readers */
+static DEFINE_MUTEX(g_merge_mutex);
 
 static atomic_t need_stat_runtime = ATOMIC_INIT(0);
+static atomic_t game_tgid = ATOMIC_INIT(0);
+static atomic_t tu_gen = ATOMIC_INIT(1);
 static struct task_struct *game_leader = NULL;
 static u64 window_start;
 
-static struct task_runtime_info *g_rinfo_mempool = NULL;
-static struct list_head g_mempool_list;
-static struct list_head *g_mempool_list_ptr = &g_mempool_list;
+static struct tu_table __percpu *tu_tables;
+static struct tu_merged *tu_merge_buf;
+static u16 *tu_merge_index;
+#define TU_MERGE_INDEX_SIZE	(MAX_TID_COUNT * 2)
+/* slots left for a later merge because tu_merge_buf was full */
+static u64 tu_merge_drops;
+static u32 tu_merge_gen;
 
-static struct task_runtime_info *rinfo_mempool_create(void)
+static inline bool tu_slot_dead(struct tu_slot *slot, pid_t tid)
 {
-	struct task_runtime_info *rinfo_mempool = NULL;
-
-	rinfo_mempool = kzalloc(sizeof(struct task_runtime_info) * MAX_TID_COUNT, GFP_ATOMIC);
-
-	return rinfo_mempool;
+	return READ_ONCE(slot->dead_tid) == tid;
 }
 
-static void rinfo_mempool_init(struct task_runtime_info *rinfo_mempool)
+static inline void tu_table_update(struct tu_table *t, u32 gen, pid_t tid,
+				   u64 exec_scale, u64 now)
 {
-	int i;
+	struct tu_slot *slot, *stale = NULL, *empty = NULL;
+	u32 h, i;
 
-	if (likely(rinfo_mempool)) {
-		INIT_LIST_HEAD(g_mempool_list_ptr);
-		for (i = 0; i < MAX_TID_COUNT; i++)
-			list_add_tail(&rinfo_mempool[i].node, g_mempool_list_ptr);
+	if (unlikely(t->table_gen != gen)) {
+		memset(t->slots, 0, sizeof(t->slots));
+		t->drops = 0;
+		t->table_gen = gen;
 	}
-}
 
-static struct task_runtime_info *rinfo_mempool_alloc_one(void)
-{
-	struct list_head *pos;
-	struct task_runtime_info *rinfo = NULL;
+	h = hash_32(tid, TU_TABLE_BITS);
+	for (i = 0; i < TU_MAX_PROBE; i++) {
+		slot = &t->slots[(h + i) & TU_TABLE_MASK];
+		if (slot->tid == tid && !tu_slot_dead(slot, tid)) {
+			slot->exec_scale += exec_scale;
+			WRITE_ONCE(slot->last_update_ts, now);
+			return;
+		}
+		if (!slot->tid) {
+			empty = slot;
+			break;
+		}
+		if (!stale && (tu_slot_dead(slot, slot->tid) ||
+			       now - slot->last_update_ts >= MAX_TASK_INACTIVE_TIME))
+			stale = slot;
+	}
 
-	if (!list_empty(g_mempool_list_ptr)) {
-		pos = g_mempool_list_ptr->next;
-		list_del(pos);
-		rinfo = list_entry(pos, struct task_runtime_info, node);
+	slot = stale ? stale : empty;
+	if (unlikely(!slot)) {
+		t->drops++;
+		return;
 	}
 
-	return rinfo;
+	WRITE_ONCE(slot->tid, 0);
+	smp_wmb();
+	slot->gen++;
+	slot->exec_scale = exec_scale;
+	slot->last_update_ts = now;
+	atomic_set(&slot->wakeups, 0);
+	WRITE_ONCE(slot->dead_tid, 0);
+	smp_wmb();
+	WRITE_ONCE(slot->tid, tid);
 }
 
-static void rinfo_mempool_free_one(struct task_runtime_info *rinfo)
+static inline struct tu_slot *tu_table_lookup(struct tu_table *t, pid_t tid)
 {
-	if (likely(rinfo)) {
-		list_del(&rinfo->node);
-		list_add_tail(&rinfo->node, g_mempool_list_ptr);
+	struct tu_slot *slot;
+	pid_t cur;
+	u32 h, i;
+
+	h = hash_32(tid, TU_TABLE_BITS);
+	for (i = 0; i < TU_MAX_PROBE; i++) {
+		slot = &t->slots[(h + i) & TU_TABLE_MASK];
+		cur = READ_ONCE(slot->tid);
+		if (cur == tid)
+			return slot;
+		if (!cur)
+			break;
 	}
+
+	return NULL;
 }
 
-static void rinfo_mempool_destory(struct task_runtime_info *rinfo_mempool)
+/*
+ * Merge the delta since @reader's last visit of every active slot on every
+ * CPU into tu_merge_buf, one entry per tid. Caller holds g_merge_mutex.
+ */
+static int tu_merge(int reader, u64 now)
 {
-	if (likely(rinfo_mempool))
-		kfree(rinfo_mempool);
+	struct tu_table *t;
+	struct tu_slot *slot;
+	struct tu_merged *m;
+	u32 gen = atomic_read(&tu_gen);
+	u32 slot_gen, wakeups, raw_wakeups, h;
+	u64 exec, raw_exec, ts;
+	pid_t tid;
+	int cpu, i, num = 0;
+
+	if (tu_merge_gen != gen) {
+		tu_merge_gen = gen;
+		WRITE_ONCE(tu_merge_drops, 0);
+	}
+	memset(tu_merge_index, 0xff, sizeof(u16) * TU_MERGE_INDEX_SIZE);
+
+	for_each_possible_cpu(cpu) {
+		t = per_cpu_ptr(tu_tables, cpu);
+		if (READ_ONCE(t->table_gen) != gen)
+			continue;
+
+		for (i = 0; i < TU_TABLE_SIZE; i++) {
+			slot = &t->slots[i];
+			do {
+				tid = READ_ONCE(slot->tid);
+				if (!tid)
+					break;
+				smp_rmb();
+				slot_gen = READ_ONCE(slot->gen);
+				raw_exec = READ_ONCE(slot->exec_scale);
+				raw_wakeups = atomic_read(&slot->wakeups);
+				ts = READ_ONCE(slot->last_update_ts);
+				smp_rmb();
+			} while (READ_ONCE(slot->tid) != tid ||
+				 READ_ONCE(slot->gen) != slot_gen);
+
+			if (!tid || tu_slot_dead(slot, tid) ||
+			    now - ts >= MAX_TASK_INACTIVE_TIME)
+				continue;
+
+			h = hash_32(tid, ilog2(TU_MERGE_INDEX_SIZE));
+			while (tu_merge_index[h] != U16_MAX &&
+			       tu_merge_buf[tu_merge_index[h]].tid != tid)
+				h = (h + 1) & (TU_MERGE_INDEX_SIZE - 1);
+
+			if (tu_merge_index[h] == U16_MAX) {
+				/* keep the snapshot so the delta is not lost */
+				if (num >= MAX_TID_COUNT) {
+					WRITE_ONCE(tu_merge_drops, tu_merge_drops + 1);
+					continue;
+				}
+				tu_merge_index[h] = num;
+				m = &tu_merge_buf[num++];
+				m->tid = tid;
+				m->exec_scale = 0;
+				m->wakeups = 0;
+			} else {
+				m = &tu_merge_buf[tu_merge_index[h]];
+			}
+
+			exec = raw_exec;
+			wakeups = raw_wakeups;
+			if (slot->snap_gen[reader] == slot_gen) {
+				exec -= min(exec, slot->snap_exec[reader]);
+				wakeups -= min(wakeups, slot->snap_wakeups[reader]);
+			}
+			slot->snap_gen[reader] = slot_gen;
+			slot->snap_exec[reader] = raw_exec;
+			slot->snap_wakeups[reader] = raw_wakeups;
+
+			m->exec_scale += exec;
+			m->wakeups += wakeups;
+		}
+	}
+
+	return num;
 }
 
 static ssize_t game_pid_proc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
@@ -93,7 +254,6 @@ static ssize_t game_pid_proc_write(struct file *file, const char __user *buf, si
 	char page[32] = {0};
 	int ret, pid;
 	struct task_struct *leader = NULL;
-	unsigned long flags;
 
 	mutex_lock(&g_mutex);
 
@@ -108,20 +268,22 @@ static ssize_t game_pid_proc_write(struct file *file, const char __user *buf, si
 	}
 
 	atomic_set(&need_stat_runtime, 0);
-
-	raw_spin_lock_irqsave(&g_lock, flags);
+	atomic_set(&game_tgid, 0);
 
 	/* release */
 	if (pid <= 0) {
 		if (game_leader) {
 			put_task_struct(game_leader);
 			game_leader = NULL;
-			INIT_LIST_HEAD(&running_task_list);
-			rinfo_mempool_destory(g_rinfo_mempool);
-			g_rinfo_mempool = NULL;
+			atomic_inc(&tu_gen);
 		}
 		ret = count;
-		goto rsunlock;
+		goto munlock;
+	}
+
+	if (!tu_tables) {
+		ret = -ENOMEM;
+		goto munlock;
 	}
 
 	/* acquire */
@@ -130,7 +292,7 @@ static ssize_t game_pid_proc_write(struct file *file, const char __user *buf, si
 	if (!leader || leader->pid != leader->tgid) { /* must be process id */
 		rcu_read_unlock();
 		ret = -EINVAL;
-		goto rsunlock;
+		goto munlock;
 	} else {
 		if (game_leader)
 			put_task_struct(game_leader);
@@ -139,24 +301,12 @@ static ssize_t game_pid_proc_write(struct file *file, const char __user *buf, si
 		rcu_read_unlock();
 	}
 
-	if (!g_rinfo_mempool) {
-		g_rinfo_mempool = rinfo_mempool_create();
-		if (!g_rinfo_mempool) {
-			put_task_struct(game_leader);
-			game_leader = NULL;
-			ret = -ENOMEM;
-			goto rsunlock;
-		}
-	}
-	rinfo_mempool_init(g_rinfo_mempool);
-
-	INIT_LIST_HEAD(&running_task_list);
+	atomic_inc(&tu_gen);
 	window_start = ktime_get_ns();
+	atomic_set(&game_tgid, game_leader->tgid);
 	atomic_set(&need_stat_runtime, 1);
 
 	ret = count;
-rsunlock:
-	raw_spin_unlock_irqrestore(&g_lock, flags);
 munlock:
 	mutex_unlock(&g_mutex);
 	return ret;
@@ -187,26 +337,11 @@ static const struct file_operations game_pid_proc_ops = {
 	.read		= game_pid_proc_read,
 };
 
-/*
- *  Ascending order by util
- */
-static int cmp_task_util(const void *a, const void *b)
-{
-	struct task_util_info *prev, *next;
-
-	prev = (struct task_util_info *)a;
-	next = (struct task_util_info *)b;
-	if (unlikely(!prev || !next))
-		return 0;
-
-	return next->util - prev->util;
-}
-
 static inline u16 cal_util(u64 sum_exec_scale, u64 window_size)
 {
-	u16 util;
+	u64 util;
 
-	util = sum_exec_scale / (window_size >> 10);
+	util = div64_u64(sum_exec_scale, window_size >> 10);
 	if (util > 1024)
 		util = 1024;
 
@@ -228,17 +363,56 @@ static bool get_task_name(pid_t tid, char *name) {
 	return ret;
 }
 
+/*
+ * Min-heap of the top MAX_TASK_NR entries by util, root is the smallest.
+ */
+static void util_heap_sift_down(struct task_util_info *heap, int num, int i)
+{
+	struct task_util_info tmp;
+	int l, r, min;
+
+	for (;;) {
+		l = 2 * i + 1;
+		r = l + 1;
+		min = i;
+		if (l < num && heap[l].util < heap[min].util)
+			min = l;
+		if (r < num && heap[r].util < heap[min].util)
+			min = r;
+		if (min == i)
+			return;
+		tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+
+static void util_heap_sift_up(struct task_util_info *heap, int i)
+{
+	struct task_util_info tmp;
+	int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (heap[parent].util <= heap[i].util)
+			return;
+		tmp = heap[i];
+		heap[i] = heap[parent];
+		heap[parent] = tmp;
+		i = parent;
+	}
+}
+
 static int heavy_task_info_show(struct seq_file *m, void *v)
 {
-	unsigned long flags;
-	struct task_util_info *results;
-	struct list_head *pos, *n;
-	struct task_runtime_info *rinfo;
-	int i, num = 0, ret = 0;
+	struct task_util_info heap[MAX_TASK_NR];
+	struct task_util_info item, tmp;
+	int i, num, heap_num = 0, ret = 0;
 	char page[1024] = {0};
 	char task_name[TASK_COMM_LEN];
 	ssize_t len = 0;
-	u64 now;
+	u64 now, window;
 
 	mutex_lock(&g_mutex);
 
@@ -247,48 +421,47 @@ static int heavy_task_info_show(struct seq_file *m, void *v)
 		goto munlock;
 	}
 
-	results = kmalloc(sizeof(struct task_util_info) * MAX_TID_COUNT, GFP_KERNEL);
-	if (!results) {
-		ret = -ENOMEM;
-		goto munlock;
-	}
-
-	atomic_set(&need_stat_runtime, 0);
-
-	raw_spin_lock_irqsave(&g_lock, flags);
 	now = ktime_get_ns();
+	window = now - window_start;
+	if (window >> 10 == 0)
+		goto munlock;
 
-	list_for_each_safe(pos, n, &running_task_list) {
-		rinfo = list_entry(pos, struct task_runtime_info, node);
-		if (now - rinfo->last_update_ts < MAX_TASK_INACTIVE_TIME) {
-			results[num].tid = rinfo->tid;
-			results[num].util = cal_util(rinfo->sum_exec_scale, now - window_start);
-			rinfo->sum_exec_scale = 0;
-			num++;
-		} else {
-			rinfo_mempool_free_one(rinfo);
+	mutex_lock(&g_merge_mutex);
+	num = tu_merge(TU_READER_HEAVY, now);
+	for (i = 0; i < num; i++) {
+		item.tid = tu_merge_buf[i].tid;
+		item.util = cal_util(tu_merge_buf[i].exec_scale, window);
+		if (item.util <= 0)
+			continue;
+
+		if (heap_num < MAX_TASK_NR) {
+			heap[heap_num] = item;
+			util_heap_sift_up(heap, heap_num++);
+		} else if (item.util > heap[0].util) {
+			heap[0] = item;
+			util_heap_sift_down(heap, heap_num, 0);
 		}
 	}
-	raw_spin_unlock_irqrestore(&g_lock, flags);
+	mutex_unlock(&g_merge_mutex);
+
+	/* pop into descending order */
+	for (i = heap_num - 1; i > 0; i--) {
+		tmp = heap[0];
+		heap[0] = heap[i];
+		heap[i] = tmp;
+		util_heap_sift_down(heap, i, 0);
+	}
 
-	sort(results, num, sizeof(struct task_util_info), &cmp_task_util, NULL);
-	num = min(num, MAX_TASK_NR);
-	for (i = 0; i < num; i++) {
-		if (results[i].util <= 0)
-			break;
-		if (get_task_name(results[i].tid, task_name)) {
+	for (i = 0; i < heap_num; i++) {
+		if (get_task_name(heap[i].tid, task_name)) {
 			len += snprintf(page + len, sizeof(page) - len, "%d;%s;%d\n",
-				results[i].tid, task_name, results[i].util);
+				heap[i].tid, task_name, heap[i].util);
 		}
 	}
 	if (len > 0)
 		seq_puts(m, page);
 
-	kfree(results);
-
-	now = ktime_get_ns();
 	window_start = now;
-	atomic_set(&need_stat_runtime, 1);
 
 munlock:
 	mutex_unlock(&g_mutex);
@@ -322,11 +495,10 @@ static inline unsigned int get_max_freq(unsigned int cpu)
 }
 
 #define DIV64_U64_ROUNDUP(X, Y) div64_u64((X) + (Y - 1), Y)
-static inline u64 scale_exec_time(u64 delta, struct rq *rq)
+static inline u64 scale_exec_time(u64 delta, int cpu)
 {
 	u64 task_exec_scale;
 	unsigned int cur_freq, max_freq;
-	int cpu = cpu_of(rq);
 
 	cur_freq = get_cur_freq(cpu);
 	max_freq = get_max_freq(cpu);
@@ -341,79 +513,216 @@ static inline u64 scale_exec_time(u64 delta, struct rq *rq)
 	return (delta * task_exec_scale) >> 10;
 }
 
+/* called with the rq lock of @task's CPU held */
 void g_update_task_runtime(struct task_struct *task, u64 runtime)
 {
-	unsigned long flags;
-	u64 now, exec_scale;
-	struct list_head *pos;
-	struct task_runtime_info *rinfo;
-	struct task_runtime_info *new_rinfo;
-	struct rq *rq = task_rq(task);
+	int cpu;
 
 	if (atomic_read(&need_stat_runtime) == 0)
 		return;
 
-	raw_spin_lock_irqsave(&g_lock, flags);
+	if (task->tgid != atomic_read(&game_tgid))
+		return;
 
-	if (!game_leader || task->tgid != game_leader->tgid)
-		goto rsunlock;
+	cpu = cpu_of(task_rq(task));
+	tu_table_update(per_cpu_ptr(tu_tables, cpu), atomic_read(&tu_gen),
+			task->pid, scale_exec_time(runtime, cpu), ktime_get_ns());
+}
 
-	now = ktime_get_ns();
-	exec_scale = scale_exec_time(runtime, rq);
-
-	list_for_each(pos, &running_task_list) {
-		rinfo = list_entry(pos, struct task_runtime_info, node);
-		if (rinfo->tid == task->pid) {
-			rinfo->sum_exec_scale += exec_scale;
-			rinfo->last_update_ts = now;
-			goto rsunlock;
-		}
-	}
+void task_util_account_wakeup(struct task_struct *task)
+{
+	struct tu_table *t;
+	struct tu_slot *slot;
+
+	if (atomic_read(&need_stat_runtime) == 0)
+		return;
 
-	new_rinfo = rinfo_mempool_alloc_one();
-	if (new_rinfo) {
-		new_rinfo->tid = task->pid;
-		new_rinfo->sum_exec_scale = exec_scale;
-		new_rinfo->last_update_ts = now;
-		list_add_tail(&new_rinfo->node, &running_task_list);
+	if (task->tgid != atomic_read(&game_tgid))
+		return;
+
+	/* the slot of the CPU the task last ran on carries its wakeups */
+	t = per_cpu_ptr(tu_tables, task_cpu(task));
+	if (READ_ONCE(t->table_gen) != atomic_read(&tu_gen))
+		return;
+
+	slot = tu_table_lookup(t, task->pid);
+	if (slot)
+		atomic_inc(&slot->wakeups);
+}
+
+/*
+ * Return the demand of every active game thread since the previous call,
+ * or -ESRCH without a game.
+ */
+int task_util_get_demand(struct task_demand *demand, int max, u64 window_ns, pid_t *tgid)
+{
+	int i, num;
+
+	if (unlikely(window_ns >> 10 == 0))
+		return 0;
+
+	*tgid = atomic_read(&game_tgid);
+	if (!*tgid || !atomic_read(&need_stat_runtime))
+		return -ESRCH;
+
+	mutex_lock(&g_merge_mutex);
+	num = min(tu_merge(TU_READER_PLACE, ktime_get_ns()), max);
+	for (i = 0; i < num; i++) {
+		demand[i].tid = tu_merge_buf[i].tid;
+		demand[i].util = cal_util(tu_merge_buf[i].exec_scale, window_ns);
+		demand[i].wakeups = tu_merge_buf[i].wakeups;
 	}
+	mutex_unlock(&g_merge_mutex);
 
-rsunlock:
-	raw_spin_unlock_irqrestore(&g_lock, flags);
+	return num;
 }
 
 void g_rt_task_dead(struct task_struct *task)
 {
-	unsigned long flags;
-	struct list_head *pos, *n;
-	struct task_runtime_info *rinfo;
+	struct tu_table *t;
+	struct tu_slot *slot;
 
 	if (atomic_read(&need_stat_runtime) == 0)
 		return;
 
-	raw_spin_lock_irqsave(&g_lock, flags);
+	if (task->tgid != atomic_read(&game_tgid))
+		return;
 
-	if (!game_leader || task->tgid != game_leader->tgid)
-		goto rsunlock;
+	/*
+	 * Only the rq lock holder writes a slot, so leave the reclaim to it.
+	 * If the slot has been reused meanwhile the tid no longer matches.
+	 */
+	t = per_cpu_ptr(tu_tables, task_cpu(task));
+	slot = tu_table_lookup(t, task->pid);
+	if (slot)
+		WRITE_ONCE(slot->dead_tid, task->pid);
+}
 
-	list_for_each_safe(pos, n, &running_task_list) {
-		rinfo = list_entry(pos, struct task_runtime_info, node);
-		if (rinfo->tid == task->pid) {
-			rinfo_mempool_free_one(rinfo);
-			break;
-		}
+/*
+ * Benchmark of the update hook: write the number of iterations, read back
+ * the average cost. Runs against a private table with IRQs off in batches,
+ * cycling through a game-sized set of tids, so it measures the same probe
+ * and update path as the scheduler hook. Reads also report how many
+ * samples of the current game were lost to full per-cpu tables, and how
+ * many slots a merge had to leave for later.
+ */
+#define TU_BENCH_TIDS	64
+#define TU_BENCH_BATCH	1024
+
+static u64 tu_bench_iters;
+static u64 tu_bench_cycles;
+static u64 tu_bench_ns;
+
+static ssize_t task_util_bench_proc_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos)
+{
+	char page[32] = {0};
+	struct tu_table *t;
+	unsigned long flags, iters, done = 0;
+	cycles_t c0, cycles = 0;
+	u64 t0, ns = 0;
+	int ret, i, cpu;
+
+	ret = simple_write_to_buffer(page, sizeof(page) - 1, ppos, buf, count);
+	if (ret <= 0)
+		return ret;
+
+	if (kstrtoul(strstrip(page), 0, &iters) || !iters)
+		return -EINVAL;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	while (done < iters) {
+		unsigned long batch = min_t(unsigned long, iters - done, TU_BENCH_BATCH);
+
+		local_irq_save(flags);
+		cpu = smp_processor_id();
+		t0 = ktime_get_ns();
+		c0 = get_cycles();
+		for (i = 0; i < batch; i++)
+			tu_table_update(t, 1, 1000 + (done + i) % TU_BENCH_TIDS,
+					scale_exec_time(NSEC_PER_MSEC, cpu), t0);
+		cycles += get_cycles() - c0;
+		ns += ktime_get_ns() - t0;
+		local_irq_restore(flags);
+
+		done += batch;
+		cond_resched();
+	}
+
+	kfree(t);
+
+	mutex_lock(&g_mutex);
+	tu_bench_iters = iters;
+	tu_bench_cycles = cycles;
+	tu_bench_ns = ns;
+	mutex_unlock(&g_mutex);
+
+	return count;
+}
+
+/* samples of the current game that found no slot in their cpu's table */
+static u64 tu_drops(void)
+{
+	u32 gen = atomic_read(&tu_gen);
+	struct tu_table *t;
+	u64 drops = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		t = per_cpu_ptr(tu_tables, cpu);
+		if (READ_ONCE(t->table_gen) == gen)
+			drops += READ_ONCE(t->drops);
 	}
 
-rsunlock:
-	raw_spin_unlock_irqrestore(&g_lock, flags);
+	return drops;
+}
+
+static ssize_t task_util_bench_proc_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
+{
+	char page[160] = {0};
+	int len;
+
+	mutex_lock(&g_mutex);
+	if (tu_bench_iters)
+		len = snprintf(page, sizeof(page), "iters:%llu cycles/update:%llu ns/update:%llu\n",
+			tu_bench_iters, div64_u64(tu_bench_cycles, tu_bench_iters),
+			div64_u64(tu_bench_ns, tu_bench_iters));
+	else
+		len = snprintf(page, sizeof(page), "not run\n");
+	if (tu_tables)
+		len += snprintf(page + len, sizeof(page) - len, "drops:%llu merge_drops:%llu\n",
+			tu_drops(), READ_ONCE(tu_merge_drops));
+	mutex_unlock(&g_mutex);
+
+	return simple_read_from_buffer(buf, count, ppos, page, len);
 }
 
+static const struct file_operations task_util_bench_proc_ops = {
+	.write		= task_util_bench_proc_write,
+	.read		= task_util_bench_proc_read,
+};
+
 int task_util_init(void)
 {
 	if (unlikely(!game_opt_dir))
 		return -ENOTDIR;
+
+	tu_tables = alloc_percpu(struct tu_table);
+	tu_merge_buf = kcalloc(MAX_TID_COUNT, sizeof(struct tu_merged), GFP_KERNEL);
+	tu_merge_index = kcalloc(TU_MERGE_INDEX_SIZE, sizeof(u16), GFP_KERNEL);
+	if (!tu_tables || !tu_merge_buf || !tu_merge_index) {
+		free_percpu(tu_tables);
+		kfree(tu_merge_buf);
+		kfree(tu_merge_index);
+		tu_tables = NULL;
+		return -ENOMEM;
+	}
+
 	proc_create_data("game_pid", 0664, game_opt_dir, &game_pid_proc_ops, NULL);
 	proc_create_data("heavy_task_info", 0444, game_opt_dir, &heavy_task_info_proc_ops, NULL);
+	proc_create_data("task_util_bench", 0664, game_opt_dir, &task_util_bench_proc_ops, NULL);
 
 	return 0;
 }
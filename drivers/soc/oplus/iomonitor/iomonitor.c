@@ -21,6 +21,7 @@
 #include <linux/delay.h>
 #include <linux/rtc.h>
 #include <linux/iomonitor/iomonitor.h>
+#include <linux/iomonitor/iolat.h>
 #include <linux/module.h>
 #include <linux/wait.h>
 #include <linux/kthread.h>
@@ -1556,6 +1557,7 @@ static int __init io_monitor_init(void)
 	struct proc_dir_entry *interval_entry = NULL;
 	struct proc_dir_entry *size_entry = NULL;
 	struct proc_dir_entry *iotrace_debug = NULL;
+	struct proc_dir_entry *uid_iolat_entry = NULL;
 
 	ret = io_monitor_resource_init();
 	if (ret != 0) {
@@ -1602,6 +1604,13 @@ static int __init io_monitor_init(void)
 			goto err;
 		}
 
+		uid_iolat_entry = create_uid_iolat_proc(IoMonitor_dir);
+		if (!uid_iolat_entry) {
+			printk("io_monitor:create uid_iolat failed.\n");
+			ret = -1;
+			goto err;
+		}
+
 		interval_entry =
 			proc_create("interval", S_IRUGO | S_IWUGO, IoMonitor_dir,
 				&seq_abnormal_interval_fops);
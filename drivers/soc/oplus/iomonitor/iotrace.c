@@ -8,6 +8,7 @@
 #include <linux/module.h>
 #include <linux/blkdev.h>
 #include <linux/percpu.h>
+#include <asm/local.h>
 #include <linux/init.h>
 #include <linux/mutex.h>
 #include <linux/export.h>
@@ -119,18 +120,10 @@ enum TRACE_TYPE {
 #define io_ns_to_ms(ns) ((ns) / 1000000)
 #define IO_MAX_GLOBAL_ENTRY (1024 * 1024)
 
-#define IO_MAX_LOG_PER_GLOBAL \
-	(((IO_MAX_GLOBAL_ENTRY) / sizeof(struct io_trace_log_entry)) - 1)
 #define IO_F_NAME_LEN  (32)
 #define IO_P_NAME_LEN  (16)
 #define IO_TRACE_SYSCALL_TIMEOUT  (1000)
 
-struct io_trace_entry_head {
-	char type;
-	char len;
-	char val[0];
-};
-
 struct io_trace_syscall_entry {
 	unsigned char action;
 	u64 delay;
@@ -176,39 +169,55 @@ struct io_trace_iowait_entry {
 	unsigned long time;
 };
 
+/*
+ * Fixed size record in a per-cpu ring. seq is the 1-based position the
+ * record was written at, 0 while it is being written, so a reader on
+ * another cpu can tell a complete record from a torn or recycled one.
+ */
+struct io_trace_slot {
+	unsigned long seq;
+	unsigned long time;
+	char type;
+	union {
+		struct io_trace_syscall_entry syscall;
+		struct io_trace_blk_entry blk;
+		struct io_trace_dev_entry dev;
+		struct io_trace_iowait_entry iowait;
+	} val;
+};
+
+struct io_trace_cpu_buf {
+	local_t head;		/* number of records ever written */
+	unsigned int mask;	/* slots - 1 */
+	struct io_trace_slot *slots;
+};
+
+struct io_trace_cursor {
+	unsigned long next;	/* seq of the next record to read */
+	unsigned long end;	/* seq of the last record to read */
+	bool valid;
+	struct io_trace_slot slot;
+};
+
 struct io_trace_ctrl {
 	struct platform_device *pdev;
 	unsigned int enable;
 
-	unsigned int size;	/* size of buffer */
-	unsigned int first;	/* start pos of first record */
-	unsigned int last;	/* end pos of last record */
-
-	unsigned char *all_trace_buff;
+	unsigned int slots;	/* records per cpu */
 };
 
 struct iotrace_debug_info {
-	unsigned int pos_err_cnt;
-	int before_loop_pos;
-	unsigned int before_loop_last;
-	ktime_t enter_loop_time;
-	int in_loop_pos;
-	unsigned int in_loop_first;
-	unsigned int in_loop_last;
-	ktime_t err_time;
+	unsigned long torn_cnt;
+	unsigned long out_cnt;
+	ktime_t out_time;
 };
 
 static struct iotrace_debug_info *otrace_dbg_info;
 static struct io_trace_ctrl *io_trace_this;
-static struct io_trace_iowait_entry iowait_entry;
-static struct io_trace_syscall_entry syscall_entry;
-static struct io_trace_blk_entry blk_entry;
-static struct io_trace_dev_entry dev_entry;
+static DEFINE_PER_CPU(struct io_trace_cpu_buf, io_trace_bufs);
 
 static struct ufs_hba *fsr_hba;
-static spinlock_t global_spinlock;
 static struct mutex output_mutex;
-static DEFINE_SPINLOCK(global_spinlock);
 static DEFINE_MUTEX(output_mutex);
 
 static int trace_mm_init(struct io_trace_ctrl *trace_ctrl);
@@ -326,78 +335,31 @@ static inline int is_dev_action(unsigned int action)
 	return 0;
 }
 
-static inline struct io_trace_entry_head *get_entry_head(int pos)
-{
-
-	if (unlikely(pos >= io_trace_this->size))
-		pos %= io_trace_this->size;
-
-	return (struct io_trace_entry_head *)(io_trace_this->all_trace_buff +
-					      pos);
-}
-
-static inline void io_trace_record_log(char type, char entry_size, void *entry)
+/*
+ * Tracepoint probes run with preemption disabled, so the per-cpu ring is
+ * only ever written from this cpu. A writer interrupted by an irq that
+ * traces as well just ends up with the record after the nested one.
+ */
+static inline void io_trace_record_log(char type, char entry_size, void *entry,
+				       unsigned long time)
 {
-	struct io_trace_entry_head *entry_head;
-	int len, first, remain, pos;
-	unsigned long flags;
-
-	len = sizeof(struct io_trace_entry_head) + entry_size;
-	spin_lock_irqsave(&global_spinlock, flags);
-
-	pos = io_trace_this->last % io_trace_this->size;
-	remain = io_trace_this->size - pos;
-
-	/* mark the end of the record */
-	if (unlikely(remain < len)) {
-		entry_head = get_entry_head(pos);
-		entry_head->type = TRACE_END;
-		io_trace_this->last = io_trace_this->size + len;
-		first = 1;
-		pos = 0;
-	} else {
-		if (io_trace_this->first == 0
-		    && io_trace_this->last == io_trace_this->size) {
-			first = 1;
-
-		} else {
-			first = io_trace_this->first;
-
-		}
-		io_trace_this->last += len;
-	}
-	/* mark the start of record */
-	if (first && (first < pos + len)) {
-		if (unlikely(first == 1))
-			first = 0;
-		while (first < pos + len) {
-
-			entry_head = get_entry_head(first);
-			if (entry_head->type == TRACE_END) {
-				first = 0;
-				break;
-			} else {
-				first += entry_head->len;
-			}
-		}
-		if (!first && io_trace_this->last >= io_trace_this->size)
-			io_trace_this->last -= io_trace_this->size;
-		if (first == io_trace_this->size &&
-			io_trace_this->last >= io_trace_this->size) {
-			first -= io_trace_this->size;
-			io_trace_this->last -= io_trace_this->size;
-		}
-		io_trace_this->first = first;
-	}
+	struct io_trace_cpu_buf *cbuf = this_cpu_ptr(&io_trace_bufs);
+	struct io_trace_slot *slot;
+	unsigned long seq;
 
-	spin_unlock_irqrestore(&global_spinlock, flags);
-	entry_head = get_entry_head(pos);
-	entry_head->type = type;
-	entry_head->len = len;
+	if (unlikely(!cbuf->slots))
+		return;
 
-	memcpy(entry_head->val, entry, entry_size);
+	seq = local_inc_return(&cbuf->head);
+	slot = &cbuf->slots[(seq - 1) & cbuf->mask];
 
-	return;
+	WRITE_ONCE(slot->seq, 0);
+	smp_wmb();
+	slot->type = type;
+	slot->time = time;
+	memcpy(&slot->val, entry, entry_size);
+	smp_wmb();
+	WRITE_ONCE(slot->seq, seq);
 }
 
 static void io_trace_global_log(unsigned int action, unsigned long sector,
@@ -416,12 +378,16 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
 		sector = (unsigned long)0;
 
 	if (is_block_action(action)) {
+		struct io_trace_blk_entry blk_entry;
+
 		blk_entry.action = action;
 		blk_entry.rw = rw_flags;
 		blk_entry.sector = sector;
 		blk_entry.nr_bytes = nr_bytes;
 		blk_entry.dev_major = (unsigned char)dev_major;
 		blk_entry.dev_minor = (unsigned char)dev_minor;
+		blk_entry.nr_rqs_sync = 0;
+		blk_entry.nr_rqs_async = 0;
 
 		if (action == BLOCK_GETRQ_TAG) {
 			blk_entry.nr_rqs_sync = (unsigned short)rq->nr_rqs[1];
@@ -437,8 +403,10 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
 
 		io_trace_record_log(TRACE_BLK,
 				    sizeof(struct io_trace_blk_entry),
-				    &blk_entry);
+				    &blk_entry, log_time);
 	} else if (is_dev_action(action)) {
+		struct io_trace_dev_entry dev_entry;
+
 		dev_entry.action = action;
 		dev_entry.rw = rw_flags;
 		dev_entry.sector = sector;
@@ -447,8 +415,10 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
 
 		io_trace_record_log(TRACE_DEV,
 				    sizeof(struct io_trace_dev_entry),
-				    &dev_entry);
+				    &dev_entry, log_time);
 	} else if (action == SCHED_STAT_IOWAIT_TAG) {
+		struct io_trace_iowait_entry iowait_entry;
+
 		iowait_entry.action = action;
 		iowait_entry.pid = tsk->pid;
 		iowait_entry.delay = io_ns_to_ms(delay);
@@ -460,8 +430,10 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
 
 		io_trace_record_log(TRACE_IOWAIT,
 				    sizeof(struct io_trace_iowait_entry),
-				    &iowait_entry);
+				    &iowait_entry, log_time);
 	} else if (is_syscall_action(action)) {
+		struct io_trace_syscall_entry syscall_entry;
+
 		syscall_entry.action = action;
 		syscall_entry.delay = delay;
 		syscall_entry.pid = current->pid;
@@ -475,27 +447,144 @@ static void io_trace_global_log(unsigned int action, unsigned long sector,
 
 		io_trace_record_log(TRACE_SYSCALL,
 				    sizeof(struct io_trace_syscall_entry),
-				    &syscall_entry);
+				    &syscall_entry, log_time);
 	}
 	return;
 }
 
-int write_log_kernel(char **data)
+/* copy out record seq of a cpu ring, false if it was torn or recycled */
+static bool io_trace_read_slot(struct io_trace_cpu_buf *cbuf, unsigned long seq,
+			       struct io_trace_slot *dst)
 {
+	struct io_trace_slot *slot = &cbuf->slots[(seq - 1) & cbuf->mask];
 
-	int ret = -1, pos, before_loop_pos;
-	loff_t file_pos = 0;
+	if (READ_ONCE(slot->seq) != seq)
+		return false;
+	smp_rmb();
+	memcpy(dst, slot, sizeof(*dst));
+	smp_rmb();
+
+	return READ_ONCE(slot->seq) == seq;
+}
+
+static void io_trace_cursor_init(struct io_trace_cursor *cur,
+				 struct io_trace_cpu_buf *cbuf)
+{
+	unsigned long head = local_read(&cbuf->head);
+	unsigned long slots = cbuf->mask + 1;
+
+	cur->end = head;
+	cur->next = head > slots ? head - slots + 1 : 1;
+	cur->valid = false;
+}
+
+static void io_trace_cursor_fill(struct io_trace_cursor *cur,
+				 struct io_trace_cpu_buf *cbuf)
+{
+	cur->valid = false;
+
+	while (cur->next <= cur->end) {
+		if (io_trace_read_slot(cbuf, cur->next++, &cur->slot)) {
+			cur->valid = true;
+			return;
+		}
+		otrace_dbg_info->torn_cnt++;
+	}
+}
+
+static int io_trace_output(struct file *filp, struct io_trace_slot *slot,
+			   loff_t *file_pos)
+{
 	unsigned char buf[512];
 	unsigned len;
-	unsigned int before_loop_last;
-	ktime_t enter_loop_time;
 
 	struct io_trace_iowait_entry *iowait_entry = NULL;
 	struct io_trace_blk_entry *blk_entry = NULL;
 	struct io_trace_dev_entry *dev_entry = NULL;
-	struct io_trace_entry_head *entry_head = NULL;
 	struct io_trace_syscall_entry *syscall_entry = NULL;
 
+	switch (slot->type) {
+	case TRACE_SYSCALL:
+		syscall_entry = &slot->val.syscall;
+		len =
+		    snprintf(buf, sizeof(buf), "%lu %d %d %s %s %llu\n",
+			     syscall_entry->time, syscall_entry->action,
+			     syscall_entry->pid, syscall_entry->comm,
+			     syscall_entry->f_name,
+			     syscall_entry->delay);
+		break;
+	case TRACE_IOWAIT:
+		iowait_entry = &slot->val.iowait;
+		len =
+		    snprintf(buf, sizeof(buf),
+			     "%lu %d %d %s %s %llu %d\n",
+			     iowait_entry->time, iowait_entry->action,
+			     iowait_entry->pid, iowait_entry->comm,
+			     iowait_entry->wchan, iowait_entry->delay,
+			     iowait_entry->ux_flag);
+		break;
+	case TRACE_BLK:
+		blk_entry = &slot->val.blk;
+		if (blk_entry->action == BLOCK_GETRQ_TAG)
+			len =
+			    snprintf(buf, sizeof(buf),
+				     "%lu %d %d %d %d %lu %d %u %u\n",
+				     blk_entry->time, blk_entry->action,
+				     blk_entry->dev_major,
+				     blk_entry->dev_minor,
+				     (unsigned int)(blk_entry->rw),
+				     blk_entry->sector,
+				     blk_entry->nr_bytes,
+				     blk_entry->nr_rqs_sync,
+				     blk_entry->nr_rqs_async);
+		else if (blk_entry->action == BLOCK_RQ_ISSUE_TAG)
+			len =
+			    snprintf(buf, sizeof(buf),
+				     "%lu %d %d %d %d %lu %d %u %u\n",
+				     blk_entry->time, blk_entry->action,
+				     blk_entry->dev_major,
+				     blk_entry->dev_minor,
+				     (unsigned int)(blk_entry->rw),
+				     blk_entry->sector,
+				     blk_entry->nr_bytes,
+				     blk_entry->in_flight_sync,
+				     blk_entry->in_flight_async);
+		else
+			len =
+			    snprintf(buf, sizeof(buf),
+				     "%lu %d %d %d %d %lu %d\n",
+				     blk_entry->time, blk_entry->action,
+				     blk_entry->dev_major,
+				     blk_entry->dev_minor,
+				     (unsigned int)(blk_entry->rw),
+				     blk_entry->sector,
+				     blk_entry->nr_bytes);
+		break;
+	case TRACE_DEV:
+		dev_entry = &slot->val.dev;
+		len =
+		    snprintf(buf, sizeof(buf), "%lu %d %d %lu %d\n",
+			     dev_entry->time, dev_entry->action,
+			     (unsigned int)(dev_entry->rw),
+			     dev_entry->sector, dev_entry->result);
+		break;
+	default:
+		return 0;
+	}
+
+	return kernel_write(filp, buf, len, file_pos);
+}
+
+/*
+ * Dump all cpu rings into filp. Every ring is in time order, so the dump
+ * is a k-way merge on the record time, picking the oldest head each step.
+ */
+int write_log_kernel(char **data)
+{
+	int ret = -1, cpu, best;
+	loff_t file_pos = 0;
+	struct io_trace_cursor *cur = NULL;
+
 	struct file *filp = (struct file *)data;
 
 	if (io_trace_this == NULL) {
@@ -521,119 +610,43 @@ int write_log_kernel(char **data)
 		goto end;
 	}
 
-	pos = io_trace_this->first;
-	before_loop_pos = pos;
-	before_loop_last = io_trace_this->last;
-	enter_loop_time = ktime_get();
-	while (pos >= io_trace_this->first && pos < io_trace_this->last) {
+	cur = kvmalloc_array(nr_cpu_ids, sizeof(*cur), GFP_KERNEL);
+	if (!cur) {
+		io_trace_print("cursor alloc failed!\n");
+		goto end;
+	}
 
-		entry_head = get_entry_head(pos);
+	for_each_possible_cpu(cpu) {
+		struct io_trace_cpu_buf *cbuf = per_cpu_ptr(&io_trace_bufs, cpu);
 
-		/* Check end flag first, avoid illegal memory access */
-		if (entry_head->type == TRACE_END) {
-			pos = io_trace_this->size;
+		cur[cpu].valid = false;
+		if (!cbuf->slots)
 			continue;
-		}
 
-		/* Avoid while dead loop problem, but can cause invalid log */
-		if ((int)entry_head->len <= 0) {
-			if (otrace_dbg_info) {
-				otrace_dbg_info->pos_err_cnt += 1;
-				otrace_dbg_info->before_loop_pos = before_loop_pos;
-				otrace_dbg_info->before_loop_last = before_loop_last;
-				otrace_dbg_info->enter_loop_time = enter_loop_time;
-				otrace_dbg_info->in_loop_pos = pos;
-				otrace_dbg_info->in_loop_first = io_trace_this->first;
-				otrace_dbg_info->in_loop_last = io_trace_this->last;
-				otrace_dbg_info->err_time = ktime_get();
-			}
-			pr_err("IOMonitor: dead loop will happen, but it is circumvented. "
-				"first=%d, last=%d, pos=%d.\n", io_trace_this->first,
-				io_trace_this->last, pos);
-			break;
-		}
-
-		pos += entry_head->len;
+		io_trace_cursor_init(&cur[cpu], cbuf);
+		io_trace_cursor_fill(&cur[cpu], cbuf);
+	}
 
-		switch (entry_head->type) {
-		case TRACE_SYSCALL:
-			syscall_entry =
-			    (struct io_trace_syscall_entry *)entry_head->val;
-			len =
-			    snprintf(buf, sizeof(buf), "%lu %d %d %s %s %llu\n",
-				     syscall_entry->time, syscall_entry->action,
-				     syscall_entry->pid, syscall_entry->comm,
-				     syscall_entry->f_name,
-				     syscall_entry->delay);
-			ret = kernel_write(filp, buf, len, &file_pos);
-			break;
-		case TRACE_IOWAIT:
-			iowait_entry =
-			    (struct io_trace_iowait_entry *)entry_head->val;
-			len =
-			    snprintf(buf, sizeof(buf),
-				     "%lu %d %d %s %s %llu %d\n",
-				     iowait_entry->time, iowait_entry->action,
-				     iowait_entry->pid, iowait_entry->comm,
-				     iowait_entry->wchan, iowait_entry->delay,
-				     iowait_entry->ux_flag);
-			ret = kernel_write(filp, buf, len, &file_pos);
-			break;
-		case TRACE_BLK:
-			blk_entry =
-			    (struct io_trace_blk_entry *)entry_head->val;
-			if (blk_entry->action == BLOCK_GETRQ_TAG)
-				len =
-				    snprintf(buf, sizeof(buf),
-					     "%lu %d %d %d %d %lu %d %u %u\n",
-					     blk_entry->time, blk_entry->action,
-					     blk_entry->dev_major,
-					     blk_entry->dev_minor,
-					     (unsigned int)(blk_entry->rw),
-					     blk_entry->sector,
-					     blk_entry->nr_bytes,
-					     blk_entry->nr_rqs_sync,
-					     blk_entry->nr_rqs_async);
-			else if (blk_entry->action == BLOCK_RQ_ISSUE_TAG)
-				len =
-				    snprintf(buf, sizeof(buf),
-					     "%lu %d %d %d %d %lu %d %u %u\n",
-					     blk_entry->time, blk_entry->action,
-					     blk_entry->dev_major,
-					     blk_entry->dev_minor,
-					     (unsigned int)(blk_entry->rw),
-					     blk_entry->sector,
-					     blk_entry->nr_bytes,
-					     blk_entry->in_flight_sync,
-					     blk_entry->in_flight_async);
-			else
-				len =
-				    snprintf(buf, sizeof(buf),
-					     "%lu %d %d %d %d %lu %d\n",
-					     blk_entry->time, blk_entry->action,
-					     blk_entry->dev_major,
-					     blk_entry->dev_minor,
-					     (unsigned int)(blk_entry->rw),
-					     blk_entry->sector,
-					     blk_entry->nr_bytes);
-			ret = kernel_write(filp, buf, len, &file_pos);
-			break;
-		case TRACE_DEV:
-			dev_entry =
-			    (struct io_trace_dev_entry *)entry_head->val;
-			len =
-			    snprintf(buf, sizeof(buf), "%lu %d %d %lu %d\n",
-				     dev_entry->time, dev_entry->action,
-				     (unsigned int)(dev_entry->rw),
-				     dev_entry->sector, dev_entry->result);
-			ret = kernel_write(filp, buf, len, &file_pos);
-			break;
-		case TRACE_END:
-			break;
+	otrace_dbg_info->out_time = ktime_get();
+	while (1) {
+		best = -1;
+		for_each_possible_cpu(cpu) {
+			if (!cur[cpu].valid)
+				continue;
+			if (best < 0 || cur[cpu].slot.time < cur[best].slot.time)
+				best = cpu;
 		}
+		if (best < 0)
+			break;
+
+		ret = io_trace_output(filp, &cur[best].slot, &file_pos);
+		otrace_dbg_info->out_cnt++;
 
+		io_trace_cursor_fill(&cur[best], per_cpu_ptr(&io_trace_bufs, best));
 	}
 
+	kvfree(cur);
+
  end:
 	io_trace_this->enable = 1;
 	mutex_unlock(&output_mutex);
@@ -920,22 +933,31 @@ static void sched_stat_iowait(void *ignore, struct task_struct *tsk, u64 delay)
 
 static int iotrace_debug_seq_show(struct seq_file *seq, void *offset)
 {
-	seq_printf(seq, "pos_err_cnt: %u\n"
-			"before_loop_pos: %d\n"
-			"before_loop_last: %u\n"
-			"enter_loop_time: %lld\n"
-			"in_loop_pos: %d\n"
-			"in_loop_first: %u\n"
-			"in_loop_last: %u\n"
-			"err_time: %lld\n",
-			otrace_dbg_info->pos_err_cnt,
-			otrace_dbg_info->before_loop_pos,
-			otrace_dbg_info->before_loop_last,
-			otrace_dbg_info->enter_loop_time,
-			otrace_dbg_info->in_loop_pos,
-			otrace_dbg_info->in_loop_first,
-			otrace_dbg_info->in_loop_last,
-			otrace_dbg_info->err_time);
+	struct io_trace_cpu_buf *cbuf;
+	unsigned long head, written = 0, overwritten = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cbuf = per_cpu_ptr(&io_trace_bufs, cpu);
+		head = local_read(&cbuf->head);
+		written += head;
+		seq_printf(seq, "cpu%d: %lu\n", cpu, head);
+		if (head > cbuf->mask + 1)
+			overwritten += head - cbuf->mask - 1;
+	}
+
+	seq_printf(seq, "slots_per_cpu: %u\n"
+			"written: %lu\n"
+			"overwritten: %lu\n"
+			"torn_cnt: %lu\n"
+			"out_cnt: %lu\n"
+			"out_time: %lld\n",
+			io_trace_this ? io_trace_this->slots : 0,
+			written,
+			overwritten,
+			otrace_dbg_info->torn_cnt,
+			otrace_dbg_info->out_cnt,
+			otrace_dbg_info->out_time);
 	return 0;
 }
 
@@ -1013,28 +1035,53 @@ static void io_trace_setup(struct io_trace_ctrl *trace_ctrl)
 
 static int trace_mm_init(struct io_trace_ctrl *trace_ctrl)
 {
+	struct io_trace_cpu_buf *cbuf;
+	int cpu;
+
 	io_trace_print("trace mm init start!\n");
 
-	trace_ctrl->all_trace_buff = kvmalloc(IO_MAX_GLOBAL_ENTRY, GFP_KERNEL);
-	if (trace_ctrl->all_trace_buff == NULL) {
-		io_trace_print("mem mngt kvmalloc failed!\n");
-		goto failed;
+	for_each_possible_cpu(cpu) {
+		cbuf = per_cpu_ptr(&io_trace_bufs, cpu);
+		cbuf->slots = kvmalloc_array(trace_ctrl->slots,
+					     sizeof(struct io_trace_slot),
+					     GFP_KERNEL | __GFP_ZERO);
+		if (cbuf->slots == NULL) {
+			io_trace_print("mem mngt kvmalloc failed!\n");
+			goto failed;
+		}
+		cbuf->mask = trace_ctrl->slots - 1;
+		local_set(&cbuf->head, 0);
 	}
 
 	return 0;
 
  failed:
+	for_each_possible_cpu(cpu) {
+		cbuf = per_cpu_ptr(&io_trace_bufs, cpu);
+		kvfree(cbuf->slots);
+		cbuf->slots = NULL;
+	}
 	return -1;
 }
 
 static int trace_ctrl_init(struct io_trace_ctrl *trace_ctrl,
 			   unsigned int *total_mem)
 {
+	unsigned long slots;
+
+	/*
+	 * keep at least the capacity of the old global buffer, rounding down
+	 * could lose almost half of it
+	 */
+	slots = DIV_ROUND_UP(IO_MAX_GLOBAL_ENTRY, num_possible_cpus() *
+			     sizeof(struct io_trace_slot));
+	slots = roundup_pow_of_two(max(slots, 64UL));
+
 	trace_ctrl->enable = 0;
 	trace_ctrl->pdev = NULL;
-	trace_ctrl->size = IO_MAX_GLOBAL_ENTRY;
-	trace_ctrl->first = 0;
-	trace_ctrl->last = 0;
+	trace_ctrl->slots = slots;
+	*total_mem += slots * sizeof(struct io_trace_slot) *
+		num_possible_cpus();
 	return 0;
 }
 
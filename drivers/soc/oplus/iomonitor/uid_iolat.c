@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Copyright (C) 2018-2020 Oplus. All rights reserved.
+ */
+
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/iomonitor/iolat.h>
+
+/*
+ * Per-UID block latency, recorded at request completion.
+ *
+ * The UID is taken from the task that allocated the request. Requests of
+ * kernel threads, buffered writeback above all, are charged to the owner
+ * of the inode their first page belongs to instead, so the flusher does
+ * not collect the writes of every app. Each cpu keeps its own open
+ * addressed table of UIDs; a reset only bumps iolat_gen and every table
+ * clears itself on its next update.
+ */
+
+#define IOLAT_SLOTS		64
+#define IOLAT_MAX_PROBE		8
+
+struct iolat_table {
+	unsigned int gen;
+	DECLARE_BITMAP(used, IOLAT_SLOTS);
+	struct iolat_uid_record slots[IOLAT_SLOTS];
+	struct iolat_uid_record overflow;
+};
+
+struct iolat_snapshot {
+	size_t len;
+	char data[0];
+};
+
+static DEFINE_PER_CPU(struct iolat_table *, iolat_tables);
+static unsigned int iolat_gen;
+static u64 iolat_since_ns;
+static bool iolat_enable = true;
+
+static inline unsigned int iolat_bucket(u64 us)
+{
+	return min_t(unsigned int, fls64(us), IOLAT_BUCKETS - 1);
+}
+
+static struct iolat_uid_record *iolat_find_or_add(struct iolat_table *t, uid_t uid)
+{
+	unsigned int i, idx = hash_32(uid, ilog2(IOLAT_SLOTS));
+
+	for (i = 0; i < IOLAT_MAX_PROBE; i++, idx = (idx + 1) & (IOLAT_SLOTS - 1)) {
+		if (!test_bit(idx, t->used)) {
+			__set_bit(idx, t->used);
+			t->slots[idx].uid = uid;
+			return &t->slots[idx];
+		}
+		if (t->slots[idx].uid == uid)
+			return &t->slots[idx];
+	}
+
+	return &t->overflow;
+}
+
+/* owner of the file cached in the first page of rq, if it has one */
+static uid_t iolat_owner_uid(struct request *rq)
+{
+	struct address_space *mapping;
+
+	if (!rq->bio || !bio_has_data(rq->bio))
+		return IOLAT_WRITEBACK_UID;
+
+	/* the page is locked or under writeback, so its mapping is stable */
+	mapping = page_mapping(bio_page(rq->bio));
+	if (!mapping || !mapping->host)
+		return IOLAT_WRITEBACK_UID;
+
+	return from_kuid_munged(&init_user_ns, mapping->host->i_uid);
+}
+
+static inline void iolat_add(struct iolat_uid_record *r, int dir, int stage, u64 us)
+{
+	r->sum_us[dir][stage] += us;
+	r->hist[dir][stage][iolat_bucket(us)]++;
+}
+
+void iomonitor_record_iolat(struct request *rq)
+{
+	struct iolat_table *t;
+	struct iolat_uid_record *r;
+	u64 now, issue;
+	unsigned long flags;
+	unsigned int gen;
+	uid_t uid;
+	int dir;
+
+	if (!iolat_enable)
+		return;
+
+	switch (req_op(rq)) {
+	case REQ_OP_READ:
+		dir = IOLAT_READ;
+		break;
+	case REQ_OP_WRITE:
+		dir = IOLAT_WRITE;
+		break;
+	default:
+		return;
+	}
+
+	issue = ktime_to_ns(rq->req_td);
+	if (!issue || issue < rq->start_time_ns)
+		return;
+
+	now = ktime_get_ns();
+	if (now < issue)
+		return;
+
+	uid = rq->req_uid;
+	if (uid == IOLAT_WRITEBACK_UID)
+		uid = iolat_owner_uid(rq);
+
+	/* completions may nest from hardirq into softirq on the same cpu */
+	local_irq_save(flags);
+	t = this_cpu_read(iolat_tables);
+	if (unlikely(!t))
+		goto out;
+
+	gen = READ_ONCE(iolat_gen);
+	if (unlikely(t->gen != gen)) {
+		memset(t, 0, sizeof(*t));
+		t->overflow.uid = IOLAT_OVERFLOW_UID;
+		t->gen = gen;
+	}
+
+	r = iolat_find_or_add(t, uid);
+	r->count[dir]++;
+	iolat_add(r, dir, IOLAT_QUEUE, (issue - rq->start_time_ns) / NSEC_PER_USEC);
+	iolat_add(r, dir, IOLAT_DEVICE, (now - issue) / NSEC_PER_USEC);
+out:
+	local_irq_restore(flags);
+}
+
+static void iolat_merge(struct iolat_uid_record *out, unsigned int *nr,
+			const struct iolat_uid_record *r)
+{
+	struct iolat_uid_record *dst = NULL;
+	unsigned int i, j, k;
+
+	if (!r->count[IOLAT_READ] && !r->count[IOLAT_WRITE])
+		return;
+
+	for (i = 0; i < *nr; i++) {
+		if (out[i].uid == r->uid) {
+			dst = &out[i];
+			break;
+		}
+	}
+
+	if (!dst) {
+		dst = &out[(*nr)++];
+		memset(dst, 0, sizeof(*dst));
+		dst->uid = r->uid;
+	}
+
+	for (i = 0; i < IOLAT_DIRS; i++) {
+		dst->count[i] += READ_ONCE(r->count[i]);
+		for (j = 0; j < IOLAT_STAGES; j++) {
+			dst->sum_us[i][j] += READ_ONCE(r->sum_us[i][j]);
+			for (k = 0; k < IOLAT_BUCKETS; k++)
+				dst->hist[i][j][k] += READ_ONCE(r->hist[i][j][k]);
+		}
+	}
+}
+
+static int uid_iolat_open(struct inode *inode, struct file *file)
+{
+	struct iolat_snapshot *snap;
+	struct iolat_header *hdr;
+	struct iolat_uid_record *out;
+	struct iolat_table *t;
+	unsigned int nr = 0, gen, i;
+	size_t max;
+	int cpu;
+
+	max = num_possible_cpus() * (IOLAT_SLOTS + 1);
+	snap = kvmalloc(sizeof(*snap) + sizeof(*hdr) + max * sizeof(*out),
+			GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	hdr = (struct iolat_header *)snap->data;
+	out = (struct iolat_uid_record *)(hdr + 1);
+	gen = READ_ONCE(iolat_gen);
+
+	for_each_possible_cpu(cpu) {
+		t = per_cpu(iolat_tables, cpu);
+		if (!t || READ_ONCE(t->gen) != gen)
+			continue;
+
+		for_each_set_bit(i, t->used, IOLAT_SLOTS)
+			iolat_merge(out, &nr, &t->slots[i]);
+		iolat_merge(out, &nr, &t->overflow);
+	}
+
+	hdr->magic = IOLAT_MAGIC;
+	hdr->version = IOLAT_VERSION;
+	hdr->nr_buckets = IOLAT_BUCKETS;
+	hdr->nr_records = nr;
+	hdr->since_ns = iolat_since_ns;
+	snap->len = sizeof(*hdr) + nr * sizeof(*out);
+
+	file->private_data = snap;
+
+	return 0;
+}
+
+static ssize_t uid_iolat_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct iolat_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->data, snap->len);
+}
+
+/* "reset" clears all histograms, "0"/"1" stops/starts recording */
+static ssize_t uid_iolat_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	char page[16] = {0};
+	unsigned int val;
+	int ret;
+
+	ret = simple_write_to_buffer(page, sizeof(page) - 1, ppos, buf, count);
+	if (ret <= 0)
+		return ret;
+
+	if (!strncmp(page, "reset", 5)) {
+		iolat_since_ns = ktime_get_ns();
+		WRITE_ONCE(iolat_gen, iolat_gen + 1);
+	} else if (!kstrtouint(strim(page), 0, &val)) {
+		iolat_enable = !!val;
+	} else {
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static int uid_iolat_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations proc_uid_iolat_operations = {
+	.open = uid_iolat_open,
+	.read = uid_iolat_read,
+	.write = uid_iolat_write,
+	.llseek = default_llseek,
+	.release = uid_iolat_release,
+};
+
+struct proc_dir_entry *create_uid_iolat_proc(struct proc_dir_entry *parent)
+{
+	struct iolat_table **tables;
+	int cpu;
+
+	/* publish the tables only once all of them are allocated */
+	tables = kcalloc(nr_cpu_ids, sizeof(*tables), GFP_KERNEL);
+	if (!tables)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		tables[cpu] = kvzalloc(sizeof(struct iolat_table), GFP_KERNEL);
+		if (!tables[cpu])
+			goto err;
+		tables[cpu]->overflow.uid = IOLAT_OVERFLOW_UID;
+	}
+
+	for_each_possible_cpu(cpu)
+		per_cpu(iolat_tables, cpu) = tables[cpu];
+	kfree(tables);
+	iolat_since_ns = ktime_get_ns();
+
+	return proc_create("uid_iolat", S_IRUGO | S_IWUSR, parent,
+			   &proc_uid_iolat_operations);
+
+err:
+	for_each_possible_cpu(cpu)
+		kvfree(tables[cpu]);
+	kfree(tables);
+	return NULL;
+}
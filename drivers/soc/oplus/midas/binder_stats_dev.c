@@ -28,13 +28,14 @@
 #include <linux/rbtree.h>
 #include <linux/android/binder.h>
 #include <linux/hashtable.h>
+#include <linux/rculist.h>
 
 #if defined(CONFIG_OPLUS_FEATURE_BINDER_STATS_ENABLE)
 
 #define BINDER_STATS_LOGI(...)
 #define BINDER_STATS_LOGE pr_err
 
-#define BINDER_STATS_CTL_VERSION_CODE 1
+#define BINDER_STATS_CTL_VERSION_CODE 3
 
 #define BINDER_STATS_CTL_GET_VERSION 100
 #define BINDER_STATS_CTL_ENABLE 101
@@ -53,6 +54,12 @@
 #define BINDER_STATS_DEFAULT_MAX_COUNT 4096
 #define BINDER_STATS_HASH_ORDER 9
 #define BINDER_STATS_FILTER_LIMIT_MAX 128
+#define BINDER_STATS_LAT_MAX_COUNT 512
+#define BINDER_STATS_LAT_BUCKETS 20
+#define BINDER_STATS_PCPU_SLOTS 512
+#define BINDER_STATS_PCPU_MAX_PROBE 16
+#define BINDER_STATS_MAX_USERS 16
+#define BINDER_STATS_FILTER_GEN_SHIFT 16
 
 /* import from binder driver */
 struct binder_notify {
@@ -60,6 +67,18 @@ struct binder_notify {
 	struct task_struct *binder_task;
 	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
 	bool pending_async;
+	unsigned long *filter_cache;
+};
+
+#define BINDER_NOTIFY_TRANSACTION 0
+#define BINDER_NOTIFY_LATENCY 1
+
+struct binder_latency_notify {
+	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
+	unsigned int code;
+	bool oneway;
+	u64 queue_ns;
+	u64 exec_ns;
 };
 extern int register_binderevent_notifier(struct notifier_block *nb);
 extern int unregister_binderevent_notifier(struct notifier_block *nb);
@@ -98,9 +117,77 @@ struct binder_stats {
 
 struct binder_stats_item_ref {
 	struct hlist_node hentry;
+	u64 key;
 	struct binder_stats_item *item;
 };
 
+/*
+ * binder_stats_pcpu_table : call counts collected on one cpu.
+ * Open addressed by the 64-bit item key, key 0 marks a free slot.
+ * Calls that find no slot within BINDER_STATS_PCPU_MAX_PROBE are dropped
+ * and counted in dropped.
+ */
+struct binder_stats_pcpu_slot {
+	u64 key;
+	struct binder_stats_item item;
+};
+
+struct binder_stats_pcpu_table {
+	unsigned int valid_slot_cnt;
+	unsigned int dropped;
+	struct binder_stats_pcpu_slot slots[BINDER_STATS_PCPU_SLOTS];
+};
+
+enum {
+	BINDER_STATS_LAT_QUEUE,	/* send -> dequeue by the target thread */
+	BINDER_STATS_LAT_EXEC,	/* dequeue -> reply */
+	BINDER_STATS_LAT_TOTAL,	/* send -> reply */
+	BINDER_STATS_LAT_STAGES,
+};
+
+/*
+ * binder_stats_latency_item : per (service, code) latency.
+ * hist[stage][i] counts calls that took [2^(i-1), 2^i) us, bucket 0 is
+ * below 1us and the last bucket is open ended. Oneway calls only have
+ * the queue stage.
+ */
+struct binder_stats_latency_item {
+	char service_name[OPLUS_MAX_SERVICE_NAME_LEN];
+	unsigned int code;
+	unsigned int oneway;
+	unsigned int count;
+	unsigned int max_us[BINDER_STATS_LAT_STAGES];
+	unsigned long long sum_us[BINDER_STATS_LAT_STAGES];
+	unsigned int hist[BINDER_STATS_LAT_STAGES][BINDER_STATS_LAT_BUCKETS];
+};
+
+/*
+ * binder_stats_latency : follows items[max_item_cnt] of struct binder_stats
+ * in the same mmap buffer, at binder_stats_latency_offset(max_item_cnt).
+ * Version 1 readers never look past items[] so the layout stays compatible.
+ */
+struct binder_stats_latency {
+	unsigned int max_item_cnt;
+	unsigned int valid_item_cnt;
+	struct binder_stats_latency_item items[BINDER_STATS_LAT_MAX_COUNT];
+};
+
+/*
+ * binder_stats_drops : follows struct binder_stats_latency in the same mmap
+ * buffer, at binder_stats_drops_offset(max_item_cnt). dropped[cpu] is the
+ * number of calls since the last update that found no slot in that cpu's
+ * table, nr_cpus entries are valid. Added in version 3.
+ */
+struct binder_stats_drops {
+	unsigned int nr_cpus;
+	unsigned int dropped[];
+};
+
+struct binder_stats_latency_ref {
+	struct hlist_node hentry;
+	struct binder_stats_latency_item *item;
+};
+
 struct binder_stats_driver {
 	dev_t dev;
 	struct cdev cdev;
@@ -112,6 +199,7 @@ struct binder_stats_driver {
 	struct list_head user_list_head;
 	bool regist_binder_stats_flag;
 	spinlock_t user_list_lock;
+	unsigned long user_filter_bits;
 };
 
 struct binder_stats_filter_srv_name {
@@ -155,6 +243,12 @@ struct binder_stats_user_context {
 	struct binder_stats *binder_stats_buf_1; /* double swap buffer 1 */
 	struct binder_stats_item_ref *kernel_binder_stats_refs;
 	DECLARE_HASHTABLE(kernel_binder_stats_hash, BINDER_STATS_HASH_ORDER);
+	struct binder_stats_latency_ref *kernel_latency_refs;
+	DECLARE_HASHTABLE(kernel_latency_hash, BINDER_STATS_HASH_ORDER);
+	/* writers fill pcpu_tables[pcpu_active], the reader merges the other */
+	struct binder_stats_pcpu_table **pcpu_tables[2];
+	int pcpu_active;
+	int filter_bit;
 	struct binder_stats *kernel_binder_stats;
 	struct binder_stats *user_binder_stats;
 	bool user_mmap_flag;
@@ -174,49 +268,65 @@ struct binder_stats_user_context {
 
 struct binder_stats_driver g_binder_stats_driver;
 
-/* key is from caller_comm & binder_comm && service_name */
-static inline long long hash_key(struct binder_notify *bn, int enable_binder_comm) {
-	long long key = 0;
-	int i;
-	long long *v1 = (long long *)bn->caller_task->comm;
-	long long *v2 = (long long *)bn->binder_task->comm;
-	long long *v3 = (long long *)bn->service_name;
-	for (i = 0; i < TASK_COMM_LEN/sizeof(long long); ++i) {
-		if (1 == enable_binder_comm)
-			key += (v1[i] + v2[i]);
-		else
-			key += v1[i];
-	}
-	for (i = 0; i < OPLUS_MAX_SERVICE_NAME_LEN/sizeof(long long); ++i) {
-		key += v3[i];
+static inline size_t binder_stats_latency_offset(int max_item_cnt) {
+	return ALIGN(offsetof(struct binder_stats, items) +
+		max_item_cnt * sizeof(struct binder_stats_item), sizeof(u64));
+}
+
+static inline struct binder_stats_latency *binder_stats_latency(struct binder_stats *stats) {
+	return (struct binder_stats_latency *)((char *)stats +
+		binder_stats_latency_offset(stats->max_item_cnt));
+}
+
+static inline size_t binder_stats_drops_offset(int max_item_cnt) {
+	return binder_stats_latency_offset(max_item_cnt) +
+		ALIGN(sizeof(struct binder_stats_latency), sizeof(u64));
+}
+
+static inline struct binder_stats_drops *binder_stats_drops(struct binder_stats *stats) {
+	return (struct binder_stats_drops *)((char *)stats +
+		binder_stats_drops_offset(stats->max_item_cnt));
+}
+
+/*
+ * Bumped whenever the set of enabled users changes. binder_node caches
+ * (gen << BINDER_STATS_FILTER_GEN_SHIFT | mask of interested users), so
+ * the filters only run again for a node after a user came or went.
+ */
+static unsigned long binder_stats_filter_gen = 1;
+
+#define BINDER_STATS_FNV_PRIME 0x100000001b3ULL
+#define BINDER_STATS_FNV_BASIS 0xcbf29ce484222325ULL
+
+static inline u64 hash_add_str(u64 h, const char *str, unsigned int len) {
+	unsigned int i;
+
+	for (i = 0; i < len && str[i]; ++i) {
+		h ^= (unsigned char)str[i];
+		h *= BINDER_STATS_FNV_PRIME;
 	}
-	return key;
+	/* separator, so that "ab"+"c" and "a"+"bc" differ */
+	h ^= 0xff;
+	h *= BINDER_STATS_FNV_PRIME;
+	return h;
 }
 
-static inline bool hash_match(struct binder_notify *bn, struct binder_stats_item *stats_item, int enable_binder_comm) {
-	struct task_struct *caller_proc_task = NULL;
-	struct task_struct *binder_proc_task = NULL;
-	if (NULL != bn->caller_task->group_leader)
-		caller_proc_task = bn->caller_task->group_leader;
-	else
-		caller_proc_task = bn->caller_task;
+/* key is from caller_comm & caller_proc_comm & service_name & binder_proc_comm */
+static inline u64 hash_key(struct binder_notify *bn) {
+	struct task_struct *caller_proc_task = bn->caller_task->group_leader ?: bn->caller_task;
+	struct task_struct *binder_proc_task = bn->binder_task->group_leader ?: bn->binder_task;
+	u64 key = BINDER_STATS_FNV_BASIS;
 
-	if (NULL != bn->binder_task->group_leader)
-		binder_proc_task = bn->binder_task->group_leader;
-	else
-		binder_proc_task = bn->binder_task;
-
-	if (1 == enable_binder_comm)
-		return (0 == strncmp(stats_item->caller_comm, bn->caller_task->comm, TASK_COMM_LEN)
-			&& 0 == strncmp(stats_item->caller_proc_comm, caller_proc_task->comm, TASK_COMM_LEN)
-			&& 0 == strncmp(stats_item->service_name, bn->service_name, OPLUS_MAX_SERVICE_NAME_LEN)
-			&& 0 == strncmp(stats_item->binder_comm, bn->binder_task->comm, TASK_COMM_LEN)
-			&& 0 == strncmp(stats_item->binder_proc_comm, binder_proc_task->comm, TASK_COMM_LEN));
-	else
-		return (0 == strncmp(stats_item->caller_comm, bn->caller_task->comm, TASK_COMM_LEN)
-			 && 0 == strncmp(stats_item->caller_proc_comm, caller_proc_task->comm, TASK_COMM_LEN)
-			 && 0 == strncmp(stats_item->service_name, bn->service_name, OPLUS_MAX_SERVICE_NAME_LEN)
-			 && 0 == strncmp(stats_item->binder_proc_comm, binder_proc_task->comm, TASK_COMM_LEN));
+	key = hash_add_str(key, bn->caller_task->comm, TASK_COMM_LEN);
+	key = hash_add_str(key, caller_proc_task->comm, TASK_COMM_LEN);
+	key = hash_add_str(key, bn->service_name, OPLUS_MAX_SERVICE_NAME_LEN);
+	key = hash_add_str(key, binder_proc_task->comm, TASK_COMM_LEN);
+	return key;
+}
+
+/* binder_comm extends the base key when enable_binder_comm is set */
+static inline u64 hash_key_binder_comm(struct binder_notify *bn, u64 base_key) {
+	return hash_add_str(base_key, bn->binder_task->comm, TASK_COMM_LEN);
 }
 
 static inline long long hash_key_for_str(const char *str, unsigned int len) {
@@ -289,110 +399,332 @@ static bool intreresting_filter(struct binder_stats_user_context *context_ptr,
 	return intreresting;
 }
 
+/* mask of the enabled users interested in this call, cached per binder_node */
+static unsigned long binder_stats_filter_mask(struct binder_notify *bn) {
+	struct binder_stats_user_context *context_ptr;
+	unsigned long gen, cache, mask = 0;
+
+	gen = smp_load_acquire(&binder_stats_filter_gen);
+	if (NULL != bn->filter_cache) {
+		cache = READ_ONCE(*bn->filter_cache);
+		if ((cache >> BINDER_STATS_FILTER_GEN_SHIFT) == gen)
+			return cache & (BIT(BINDER_STATS_FILTER_GEN_SHIFT) - 1);
+	}
+
+	list_for_each_entry_rcu(context_ptr, &g_binder_stats_driver.user_list_head, list_node) {
+		if (intreresting_filter(context_ptr, bn))
+			mask |= BIT(context_ptr->filter_bit);
+	}
+
+	if (NULL != bn->filter_cache)
+		WRITE_ONCE(*bn->filter_cache, (gen << BINDER_STATS_FILTER_GEN_SHIFT) | mask);
+
+	return mask;
+}
+
+static void binder_stats_fill_item(struct binder_stats_item *item, struct binder_notify *data,
+	int enable_binder_comm) {
+	struct task_struct *caller_task = data->caller_task;
+	struct task_struct *binder_task = data->binder_task;
+
+	/* caller proc comm */
+	if (NULL != caller_task->group_leader)
+		strncpy(item->caller_proc_comm, caller_task->group_leader->comm, TASK_COMM_LEN);
+	else
+		strncpy(item->caller_proc_comm, caller_task->comm, TASK_COMM_LEN);
+
+	/* caller pid tgid uid */
+	item->caller_pid = task_pid_nr(caller_task);
+	item->caller_tgid = task_tgid_nr(caller_task);
+	item->caller_uid = from_kuid_munged(current_user_ns(), task_uid(caller_task));
+	/* caller comm */
+	strncpy(item->caller_comm, caller_task->comm, TASK_COMM_LEN);
+
+	/* service name */
+	strncpy(item->service_name, data->service_name, OPLUS_MAX_SERVICE_NAME_LEN);
+
+	/* binder proc comm */
+	if (NULL != binder_task->group_leader)
+		strncpy(item->binder_proc_comm, binder_task->group_leader->comm, TASK_COMM_LEN);
+	else
+		strncpy(item->binder_proc_comm, binder_task->comm, TASK_COMM_LEN);
+
+	/* binder tgid uid */
+	item->binder_tgid = task_tgid_nr(binder_task);
+	item->binder_uid = from_kuid_munged(current_user_ns(), task_uid(binder_task));
+
+	/* binder comm pid */
+	if (1 == enable_binder_comm) {
+		item->binder_pid = task_pid_nr(binder_task);
+		strncpy(item->binder_comm, binder_task->comm, TASK_COMM_LEN);
+	} else {
+		item->binder_pid = item->binder_tgid;
+		strncpy(item->binder_comm, "binderTh", TASK_COMM_LEN);
+	}
+}
+
+static void binder_stats_pcpu_add(struct binder_stats_pcpu_table *table, u64 key,
+	struct binder_notify *data, int enable_binder_comm) {
+	struct binder_stats_pcpu_slot *slot;
+	unsigned int i, idx = key & (BINDER_STATS_PCPU_SLOTS - 1);
+
+	for (i = 0; i < BINDER_STATS_PCPU_MAX_PROBE; ++i, idx = (idx + 1) & (BINDER_STATS_PCPU_SLOTS - 1)) {
+		slot = &table->slots[idx];
+		if (slot->key == key) {
+			slot->item.call_count++;
+			return;
+		}
+		if (0 == slot->key) {
+			binder_stats_fill_item(&slot->item, data, enable_binder_comm);
+			slot->item.call_count = 1;
+			slot->key = key;
+			table->valid_slot_cnt++;
+			return;
+		}
+	}
+	table->dropped++;
+}
+
+/*
+ * Called for every binder call, under the notifier chain's rcu_read_lock.
+ * Only touches this cpu's table, user_binder_stats is filled by the reader
+ * in user_update_binder_stats().
+ */
 static void store_binder_stats_to_kernel(struct binder_notify *data) {
-	struct binder_stats_item *find_item = NULL;
-	unsigned long flags, ctx_flag;
-	struct binder_stats *kernel_binder_stats = NULL;
-	struct binder_stats_item_ref *ref_hash_node;
 	struct binder_stats_user_context *context_ptr = NULL;
-	struct task_struct *caller_task = NULL;
-	struct task_struct *binder_task = NULL;
+	struct binder_stats_pcpu_table *table;
+	unsigned long filter_mask;
+	u64 base_key, full_key = 0, key;
+	int cpu;
 
 	if (NULL == data || NULL == data->caller_task || NULL == data->binder_task)
 		return;
 
-	caller_task = data->caller_task;
-	binder_task = data->binder_task;
+	filter_mask = binder_stats_filter_mask(data);
+	if (0 == filter_mask)
+		return;
 
-	/* BINDER_STATS_LOGI("%d(%s) => (%s)(%s) %d(%s)\n", caller_task->pid, caller_task->comm,
-			data->service_name, binder_task->comm, binder_task->pid, binder_task->comm); */
+	base_key = hash_key(data);
 
-	spin_lock_irqsave(&g_binder_stats_driver.user_list_lock, flags);
+	cpu = get_cpu();
+
+	list_for_each_entry_rcu(context_ptr, &g_binder_stats_driver.user_list_head, list_node) {
+		if (!(filter_mask & BIT(context_ptr->filter_bit)))
+			continue;
 
-	list_for_each_entry(context_ptr, &g_binder_stats_driver.user_list_head, list_node) {
+		if (1 == context_ptr->enable_binder_comm) {
+			if (0 == full_key)
+				full_key = hash_key_binder_comm(data, base_key);
+			key = full_key;
+		} else {
+			key = base_key;
+		}
+		/* key 0 marks a free slot */
+		key = key ?: 1;
+
+		table = context_ptr->pcpu_tables[READ_ONCE(context_ptr->pcpu_active)][cpu];
+		binder_stats_pcpu_add(table, key, data, context_ptr->enable_binder_comm);
+	}
+
+	put_cpu();
+}
+
+/* only the service name filter applies, the other filters need the tasks */
+static bool latency_intreresting_filter(struct binder_stats_user_context *context_ptr,
+	struct binder_latency_notify *ln) {
+	struct binder_stats_filter_srv_name_node *hash_node_srv_name;
+
+	hash_for_each_possible(context_ptr->intre_srv_name_hash, hash_node_srv_name, hentry,
+		hash_key_for_str(ln->service_name, strlen(ln->service_name))) {
+		if (0 == strcmp(hash_node_srv_name->service_name, ln->service_name))
+			return hash_node_srv_name->intreresting;
+	}
+
+	return !context_ptr->has_intr_srv_name;
+}
+
+static inline void latency_stage_add(struct binder_stats_latency_item *item, int stage, u64 ns) {
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	item->sum_us[stage] += us;
+	if (us > item->max_us[stage])
+		item->max_us[stage] = min_t(u64, us, UINT_MAX);
+	item->hist[stage][min_t(unsigned int, fls64(us), BINDER_STATS_LAT_BUCKETS - 1)]++;
+}
+
+static void store_binder_latency_to_kernel(struct binder_latency_notify *ln) {
+	struct binder_stats_latency_item *find_item = NULL;
+	unsigned long ctx_flag;
+	struct binder_stats_latency *kernel_latency = NULL;
+	struct binder_stats_latency_ref *ref_hash_node;
+	struct binder_stats_user_context *context_ptr = NULL;
+	long long key;
+
+	if (NULL == ln)
+		return;
+
+	key = hash_key_for_str(ln->service_name, strlen(ln->service_name)) + ln->code;
+
+	/* under the notifier chain's rcu_read_lock */
+	list_for_each_entry_rcu(context_ptr, &g_binder_stats_driver.user_list_head, list_node) {
 		if (NULL == context_ptr || NULL == context_ptr->kernel_binder_stats ||
-				NULL == context_ptr->kernel_binder_stats_refs)
+				NULL == context_ptr->kernel_latency_refs)
 			continue;
 
 		find_item = NULL;
 
-		if (!intreresting_filter(context_ptr, data))
+		if (!latency_intreresting_filter(context_ptr, ln))
 			continue;
 
 		spin_lock_irqsave(&context_ptr->buf_lock, ctx_flag);
 
-		kernel_binder_stats = context_ptr->kernel_binder_stats;
+		kernel_latency = binder_stats_latency(context_ptr->kernel_binder_stats);
 
-		/* find current item with hash */
-		hash_for_each_possible(context_ptr->kernel_binder_stats_hash, ref_hash_node, hentry, hash_key(data, context_ptr->enable_binder_comm)) {
-			if (hash_match(data, ref_hash_node->item, context_ptr->enable_binder_comm)) {
+		hash_for_each_possible(context_ptr->kernel_latency_hash, ref_hash_node, hentry, key) {
+			if (ref_hash_node->item->code == ln->code &&
+					0 == strncmp(ref_hash_node->item->service_name, ln->service_name,
+						OPLUS_MAX_SERVICE_NAME_LEN)) {
 				find_item = ref_hash_node->item;
 				break;
 			}
 		}
 
+		if (NULL == find_item && kernel_latency->valid_item_cnt < kernel_latency->max_item_cnt) {
+			find_item = &(kernel_latency->items[kernel_latency->valid_item_cnt]);
+			memset(find_item, 0, sizeof(*find_item));
+			strncpy(find_item->service_name, ln->service_name, OPLUS_MAX_SERVICE_NAME_LEN);
+			find_item->code = ln->code;
+			find_item->oneway = ln->oneway;
+
+			ref_hash_node = &(context_ptr->kernel_latency_refs[kernel_latency->valid_item_cnt]);
+			ref_hash_node->item = find_item;
+			hash_add(context_ptr->kernel_latency_hash, &ref_hash_node->hentry, key);
+
+			kernel_latency->valid_item_cnt++;
+		}
+
 		if (NULL != find_item) {
-			find_item->call_count++;
-		} else {
-			if (kernel_binder_stats->valid_item_cnt + 1 <= kernel_binder_stats->max_item_cnt) {
-				find_item = &(kernel_binder_stats->items[kernel_binder_stats->valid_item_cnt]);
-
-				/* caller proc comm */
-				if (NULL != caller_task->group_leader)
-					strncpy(find_item->caller_proc_comm, caller_task->group_leader->comm, TASK_COMM_LEN);
-				else
-					strncpy(find_item->caller_proc_comm, caller_task->comm, TASK_COMM_LEN);
-
-				/* caller pid tgid uid */
-				find_item->caller_pid = task_pid_nr(caller_task);
-				find_item->caller_tgid = task_tgid_nr(caller_task);
-				find_item->caller_uid = from_kuid_munged(current_user_ns(), task_uid(caller_task));
-				/* caller comm */
-				strncpy(find_item->caller_comm, caller_task->comm, TASK_COMM_LEN);
-
-				/* service name */
-				strncpy(find_item->service_name, data->service_name, OPLUS_MAX_SERVICE_NAME_LEN);
-
-				/* binder proc comm */
-				if (NULL != binder_task->group_leader)
-					strncpy(find_item->binder_proc_comm, binder_task->group_leader->comm, TASK_COMM_LEN);
-				else
-					strncpy(find_item->binder_proc_comm, binder_task->comm, TASK_COMM_LEN);
-
-				/* binder tgid uid */
-				find_item->binder_tgid = task_tgid_nr(binder_task);
-				find_item->binder_uid = from_kuid_munged(current_user_ns(), task_uid(binder_task));
-
-				/* binder comm pid */
-				if (1 == context_ptr->enable_binder_comm) {
-					find_item->binder_pid = task_pid_nr(binder_task);
-					strncpy(find_item->binder_comm, binder_task->comm, TASK_COMM_LEN);
-				} else {
-					find_item->binder_pid = find_item->binder_tgid;
-					strncpy(find_item->binder_comm, "binderTh", TASK_COMM_LEN);
+			find_item->count++;
+			latency_stage_add(find_item, BINDER_STATS_LAT_QUEUE, ln->queue_ns);
+			if (!ln->oneway) {
+				latency_stage_add(find_item, BINDER_STATS_LAT_EXEC, ln->exec_ns);
+				latency_stage_add(find_item, BINDER_STATS_LAT_TOTAL,
+					ln->queue_ns + ln->exec_ns);
+			}
+		}
+
+		spin_unlock_irqrestore(&context_ptr->buf_lock, ctx_flag);
+	}
+}
+
+/* called with g_binder_stats_driver.lock held */
+static void binder_stats_bump_filter_gen(void) {
+	unsigned long gen = (binder_stats_filter_gen + 1) &
+		(ULONG_MAX >> BINDER_STATS_FILTER_GEN_SHIFT);
+
+	/* 0 would match a node that never cached anything */
+	smp_store_release(&binder_stats_filter_gen, gen ?: 1);
+}
+
+static void binder_stats_free_pcpu_tables(struct binder_stats_user_context *context_ptr) {
+	int i, cpu;
+
+	for (i = 0; i < 2; ++i) {
+		if (NULL == context_ptr->pcpu_tables[i])
+			continue;
+		for_each_possible_cpu(cpu)
+			vfree(context_ptr->pcpu_tables[i][cpu]);
+		kfree(context_ptr->pcpu_tables[i]);
+		context_ptr->pcpu_tables[i] = NULL;
+	}
+}
+
+static int binder_stats_alloc_pcpu_tables(struct binder_stats_user_context *context_ptr) {
+	int i, cpu;
+
+	for (i = 0; i < 2; ++i) {
+		context_ptr->pcpu_tables[i] = kcalloc(nr_cpu_ids,
+			sizeof(struct binder_stats_pcpu_table *), GFP_KERNEL);
+		if (NULL == context_ptr->pcpu_tables[i])
+			goto alloc_fail;
+		for_each_possible_cpu(cpu) {
+			context_ptr->pcpu_tables[i][cpu] = vzalloc(sizeof(struct binder_stats_pcpu_table));
+			if (NULL == context_ptr->pcpu_tables[i][cpu])
+				goto alloc_fail;
+		}
+	}
+	context_ptr->pcpu_active = 0;
+
+	return 0;
+
+alloc_fail:
+	binder_stats_free_pcpu_tables(context_ptr);
+	return -1;
+}
+
+/* move the counts writers collected since the last update into stats */
+static void binder_stats_merge_pcpu_tables(struct binder_stats_user_context *context_ptr,
+	struct binder_stats *stats) {
+	struct binder_stats_pcpu_table *table;
+	struct binder_stats_pcpu_slot *slot;
+	struct binder_stats_item_ref *ref_hash_node;
+	struct binder_stats_item *find_item;
+	struct binder_stats_drops *drops = binder_stats_drops(stats);
+	struct hlist_node *tmp;
+	int idx = context_ptr->pcpu_active;
+	int cpu, i;
+
+	/* retire the active tables and wait out writers still using them */
+	WRITE_ONCE(context_ptr->pcpu_active, !idx);
+	synchronize_rcu();
+
+	stats->valid_item_cnt = 0;
+
+	for_each_possible_cpu(cpu) {
+		table = context_ptr->pcpu_tables[idx][cpu];
+		drops->dropped[cpu] = table->dropped;
+		table->dropped = 0;
+		for (i = 0; i < BINDER_STATS_PCPU_SLOTS && table->valid_slot_cnt; ++i) {
+			slot = &table->slots[i];
+			if (0 == slot->key)
+				continue;
+
+			find_item = NULL;
+			hash_for_each_possible(context_ptr->kernel_binder_stats_hash, ref_hash_node, hentry, slot->key) {
+				if (ref_hash_node->key == slot->key) {
+					find_item = ref_hash_node->item;
+					break;
 				}
+			}
 
-				/* call count init */
-				find_item->call_count = 1;
+			if (NULL != find_item) {
+				find_item->call_count += slot->item.call_count;
+			} else if (stats->valid_item_cnt < stats->max_item_cnt) {
+				find_item = &(stats->items[stats->valid_item_cnt]);
+				*find_item = slot->item;
 
-				/* add hash for improve search performance */
-				ref_hash_node = &(context_ptr->kernel_binder_stats_refs[kernel_binder_stats->valid_item_cnt]);
+				ref_hash_node = &(context_ptr->kernel_binder_stats_refs[stats->valid_item_cnt]);
+				ref_hash_node->key = slot->key;
 				ref_hash_node->item = find_item;
-				hash_add(context_ptr->kernel_binder_stats_hash, &ref_hash_node->hentry, hash_key(data, context_ptr->enable_binder_comm));
+				hash_add(context_ptr->kernel_binder_stats_hash, &ref_hash_node->hentry, slot->key);
 
-				kernel_binder_stats->valid_item_cnt++;
+				stats->valid_item_cnt++;
 			}
-		}
 
-		spin_unlock_irqrestore(&context_ptr->buf_lock, ctx_flag);
+			slot->key = 0;
+			table->valid_slot_cnt--;
+		}
 	}
 
-	spin_unlock_irqrestore(&g_binder_stats_driver.user_list_lock, flags);
+	hash_for_each_safe(context_ptr->kernel_binder_stats_hash, i, tmp, ref_hash_node, hentry) {
+		hash_del(&ref_hash_node->hentry);
+	}
 }
 
 static void binder_stats_clear_user_context(struct binder_stats_user_context *context_ptr) {
 	unsigned long flags;
 	struct binder_stats_item_ref *ref_hash_node;
+	struct binder_stats_latency_ref *latency_hash_node;
 	struct hlist_node *tmp;
 	int i;
 
@@ -402,8 +734,15 @@ static void binder_stats_clear_user_context(struct binder_stats_user_context *co
 		then clear the local user memory */
 
 	spin_lock_irqsave(&g_binder_stats_driver.user_list_lock, flags);
-	list_del(&context_ptr->list_node);
+	list_del_rcu(&context_ptr->list_node);
 	spin_unlock_irqrestore(&g_binder_stats_driver.user_list_lock, flags);
+	binder_stats_bump_filter_gen();
+
+	/* writers walk the list under rcu */
+	synchronize_rcu();
+
+	binder_stats_free_pcpu_tables(context_ptr);
+	clear_bit(context_ptr->filter_bit, &g_binder_stats_driver.user_filter_bits);
 
 	if (!IS_ERR_OR_NULL(context_ptr->user_binder_stats)) {
 		vfree(context_ptr->user_binder_stats);
@@ -417,6 +756,13 @@ static void binder_stats_clear_user_context(struct binder_stats_user_context *co
 		vfree(context_ptr->kernel_binder_stats_refs);
 		context_ptr->kernel_binder_stats_refs = NULL;
 	}
+	hash_for_each_safe(context_ptr->kernel_latency_hash, i, tmp, latency_hash_node, hentry) {
+		hash_del(&latency_hash_node->hentry);
+	}
+	if (!IS_ERR_OR_NULL(context_ptr->kernel_latency_refs)) {
+		vfree(context_ptr->kernel_latency_refs);
+		context_ptr->kernel_latency_refs = NULL;
+	}
 	if (!IS_ERR_OR_NULL(context_ptr->kernel_binder_stats)) {
 		vfree(context_ptr->kernel_binder_stats);
 		context_ptr->kernel_binder_stats = NULL;
@@ -432,6 +778,7 @@ static void binder_stats_clear_user_context(struct binder_stats_user_context *co
 static int user_enable_binder_stats(struct binder_stats_user_context *context_ptr, int enable) {
 	unsigned long flags;
 	struct binder_stats_item_ref *ref_hash_node;
+	struct binder_stats_latency_ref *latency_hash_node;
 	struct hlist_node *tmp;
 	int i;
 	int max_item_cnt = BINDER_STATS_DEFAULT_MAX_COUNT;
@@ -462,7 +809,8 @@ static int user_enable_binder_stats(struct binder_stats_user_context *context_pt
 			max_item_cnt = context_ptr->max_item_cnt;
 		}
 
-		binder_stats_buffer_size = 2*sizeof(unsigned int) + max_item_cnt*sizeof(struct binder_stats_item);
+		binder_stats_buffer_size = binder_stats_drops_offset(max_item_cnt) +
+			offsetof(struct binder_stats_drops, dropped) + nr_cpu_ids * sizeof(unsigned int);
 
 		context_ptr->binder_stats_buf_0 = vmalloc_user(binder_stats_buffer_size);
 		if (IS_ERR_OR_NULL(context_ptr->binder_stats_buf_0)) {
@@ -471,6 +819,8 @@ static int user_enable_binder_stats(struct binder_stats_user_context *context_pt
 		}
 		context_ptr->binder_stats_buf_0->max_item_cnt = max_item_cnt;
 		context_ptr->binder_stats_buf_0->valid_item_cnt = 0;
+		binder_stats_latency(context_ptr->binder_stats_buf_0)->max_item_cnt = BINDER_STATS_LAT_MAX_COUNT;
+		binder_stats_drops(context_ptr->binder_stats_buf_0)->nr_cpus = nr_cpu_ids;
 		context_ptr->kernel_binder_stats = context_ptr->binder_stats_buf_0;
 
 		context_ptr->kernel_binder_stats_refs = vmalloc_user(max_item_cnt*sizeof(struct binder_stats_item_ref));
@@ -481,6 +831,14 @@ static int user_enable_binder_stats(struct binder_stats_user_context *context_pt
 
 		hash_init(context_ptr->kernel_binder_stats_hash);
 
+		context_ptr->kernel_latency_refs = vmalloc_user(BINDER_STATS_LAT_MAX_COUNT*sizeof(struct binder_stats_latency_ref));
+		if (IS_ERR_OR_NULL(context_ptr->kernel_latency_refs)) {
+			BINDER_STATS_LOGE("malloc failed!\n");
+			goto enable_fail;
+		}
+
+		hash_init(context_ptr->kernel_latency_hash);
+
 		context_ptr->binder_stats_buf_1 = vmalloc_user(binder_stats_buffer_size);
 		if (IS_ERR_OR_NULL(context_ptr->binder_stats_buf_1)) {
 			BINDER_STATS_LOGE("malloc failed!\n");
@@ -488,24 +846,45 @@ static int user_enable_binder_stats(struct binder_stats_user_context *context_pt
 		}
 		context_ptr->binder_stats_buf_1->max_item_cnt = max_item_cnt;
 		context_ptr->binder_stats_buf_1->valid_item_cnt = 0;
+		binder_stats_latency(context_ptr->binder_stats_buf_1)->max_item_cnt = BINDER_STATS_LAT_MAX_COUNT;
+		binder_stats_drops(context_ptr->binder_stats_buf_1)->nr_cpus = nr_cpu_ids;
 		context_ptr->user_binder_stats = context_ptr->binder_stats_buf_1;
 
+		if (0 != binder_stats_alloc_pcpu_tables(context_ptr)) {
+			BINDER_STATS_LOGE("malloc failed!\n");
+			goto enable_fail;
+		}
+
+		context_ptr->filter_bit = find_first_zero_bit(&g_binder_stats_driver.user_filter_bits,
+			BINDER_STATS_MAX_USERS);
+		if (context_ptr->filter_bit >= BINDER_STATS_MAX_USERS) {
+			BINDER_STATS_LOGE("too many users!\n");
+			goto enable_fail;
+		}
+		set_bit(context_ptr->filter_bit, &g_binder_stats_driver.user_filter_bits);
+
 		spin_lock_init(&context_ptr->buf_lock);
 		context_ptr->user_mmap_flag = false;
 
 		spin_lock_irqsave(&g_binder_stats_driver.user_list_lock, flags);
-		list_add(&context_ptr->list_node, &g_binder_stats_driver.user_list_head);
+		list_add_rcu(&context_ptr->list_node, &g_binder_stats_driver.user_list_head);
 		spin_unlock_irqrestore(&g_binder_stats_driver.user_list_lock, flags);
+		binder_stats_bump_filter_gen();
 
 		context_ptr->enable = 1;
 
 		return 0;
 
 enable_fail:
+		binder_stats_free_pcpu_tables(context_ptr);
 		if (!IS_ERR_OR_NULL(context_ptr->binder_stats_buf_1)) {
 			vfree(context_ptr->binder_stats_buf_1);
 			context_ptr->binder_stats_buf_1 = NULL;
 		}
+		if (!IS_ERR_OR_NULL(context_ptr->kernel_latency_refs)) {
+			vfree(context_ptr->kernel_latency_refs);
+			context_ptr->kernel_latency_refs = NULL;
+		}
 		if (!IS_ERR_OR_NULL(context_ptr->kernel_binder_stats_refs)) {
 			vfree(context_ptr->kernel_binder_stats_refs);
 			context_ptr->kernel_binder_stats_refs = NULL;
@@ -519,6 +898,9 @@ static int user_enable_binder_stats(struct binder_stats_user_context *context_pt
 		hash_for_each_safe(context_ptr->kernel_binder_stats_hash, i, tmp, ref_hash_node, hentry) {
 			hash_del(&ref_hash_node->hentry);
 		}
+		hash_for_each_safe(context_ptr->kernel_latency_hash, i, tmp, latency_hash_node, hentry) {
+			hash_del(&latency_hash_node->hentry);
+		}
 
 		return -1;
 	} else {
@@ -539,7 +921,7 @@ static int user_update_binder_stats(struct binder_stats_user_context *context_pt
 	int ret = 0;
 	unsigned long flags;
 	struct binder_stats * swap_tmp;
-	struct binder_stats_item_ref *ref_hash_node;
+	struct binder_stats_latency_ref *latency_hash_node;
 	struct hlist_node *tmp;
 	int i;
 
@@ -555,16 +937,17 @@ static int user_update_binder_stats(struct binder_stats_user_context *context_pt
 
 	spin_lock_irqsave(&context_ptr->buf_lock, flags);
 
-	/* swap buffer & clear kernel_binder_stats & kernel_binder_stats_hash */
+	/* swap buffer & clear kernel latency & kernel_latency_hash */
 	if (NULL != context_ptr->kernel_binder_stats && NULL != context_ptr->user_binder_stats) {
 		swap_tmp = context_ptr->kernel_binder_stats;
 		context_ptr->kernel_binder_stats = context_ptr->user_binder_stats;
 		context_ptr->user_binder_stats = swap_tmp;
 
-		/* reset cnt & clear hash */
+		/* reset cnt & clear hash, call counts live in the pcpu tables */
 		context_ptr->kernel_binder_stats->valid_item_cnt = 0;
-		hash_for_each_safe(context_ptr->kernel_binder_stats_hash, i, tmp, ref_hash_node, hentry) {
-			hash_del(&ref_hash_node->hentry);
+		binder_stats_latency(context_ptr->kernel_binder_stats)->valid_item_cnt = 0;
+		hash_for_each_safe(context_ptr->kernel_latency_hash, i, tmp, latency_hash_node, hentry) {
+			hash_del(&latency_hash_node->hentry);
 		}
 	} else {
 		ret = -1;
@@ -572,6 +955,9 @@ static int user_update_binder_stats(struct binder_stats_user_context *context_pt
 
 	spin_unlock_irqrestore(&context_ptr->buf_lock, flags);
 
+	if (0 == ret)
+		binder_stats_merge_pcpu_tables(context_ptr, context_ptr->user_binder_stats);
+
 	return ret;
 }
 
@@ -770,6 +1156,10 @@ static int binder_notify_fn(struct notifier_block *nb, unsigned long action, voi
 	if (NULL == data) {
 		return 0;
 	}
+	if (BINDER_NOTIFY_LATENCY == action) {
+		store_binder_latency_to_kernel((struct binder_latency_notify *)data);
+		return 0;
+	}
 	bn = (struct binder_notify *)data;
 	store_binder_stats_to_kernel(bn);
 	return 0;
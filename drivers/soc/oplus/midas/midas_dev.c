@@ -122,6 +122,9 @@ static int midas_dev_mmap(struct file *filp, struct vm_area_struct *vma)
 	if (IS_ERR_OR_NULL(info))
 		return -EINVAL;
 
+	if (info->stream)
+		return midas_stream_mmap(vma);
+
 	if (remap_vmalloc_range(vma, info->mmap_addr,
 		  vma->vm_pgoff)) {
 		pr_err("remap failed\n");
@@ -160,6 +163,9 @@ static int midas_dev_release(struct inode *inode, struct file *filp)
 	if (IS_ERR_OR_NULL(info))
 		return 0;
 
+	if (info->stream)
+		midas_stream_disable();
+
 	if (info->mmap_addr != NULL)
 		vfree(info->mmap_addr);
 
@@ -167,10 +173,20 @@ static int midas_dev_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+static __poll_t midas_dev_poll(struct file *filp, poll_table *wait)
+{
+	struct midas_priv_info *info = filp->private_data;
+	if (IS_ERR_OR_NULL(info) || !info->stream)
+		return EPOLLERR;
+
+	return midas_stream_poll(filp, wait);
+}
+
 static const struct file_operations midas_dev_fops = {
 	.open = midas_dev_open,
 	.release = midas_dev_release,
 	.mmap = midas_dev_mmap,
+	.poll = midas_dev_poll,
 	.unlocked_ioctl = midas_dev_ioctl,
 };
 
@@ -9,6 +9,7 @@
 
 #include <linux/cdev.h>
 #include <linux/device.h>
+#include <linux/poll.h>
 #include <linux/oplus_midas.h>
 
 #define STATE_MAX    60
@@ -48,8 +49,82 @@ struct midas_dev_info {
         struct class *class;
 };
 
+/*
+ * Stream of time-in-state deltas, one ring per cpu.
+ * The mmap'd area starts with struct midas_stream_header; the ring of
+ * cpu N starts at ring_offset + N * ring_size. The kernel only moves
+ * head, the reader only moves tail. Both are free running counters, the
+ * record lives at records[counter % nr_records].
+ */
+#define MIDAS_STREAM_VERSION		1
+#define MIDAS_STREAM_DEF_RECORDS	2048
+#define MIDAS_STREAM_MAX_RECORDS	16384
+
+struct midas_stream_record {
+        unsigned int uid;
+        unsigned short cluster;         /* first cpu of the freq domain */
+        unsigned short state;           /* index into time_in_state */
+        unsigned int freq;              /* kHz */
+        unsigned int reserved;
+        unsigned long long time_ns;
+        unsigned long long energy_nj;   /* 0 without an energy model */
+};
+
+struct midas_stream_ring {
+        unsigned long long head;
+        unsigned long long tail;
+        unsigned long long lost;
+        unsigned long long reserved;
+        struct midas_stream_record records[0];
+};
+
+struct midas_stream_header {
+        unsigned int version;
+        unsigned int nr_cpus;
+        unsigned int nr_records;
+        unsigned int watermark;
+        unsigned int ring_offset;
+        unsigned int ring_size;
+};
+
+struct midas_stream_cfg {
+        unsigned int nr_records;        /* in: 0 for default, out: actual */
+        unsigned int watermark;         /* in: 0 for half a ring */
+        unsigned int map_size;          /* out: bytes to mmap */
+};
+
 struct midas_priv_info {
         struct midas_mmap_data *mmap_addr;
+        bool stream;
+};
+
+/*
+ * /proc/midas_uid_freq_time: cumulative cpu time per uid, cluster and freq.
+ * struct midas_uf_header, nr_clusters struct midas_uf_cluster, then
+ * nr_records struct midas_uf_record, each followed by time_ns[nr_freqs]
+ * of its cluster.
+ */
+#define MIDAS_UF_MAGIC          0x4d554654      /* "MUFT" */
+#define MIDAS_UF_VERSION        1
+#define MIDAS_UF_MAX_FREQS      32
+
+struct midas_uf_header {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int nr_clusters;
+        unsigned int nr_records;
+};
+
+struct midas_uf_cluster {
+        unsigned int first_cpu;
+        unsigned int nr_freqs;
+        unsigned int freqs[MIDAS_UF_MAX_FREQS];        /* kHz, ascending */
+};
+
+struct midas_uf_record {
+        unsigned int uid;
+        unsigned int cluster;                           /* index, not cpu */
+        unsigned long long time_ns[0];
 };
 
 typedef int midas_ioctl_t(void *kdata, void *priv_info);
@@ -67,4 +142,12 @@ struct em_data {
 long midas_dev_ioctl(struct file *filp,
                 unsigned int cmd, unsigned long arg);
 
+void midas_stream_record(uid_t uid, u64 cputime, struct task_struct *p,
+                unsigned int state, unsigned int freq);
+int midas_stream_enable(struct midas_stream_cfg *cfg);
+void midas_stream_disable(void);
+int midas_stream_flush(void);
+int midas_stream_mmap(struct vm_area_struct *vma);
+__poll_t midas_stream_poll(struct file *filp, poll_table *wait);
+
 #endif
@@ -38,6 +38,8 @@
 #define MIDAS_IOCTL_REMOVE_TRACK_UID	MIDAS_IOR(0x3, unsigned int)
 #define MIDAS_IOCTL_CLEAR_TRACK_UID	MIDAS_IOR(0x4, unsigned int)
 #define MIDAS_IOCTL_GET_EM		MIDAS_IOR(0x10, struct em_data)
+#define MIDAS_IOCTL_STREAM_ENABLE	MIDAS_IOWR(0x20, struct midas_stream_cfg)
+#define MIDAS_IOCTL_STREAM_FLUSH	MIDAS_IO(0x21)
 
 #define SYS_UID				1000
 #define ROOT_UID			0
@@ -140,9 +142,11 @@ static void update_or_create_entry_locked(uid_t uid, struct task_struct *p, u64
 }
 
 void midas_record_task_times(uid_t uid, u64 cputime, struct task_struct *p,
-					unsigned int state) {
+					unsigned int state, unsigned int freq) {
 	unsigned long flags;
 
+	midas_stream_record(uid, cputime, p, state, freq);
+
 	spin_lock_irqsave(&midas_data_lock, flags);
 
 	update_or_create_entry_locked(uid, p, cputime, state, TYPE_APP);
@@ -261,6 +265,37 @@ static int midas_ioctl_get_em(void *kdata, void *priv_info)
 #endif
 }
 
+/*
+ * Switch this fd to the delta stream: mmap then maps the per-cpu rings
+ * and poll() reports EPOLLIN once a ring fills up to the watermark.
+ * Only one fd can own the stream, it stops when that fd is released.
+ */
+static int midas_ioctl_stream_enable(void *kdata, void *priv_info)
+{
+	struct midas_priv_info *info = priv_info;
+	int ret;
+
+	if (info->stream)
+		return -EBUSY;
+
+	ret = midas_stream_enable(kdata);
+	if (!ret)
+		info->stream = true;
+
+	return ret;
+}
+
+/* Publish the records still pending on every cpu, e.g. before a read. */
+static int midas_ioctl_stream_flush(void *kdata, void *priv_info)
+{
+	struct midas_priv_info *info = priv_info;
+
+	if (!info->stream)
+		return -EINVAL;
+
+	return midas_stream_flush();
+}
+
 /* Ioctl table */
 static const struct midas_ioctl_desc midas_ioctls[] = {
 	MIDAS_IOCTL_DEF(MIDAS_IOCTL_GET_TIME_IN_STATE, midas_ioctl_get_time_in_state),
@@ -268,6 +303,8 @@ static const struct midas_ioctl_desc midas_ioctls[] = {
 	MIDAS_IOCTL_DEF(MIDAS_IOCTL_REMOVE_TRACK_UID, midas_ioctl_remove_track_uid),
 	MIDAS_IOCTL_DEF(MIDAS_IOCTL_CLEAR_TRACK_UID, midas_ioctl_clear_track_uid),
     MIDAS_IOCTL_DEF(MIDAS_IOCTL_GET_EM, midas_ioctl_get_em),
+	MIDAS_IOCTL_DEF(MIDAS_IOCTL_STREAM_ENABLE, midas_ioctl_stream_enable),
+	MIDAS_IOCTL_DEF(MIDAS_IOCTL_STREAM_FLUSH, midas_ioctl_stream_flush),
 };
 
 #define KDATA_SIZE 	512
@@ -0,0 +1,319 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Copyright (C) 2019-2020 Oplus. All rights reserved.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME " %s: " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/percpu.h>
+#include <linux/irq_work.h>
+#include <linux/jiffies.h>
+#include <linux/smp.h>
+#include <linux/rcupdate.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/topology.h>
+
+#ifdef CONFIG_ENERGY_MODEL
+#include <linux/energy_model.h>
+#endif
+
+#include "midas_dev.h"
+
+/*
+ * Deltas are coalesced per cpu while the cpu keeps accounting the same
+ * uid at the same freq, and go to the ring once that changes or the
+ * record is MIDAS_STREAM_FLUSH_JIFFIES old. A record can still sit
+ * unpublished on a cpu that went idle, until it runs again or the reader
+ * asks for a flush.
+ */
+#define MIDAS_STREAM_FLUSH_JIFFIES	(HZ / 10)
+
+struct midas_stream_pending {
+	bool valid;
+	unsigned int uid;
+	unsigned int state;
+	unsigned int freq;
+	unsigned int cluster;
+	unsigned long power_mw;
+	unsigned long since;
+	u64 time_ns;
+};
+
+struct midas_stream {
+	struct midas_stream_header *hdr;
+	size_t map_size;
+};
+
+static struct midas_stream __rcu *midas_stream;
+static DEFINE_MUTEX(midas_stream_lock);
+static DECLARE_WAIT_QUEUE_HEAD(midas_stream_wait);
+static DEFINE_PER_CPU(struct midas_stream_pending, midas_stream_pending);
+static DEFINE_PER_CPU(struct irq_work, midas_stream_work);
+
+static inline struct midas_stream_ring *midas_stream_ring(struct midas_stream_header *hdr,
+					int cpu)
+{
+	return (void *)hdr + hdr->ring_offset + cpu * hdr->ring_size;
+}
+
+static void midas_stream_cpu_info(int cpu, unsigned int freq,
+					unsigned int *cluster, unsigned long *power_mw)
+{
+#ifdef CONFIG_ENERGY_MODEL
+	struct em_perf_domain *em_pd = em_cpu_get(cpu);
+	int i;
+
+	if (em_pd) {
+		*cluster = cpumask_first(to_cpumask(em_pd->cpus));
+		*power_mw = 0;
+		for (i = 0; i < em_pd->nr_cap_states; i++) {
+			if (em_pd->table[i].frequency >= freq) {
+				*power_mw = em_pd->table[i].power;
+				break;
+			}
+		}
+		return;
+	}
+#endif
+	*cluster = cpumask_first(topology_core_cpumask(cpu));
+	*power_mw = 0;
+}
+
+static void midas_stream_wakeup(struct irq_work *work)
+{
+	wake_up_interruptible(&midas_stream_wait);
+}
+
+static void midas_stream_publish(struct midas_stream_header *hdr, int cpu,
+					struct midas_stream_pending *pd)
+{
+	struct midas_stream_ring *ring = midas_stream_ring(hdr, cpu);
+	struct midas_stream_record *rec;
+	u64 head = ring->head;
+	u64 tail = READ_ONCE(ring->tail);
+
+	if (head - tail >= hdr->nr_records) {
+		ring->lost++;
+		return;
+	}
+
+	rec = &ring->records[head % hdr->nr_records];
+	rec->uid = pd->uid;
+	rec->cluster = pd->cluster;
+	rec->state = pd->state;
+	rec->freq = pd->freq;
+	rec->time_ns = pd->time_ns;
+	/* mW * ns = pJ */
+	rec->energy_nj = div_u64(pd->power_mw * pd->time_ns, 1000);
+
+	/* the record must be visible before the reader sees the new head */
+	smp_store_release(&ring->head, head + 1);
+
+	if (head + 1 - tail >= hdr->watermark)
+		irq_work_queue(this_cpu_ptr(&midas_stream_work));
+}
+
+/* called from cputime accounting, possibly with the rq lock held */
+void midas_stream_record(uid_t uid, u64 cputime, struct task_struct *p,
+			unsigned int state, unsigned int freq)
+{
+	struct midas_stream *stream;
+	struct midas_stream_pending *pd;
+	unsigned long flags;
+	int cpu;
+
+	if (!rcu_access_pointer(midas_stream))
+		return;
+
+	local_irq_save(flags);
+	rcu_read_lock();
+	stream = rcu_dereference(midas_stream);
+	if (!stream)
+		goto out;
+
+	cpu = smp_processor_id();
+	pd = this_cpu_ptr(&midas_stream_pending);
+	if (pd->valid && pd->uid == uid && pd->state == state) {
+		pd->time_ns += cputime;
+		if (time_after(jiffies, pd->since + MIDAS_STREAM_FLUSH_JIFFIES)) {
+			midas_stream_publish(stream->hdr, cpu, pd);
+			pd->valid = false;
+		}
+		goto out;
+	}
+
+	if (pd->valid)
+		midas_stream_publish(stream->hdr, cpu, pd);
+
+	pd->valid = true;
+	pd->uid = uid;
+	pd->state = state;
+	pd->freq = freq;
+	pd->since = jiffies;
+	pd->time_ns = cputime;
+	midas_stream_cpu_info(task_cpu(p), freq, &pd->cluster, &pd->power_mw);
+out:
+	rcu_read_unlock();
+	local_irq_restore(flags);
+}
+
+static void midas_stream_flush_cpu(void *info)
+{
+	struct midas_stream *stream = info;
+	struct midas_stream_pending *pd = this_cpu_ptr(&midas_stream_pending);
+
+	if (pd->valid) {
+		midas_stream_publish(stream->hdr, smp_processor_id(), pd);
+		pd->valid = false;
+	}
+}
+
+/* publish what every cpu has pending, idle ones included */
+int midas_stream_flush(void)
+{
+	struct midas_stream *stream;
+	int ret = -EINVAL;
+
+	mutex_lock(&midas_stream_lock);
+	stream = rcu_dereference_protected(midas_stream,
+				lockdep_is_held(&midas_stream_lock));
+	if (stream) {
+		on_each_cpu(midas_stream_flush_cpu, stream, 1);
+		ret = 0;
+	}
+	mutex_unlock(&midas_stream_lock);
+
+	return ret;
+}
+
+int midas_stream_enable(struct midas_stream_cfg *cfg)
+{
+	struct midas_stream *stream;
+	struct midas_stream_header *hdr;
+	unsigned int nr_records = cfg->nr_records ?: MIDAS_STREAM_DEF_RECORDS;
+	size_t ring_size;
+	int cpu, ret = 0;
+
+	if (nr_records > MIDAS_STREAM_MAX_RECORDS)
+		return -EINVAL;
+	if (cfg->watermark > nr_records)
+		return -EINVAL;
+
+	mutex_lock(&midas_stream_lock);
+	if (rcu_access_pointer(midas_stream)) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (!stream) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	ring_size = PAGE_ALIGN(sizeof(struct midas_stream_ring) +
+			nr_records * sizeof(struct midas_stream_record));
+	stream->map_size = PAGE_SIZE + nr_cpu_ids * ring_size;
+	hdr = vmalloc_user(stream->map_size);
+	if (!hdr) {
+		kfree(stream);
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	hdr->version = MIDAS_STREAM_VERSION;
+	hdr->nr_cpus = nr_cpu_ids;
+	hdr->nr_records = nr_records;
+	hdr->watermark = cfg->watermark ?: nr_records / 2;
+	hdr->ring_offset = PAGE_SIZE;
+	hdr->ring_size = ring_size;
+	stream->hdr = hdr;
+
+	for_each_possible_cpu(cpu) {
+		per_cpu(midas_stream_pending, cpu).valid = false;
+		init_irq_work(per_cpu_ptr(&midas_stream_work, cpu), midas_stream_wakeup);
+	}
+
+	cfg->nr_records = nr_records;
+	cfg->watermark = hdr->watermark;
+	cfg->map_size = stream->map_size;
+
+	rcu_assign_pointer(midas_stream, stream);
+unlock:
+	mutex_unlock(&midas_stream_lock);
+	return ret;
+}
+
+void midas_stream_disable(void)
+{
+	struct midas_stream *stream;
+	int cpu;
+
+	mutex_lock(&midas_stream_lock);
+	stream = rcu_dereference_protected(midas_stream,
+				lockdep_is_held(&midas_stream_lock));
+	if (!stream)
+		goto unlock;
+
+	RCU_INIT_POINTER(midas_stream, NULL);
+	synchronize_rcu();
+	for_each_possible_cpu(cpu)
+		irq_work_sync(per_cpu_ptr(&midas_stream_work, cpu));
+
+	vfree(stream->hdr);
+	kfree(stream);
+unlock:
+	mutex_unlock(&midas_stream_lock);
+}
+
+int midas_stream_mmap(struct vm_area_struct *vma)
+{
+	struct midas_stream *stream;
+	int ret = -EINVAL;
+
+	mutex_lock(&midas_stream_lock);
+	stream = rcu_dereference_protected(midas_stream,
+				lockdep_is_held(&midas_stream_lock));
+	if (stream && !remap_vmalloc_range(vma, stream->hdr, vma->vm_pgoff))
+		ret = 0;
+	mutex_unlock(&midas_stream_lock);
+
+	return ret;
+}
+
+__poll_t midas_stream_poll(struct file *filp, poll_table *wait)
+{
+	struct midas_stream *stream;
+	struct midas_stream_header *hdr;
+	struct midas_stream_ring *ring;
+	__poll_t mask = 0;
+	int cpu;
+
+	poll_wait(filp, &midas_stream_wait, wait);
+
+	rcu_read_lock();
+	stream = rcu_dereference(midas_stream);
+	if (!stream) {
+		mask = EPOLLERR;
+		goto out;
+	}
+
+	hdr = stream->hdr;
+	for_each_possible_cpu(cpu) {
+		ring = midas_stream_ring(hdr, cpu);
+		if (smp_load_acquire(&ring->head) - READ_ONCE(ring->tail) >=
+				hdr->watermark) {
+			mask = EPOLLIN | EPOLLRDNORM;
+			break;
+		}
+	}
+out:
+	rcu_read_unlock();
+	return mask;
+}
@@ -0,0 +1,489 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Copyright (C) 2019-2020 Oplus. All rights reserved.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME " %s: " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/cpufreq.h>
+#include <linux/cred.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/hashtable.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <trace/events/power.h>
+#include <trace/events/sched.h>
+
+#include "midas_dev.h"
+
+/*
+ * Exact per-uid, per-freq cpu time. Each cpu charges the time since its
+ * last event to (current uid, current freq) at every context switch and
+ * every freq change, into its own table of uids. The table and the
+ * running state of a cpu are guarded by a per-cpu raw lock, because freq
+ * changes are reported from whichever cpu performed them.
+ *
+ * Readers copy a table under the lock and fold it afterwards. Slots that
+ * have not run for MIDAS_UF_IDLE_JIFFIES are retired at that point: their
+ * time moves to a per-uid store outside the tables, so the slot can be
+ * reused while the totals keep counting from boot.
+ */
+
+#define MIDAS_UF_SLOTS		512
+#define MIDAS_UF_MAX_PROBE	16
+#define MIDAS_UF_OVERFLOW_UID	((u32)-1)
+#define MIDAS_UF_IDLE_JIFFIES	(300 * HZ)
+
+struct midas_uf_cpu {
+	raw_spinlock_t lock;
+	int cluster;			/* -1 if the cpu has no policy */
+	unsigned int nr_freqs;
+	bool running;			/* a non-idle task is on the cpu */
+	unsigned int cur_slot;
+	unsigned int cur_freq;		/* index into the cluster's freqs */
+	u64 last_ns;
+	DECLARE_BITMAP(used, MIDAS_UF_SLOTS);
+	u32 uids[MIDAS_UF_SLOTS + 1];	/* the last slot is the overflow */
+	unsigned long seen[MIDAS_UF_SLOTS + 1];	/* jiffies of the last switch in */
+	u64 *times;			/* [MIDAS_UF_SLOTS + 1][nr_freqs] */
+};
+
+/* what a reader takes from a cpu under its lock */
+struct midas_uf_copy {
+	DECLARE_BITMAP(used, MIDAS_UF_SLOTS);
+	DECLARE_BITMAP(retired, MIDAS_UF_SLOTS);
+	u32 uids[MIDAS_UF_SLOTS + 1];
+	u64 times[0];
+};
+
+/* time of uids whose slots were retired, per cluster */
+struct midas_uf_retired {
+	struct hlist_node node;
+	u32 uid;
+	unsigned int cluster;
+	u64 time_ns[0];
+};
+
+struct midas_uf_snapshot {
+	size_t len;
+	char data[0];
+};
+
+static DEFINE_PER_CPU(struct midas_uf_cpu *, midas_uf_cpus);
+static struct midas_uf_cluster midas_uf_clusters[CPU_MAX];
+static unsigned int midas_uf_nr_clusters;
+
+/* serializes readers, guards the retired store */
+static DEFINE_MUTEX(midas_uf_mutex);
+static DEFINE_HASHTABLE(midas_uf_retired, 8);
+static unsigned int midas_uf_nr_retired;
+
+/* retired slots leave holes, so a miss has to look at every probe */
+static unsigned int midas_uf_find_or_add(struct midas_uf_cpu *c, u32 uid)
+{
+	unsigned int i, free = MIDAS_UF_SLOTS, idx = hash_32(uid, ilog2(MIDAS_UF_SLOTS));
+
+	for (i = 0; i < MIDAS_UF_MAX_PROBE; i++, idx = (idx + 1) & (MIDAS_UF_SLOTS - 1)) {
+		if (!test_bit(idx, c->used)) {
+			if (free == MIDAS_UF_SLOTS)
+				free = idx;
+			continue;
+		}
+		if (c->uids[idx] == uid)
+			return idx;
+	}
+
+	if (free < MIDAS_UF_SLOTS) {
+		__set_bit(free, c->used);
+		c->uids[free] = uid;
+	}
+
+	return free;
+}
+
+static unsigned int midas_uf_freq_index(struct midas_uf_cluster *cl, unsigned int freq)
+{
+	unsigned int i;
+
+	for (i = 0; i < cl->nr_freqs - 1; i++) {
+		if (cl->freqs[i] >= freq)
+			break;
+	}
+
+	return i;
+}
+
+/* called with c->lock held */
+static inline void midas_uf_charge(struct midas_uf_cpu *c, u64 now)
+{
+	if (c->running && now > c->last_ns)
+		c->times[c->cur_slot * c->nr_freqs + c->cur_freq] += now - c->last_ns;
+	c->last_ns = now;
+}
+
+static void midas_uf_sched_switch(void *data, bool preempt,
+			struct task_struct *prev, struct task_struct *next)
+{
+	struct midas_uf_cpu *c = this_cpu_read(midas_uf_cpus);
+
+	if (!c)
+		return;
+
+	/* irqs are already off here */
+	raw_spin_lock(&c->lock);
+	midas_uf_charge(c, ktime_get_ns());
+	c->running = !is_idle_task(next);
+	if (c->running) {
+		c->cur_slot = midas_uf_find_or_add(c,
+				from_kuid_munged(&init_user_ns, task_uid(next)));
+		c->seen[c->cur_slot] = jiffies;
+	}
+	raw_spin_unlock(&c->lock);
+}
+
+static void midas_uf_cpu_frequency(void *data, unsigned int freq, unsigned int cpu)
+{
+	struct midas_uf_cpu *c;
+	unsigned long flags;
+
+	if (cpu >= nr_cpu_ids)
+		return;
+
+	c = per_cpu(midas_uf_cpus, cpu);
+	if (!c)
+		return;
+
+	raw_spin_lock_irqsave(&c->lock, flags);
+	midas_uf_charge(c, ktime_get_ns());
+	c->cur_freq = midas_uf_freq_index(&midas_uf_clusters[c->cluster], freq);
+	raw_spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static int midas_uf_cmp_freq(const void *a, const void *b)
+{
+	unsigned int fa = *(const unsigned int *)a, fb = *(const unsigned int *)b;
+
+	return fa < fb ? -1 : fa > fb;
+}
+
+static int midas_uf_add_cluster(struct cpufreq_policy *policy)
+{
+	struct midas_uf_cluster *cl;
+	struct cpufreq_frequency_table *pos;
+	unsigned int first_cpu = cpumask_first(policy->related_cpus);
+	int i;
+
+	for (i = 0; i < midas_uf_nr_clusters; i++) {
+		if (midas_uf_clusters[i].first_cpu == first_cpu)
+			return i;
+	}
+
+	if (midas_uf_nr_clusters >= CPU_MAX || !policy->freq_table)
+		return -1;
+
+	cl = &midas_uf_clusters[midas_uf_nr_clusters];
+	cl->first_cpu = first_cpu;
+	cl->nr_freqs = 0;
+	cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+		if (cl->nr_freqs >= MIDAS_UF_MAX_FREQS)
+			break;
+		cl->freqs[cl->nr_freqs++] = pos->frequency;
+	}
+	if (!cl->nr_freqs)
+		return -1;
+	sort(cl->freqs, cl->nr_freqs, sizeof(cl->freqs[0]), midas_uf_cmp_freq, NULL);
+
+	return midas_uf_nr_clusters++;
+}
+
+/*
+ * Copy the table of a cpu, retiring its idle slots. Called with c->lock
+ * held and irqs off, so only copy here.
+ */
+static void midas_uf_copy_cpu(struct midas_uf_cpu *c, struct midas_uf_copy *copy)
+{
+	unsigned long now = jiffies;
+	unsigned int slot;
+
+	/* include the slice the cpu is running right now */
+	midas_uf_charge(c, ktime_get_ns());
+	bitmap_copy(copy->used, c->used, MIDAS_UF_SLOTS);
+	memcpy(copy->uids, c->uids, sizeof(copy->uids));
+	memcpy(copy->times, c->times,
+		(MIDAS_UF_SLOTS + 1) * c->nr_freqs * sizeof(u64));
+
+	bitmap_zero(copy->retired, MIDAS_UF_SLOTS);
+	for_each_set_bit(slot, c->used, MIDAS_UF_SLOTS) {
+		if ((c->running && slot == c->cur_slot) ||
+				time_before(now, c->seen[slot] + MIDAS_UF_IDLE_JIFFIES))
+			continue;
+		__clear_bit(slot, c->used);
+		memset(&c->times[slot * c->nr_freqs], 0, c->nr_freqs * sizeof(u64));
+		__set_bit(slot, copy->retired);
+	}
+}
+
+/* called with midas_uf_mutex held */
+static void midas_uf_retire(unsigned int cluster, u32 uid, const u64 *times,
+			unsigned int nr_freqs)
+{
+	struct midas_uf_retired *r;
+	unsigned int j;
+
+	hash_for_each_possible(midas_uf_retired, r, node, uid) {
+		if (r->uid == uid && r->cluster == cluster)
+			goto add;
+	}
+
+	r = kzalloc(sizeof(*r) + nr_freqs * sizeof(u64), GFP_KERNEL);
+	if (!r)
+		return;
+	r->uid = uid;
+	r->cluster = cluster;
+	hash_add(midas_uf_retired, &r->node, uid);
+	midas_uf_nr_retired++;
+add:
+	for (j = 0; j < nr_freqs; j++)
+		r->time_ns[j] += times[j];
+}
+
+struct midas_uf_fold {
+	char *base;
+	unsigned int *index;
+	unsigned int index_size;
+	unsigned int nr;
+	size_t rec_size;
+	unsigned int cluster;
+	unsigned int nr_freqs;
+};
+
+static void midas_uf_fold(struct midas_uf_fold *f, u32 uid, const u64 *times)
+{
+	struct midas_uf_record *rec;
+	unsigned int i, j;
+
+	for (i = hash_32(uid, ilog2(f->index_size)); f->index[i] != UINT_MAX;
+			i = (i + 1) & (f->index_size - 1)) {
+		rec = (struct midas_uf_record *)(f->base + f->index[i] * f->rec_size);
+		if (rec->uid == uid)
+			goto add;
+	}
+
+	f->index[i] = f->nr++;
+	rec = (struct midas_uf_record *)(f->base + f->index[i] * f->rec_size);
+	rec->uid = uid;
+	rec->cluster = f->cluster;
+add:
+	for (j = 0; j < f->nr_freqs; j++)
+		rec->time_ns[j] += times[j];
+}
+
+/* fold the per cpu tables of every cluster into one record per uid */
+static int midas_uf_open(struct inode *inode, struct file *file)
+{
+	struct midas_uf_snapshot *snap;
+	struct midas_uf_header *hdr;
+	struct midas_uf_record *rec;
+	struct midas_uf_cluster *cl;
+	struct midas_uf_retired *r;
+	struct midas_uf_copy *copy;
+	struct midas_uf_cpu *c;
+	struct midas_uf_fold f;
+	unsigned int k, slot, max_freqs = 0;
+	size_t max, len;
+	unsigned long flags;
+	int cpu, ret = -ENOMEM;
+
+	mutex_lock(&midas_uf_mutex);
+
+	max = sizeof(*hdr) + midas_uf_nr_clusters * sizeof(*cl);
+	for_each_possible_cpu(cpu) {
+		c = per_cpu(midas_uf_cpus, cpu);
+		if (!c)
+			continue;
+		max += (MIDAS_UF_SLOTS + 1) * (sizeof(*rec) + c->nr_freqs * sizeof(u64));
+		if (c->nr_freqs > max_freqs)
+			max_freqs = c->nr_freqs;
+	}
+	max += midas_uf_nr_retired * (sizeof(*rec) + MIDAS_UF_MAX_FREQS * sizeof(u64));
+
+	snap = kvzalloc(sizeof(*snap) + max, GFP_KERNEL);
+	if (!snap)
+		goto out;
+
+	copy = kvmalloc(sizeof(*copy) + (MIDAS_UF_SLOTS + 1) * max_freqs * sizeof(u64),
+			GFP_KERNEL);
+	if (!copy)
+		goto free_snap;
+
+	f.index_size = roundup_pow_of_two(2 * (num_possible_cpus() * (MIDAS_UF_SLOTS + 1) +
+				midas_uf_nr_retired));
+	f.index = kvmalloc_array(f.index_size, sizeof(*f.index), GFP_KERNEL);
+	if (!f.index)
+		goto free_copy;
+
+	hdr = (struct midas_uf_header *)snap->data;
+	hdr->magic = MIDAS_UF_MAGIC;
+	hdr->version = MIDAS_UF_VERSION;
+	hdr->nr_clusters = midas_uf_nr_clusters;
+	memcpy(hdr + 1, midas_uf_clusters, midas_uf_nr_clusters * sizeof(*cl));
+	len = sizeof(*hdr) + midas_uf_nr_clusters * sizeof(*cl);
+
+	for (k = 0; k < midas_uf_nr_clusters; k++) {
+		cl = &midas_uf_clusters[k];
+		f.base = snap->data + len;
+		f.nr = 0;
+		f.rec_size = sizeof(*rec) + cl->nr_freqs * sizeof(u64);
+		f.cluster = k;
+		f.nr_freqs = cl->nr_freqs;
+		memset(f.index, 0xff, f.index_size * sizeof(*f.index));
+
+		/* before the cpus, which may add to the store below */
+		hash_for_each(midas_uf_retired, slot, r, node) {
+			if (r->cluster == k)
+				midas_uf_fold(&f, r->uid, r->time_ns);
+		}
+
+		for_each_possible_cpu(cpu) {
+			c = per_cpu(midas_uf_cpus, cpu);
+			if (!c || c->cluster != k)
+				continue;
+
+			raw_spin_lock_irqsave(&c->lock, flags);
+			midas_uf_copy_cpu(c, copy);
+			raw_spin_unlock_irqrestore(&c->lock, flags);
+
+			for (slot = 0; slot <= MIDAS_UF_SLOTS; slot++) {
+				const u64 *times = &copy->times[slot * c->nr_freqs];
+
+				if (slot == MIDAS_UF_SLOTS) {
+					midas_uf_fold(&f, MIDAS_UF_OVERFLOW_UID, times);
+					continue;
+				}
+				if (!test_bit(slot, copy->used))
+					continue;
+				midas_uf_fold(&f, copy->uids[slot], times);
+				if (test_bit(slot, copy->retired))
+					midas_uf_retire(k, copy->uids[slot], times, c->nr_freqs);
+			}
+		}
+
+		hdr->nr_records += f.nr;
+		len += f.nr * f.rec_size;
+	}
+
+	kvfree(f.index);
+	kvfree(copy);
+	snap->len = len;
+	file->private_data = snap;
+	mutex_unlock(&midas_uf_mutex);
+
+	return 0;
+
+free_copy:
+	kvfree(copy);
+free_snap:
+	kvfree(snap);
+out:
+	mutex_unlock(&midas_uf_mutex);
+	return ret;
+}
+
+static ssize_t midas_uf_read(struct file *file, char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	struct midas_uf_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->data, snap->len);
+}
+
+static int midas_uf_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations midas_uf_proc_fops = {
+	.open = midas_uf_open,
+	.read = midas_uf_read,
+	.llseek = default_llseek,
+	.release = midas_uf_release,
+};
+
+/* cpufreq drivers are probed by now, cpus without a policy are skipped */
+static int __init midas_uid_freq_init(void)
+{
+	struct cpufreq_policy *policy;
+	struct midas_uf_cpu *c;
+	int cpu, cluster, ret;
+
+	for_each_possible_cpu(cpu) {
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+
+		cluster = midas_uf_add_cluster(policy);
+		if (cluster < 0) {
+			cpufreq_cpu_put(policy);
+			continue;
+		}
+
+		c = kzalloc(sizeof(*c), GFP_KERNEL);
+		if (!c) {
+			cpufreq_cpu_put(policy);
+			goto err;
+		}
+		c->nr_freqs = midas_uf_clusters[cluster].nr_freqs;
+		c->times = vzalloc((MIDAS_UF_SLOTS + 1) * c->nr_freqs * sizeof(u64));
+		if (!c->times) {
+			kfree(c);
+			cpufreq_cpu_put(policy);
+			goto err;
+		}
+		raw_spin_lock_init(&c->lock);
+		c->cluster = cluster;
+		c->uids[MIDAS_UF_SLOTS] = MIDAS_UF_OVERFLOW_UID;
+		c->cur_freq = midas_uf_freq_index(&midas_uf_clusters[cluster], policy->cur);
+		c->last_ns = ktime_get_ns();
+		cpufreq_cpu_put(policy);
+
+		per_cpu(midas_uf_cpus, cpu) = c;
+	}
+
+	ret = register_trace_cpu_frequency(midas_uf_cpu_frequency, NULL);
+	if (ret)
+		goto err;
+
+	ret = register_trace_sched_switch(midas_uf_sched_switch, NULL);
+	if (ret)
+		goto err_unreg_freq;
+
+	if (!proc_create("midas_uid_freq_time", S_IRUGO, NULL, &midas_uf_proc_fops))
+		pr_err("proc create failed\n");
+
+	return 0;
+
+err_unreg_freq:
+	unregister_trace_cpu_frequency(midas_uf_cpu_frequency, NULL);
+	tracepoint_synchronize_unregister();
+err:
+	for_each_possible_cpu(cpu) {
+		c = per_cpu(midas_uf_cpus, cpu);
+		if (!c)
+			continue;
+		per_cpu(midas_uf_cpus, cpu) = NULL;
+		vfree(c->times);
+		kfree(c);
+	}
+	return -ENOMEM;
+}
+late_initcall_sync(midas_uid_freq_init);
@@ -8,8 +8,11 @@
 #include <linux/sched.h>
 #include <linux/module.h>
 #include <linux/fs.h>
+#include <linux/log2.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
+#include <linux/percpu.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/sched/signal.h>
@@ -22,31 +25,89 @@
 
 #include <asm/ioctls.h>
 
+/*
+ * Every entry in the ring starts LOGGER_HDR_OFF bytes ahead of its header
+ * and is padded to LOGGER_ALIGN. Once the entry at pos is complete its writer
+ * stores (pos + 1) in the commit word for pos. Commit words live in an array
+ * of their own, one per LOGGER_COMMIT_SHIFT granule of the ring: no two
+ * entries start in the same granule, and nothing but a commit is ever stored
+ * there, so neither a payload nor an older lap can pass for a commit.
+ */
+#define LOGGER_ALIGN		LOGGER_MMAP_ALIGN
+#define LOGGER_HDR_OFF		LOGGER_MMAP_HDR_OFF
+#define LOGGER_RECORD_LEN(len)	\
+	ALIGN(LOGGER_HDR_OFF + sizeof(struct logger_entry) + (len), LOGGER_ALIGN)
+#define LOGGER_RECORD_MAX	LOGGER_RECORD_LEN(LOGGER_ENTRY_MAX_PAYLOAD)
+#define LOGGER_COMMIT_SHIFT	5
+
+/*
+ * Writers note the first entry boundary at or after every sync chunk, so a
+ * lapped reader can find an entry again without walking the whole buffer.
+ * A chunk must be larger than the largest entry.
+ */
+#define LOGGER_SYNC_SHIFT	13
+#define LOGGER_SYNC_CHUNK	(1ULL << LOGGER_SYNC_SHIFT)
+
+/*
+ * Writers keep w_head within this much of w_off, so an entry still being
+ * filled in is never lapped and w_off always points at an intact entry.
+ */
+#define LOGGER_RESERVE_MAX(log)	((log)->size - LOGGER_RECORD_MAX)
+
+/* how often a reader retries an entry lapped under it before skipping */
+#define LOGGER_LAP_RETRIES	4
+
+/*
+ * struct logger_ctl - the control page, mapped read-only by mmap readers
+ * ahead of the buffer as struct logger_mmap_ctl.
+ */
+struct logger_ctl {
+	atomic64_t		w_head;
+	atomic64_t		w_off;
+	u64			size;
+	u32			hdr_off;
+	u32			align;
+};
+
 /**
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  * @buffer:	The actual ring buffer
+ * @ctl:	The write positions, in a page of their own for mmap readers
+ * @commit:	The commit words, never mapped to user space
+ * @nr_commit:	The number of @commit words
+ * @bounce:	Per cpu copy of a payload, taken before reserving space for it
+ * @sync:	The first entry at or after each sync chunk of @buffer
+ * @nr_sync:	The number of @sync slots
  * @misc:	The "misc" device representing the log
  * @wq:		The wait queue for @readers
  * @readers:	This log's readers
- * @mutex:	The mutex that protects the @buffer
- * @w_off:	The current write head offset
+ * @mutex:	The mutex that protects @readers and @head
  * @head:	The head, or location that readers start reading at.
  * @size:	The size of the log
  * @logs:	The list of log channels
  *
+ * Positions count bytes since the log was created and are mapped into
+ * @buffer by logger_offset(). Writers never take @mutex: they reserve space
+ * by moving @ctl->w_head, which is the position reserved up to, fill it in,
+ * then commit it in order into @ctl->w_off, below which every entry is
+ * complete.
+ *
  * This structure lives from module insertion until module removal, so it does
- * not need additional reference counting. The structure is protected by the
- * mutex 'mutex'.
+ * not need additional reference counting.
  */
 struct logger_log {
 	unsigned char		*buffer;
-	unsigned char		*cache;
+	struct logger_ctl	*ctl;
+	u64			*commit;
+	size_t			nr_commit;
+	char __percpu		*bounce;
+	u64			*sync;
+	unsigned int		nr_sync;
 	struct miscdevice	misc;
 	wait_queue_head_t	wq;
 	struct list_head	readers;
 	struct mutex		mutex;
-	size_t			w_off;
-	size_t			head;
+	u64			head;
 	size_t			size;
 	struct list_head	logs;
 };
@@ -69,7 +130,7 @@ static struct logger_log *global_log;
 struct logger_reader {
 	struct logger_log	*log;
 	struct list_head	list;
-	size_t			r_off;
+	u64			r_off;
 	bool			r_all;
 	int			r_ver;
 };
@@ -86,11 +147,36 @@ static struct timespec current_kernel_time(void)
 #endif
 
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
-static size_t logger_offset(struct logger_log *log, size_t n)
+static size_t logger_offset(struct logger_log *log, u64 n)
 {
 	return n & (log->size - 1);
 }
 
+static inline u64 *logger_commit_word(struct logger_log *log, u64 pos)
+{
+	return &log->commit[(pos >> LOGGER_COMMIT_SHIFT) & (log->nr_commit - 1)];
+}
+
+/* logger_copy_in - copy 'len' bytes to position 'pos', wrapping at the end */
+static void logger_copy_in(struct logger_log *log, u64 pos,
+			   const void *src, size_t len)
+{
+	size_t off = logger_offset(log, pos);
+	size_t n = min(len, log->size - off);
+
+	memcpy(log->buffer + off, src, n);
+	memcpy(log->buffer, src + n, len - n);
+}
+
+/* logger_put_header - store 'header' for the entry at 'pos' */
+static void logger_put_header(struct logger_log *log, u64 pos,
+			      const struct logger_entry *header)
+{
+	/* LOGGER_ALIGN keeps the bytes ahead of the header from wrapping */
+	memset(log->buffer + logger_offset(log, pos), 0, LOGGER_HDR_OFF);
+	logger_copy_in(log, pos + LOGGER_HDR_OFF, header, sizeof(*header));
+}
+
 
 /*
  * file_get_log - Given a file structure, return the associated log
@@ -117,15 +203,16 @@ static inline struct logger_log *file_get_log(struct file *file)
 }
 
 /*
- * get_entry_header - returns a pointer to the logger_entry header within
- * 'log' starting at offset 'off'. A temporary logger_entry 'scratch' must
+ * get_entry_header - returns a pointer to the logger_entry header of the
+ * entry at position 'pos' in 'log'. A temporary logger_entry 'scratch' must
  * be provided. Typically the return value will be a pointer within
  * 'logger->buf'.  However, a pointer to 'scratch' may be returned if
  * the log entry spans the end and beginning of the circular buffer.
  */
 static struct logger_entry *get_entry_header(struct logger_log *log,
-					     size_t off, struct logger_entry *scratch)
+					     u64 pos, struct logger_entry *scratch)
 {
+	size_t off = logger_offset(log, pos + LOGGER_HDR_OFF);
 	size_t len = min(sizeof(struct logger_entry), log->size - off);
 
 	if (len != sizeof(struct logger_entry)) {
@@ -145,15 +232,13 @@ static struct logger_entry *get_entry_header(struct logger_log *log,
  * An entry length is 2 bytes (16 bits) in host endian order.
  * In the log, the length does not include the size of the log entry structure.
  * This function returns the size including the log entry structure.
- *
- * Caller needs to hold log->mutex.
  */
-static __u32 get_entry_msg_len(struct logger_log *log, size_t off)
+static __u32 get_entry_msg_len(struct logger_log *log, u64 pos)
 {
 	struct logger_entry scratch;
 	struct logger_entry *entry;
 
-	entry = get_entry_header(log, off, &scratch);
+	entry = get_entry_header(log, pos, &scratch);
 	return entry->len;
 }
 
@@ -214,8 +299,8 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 
 	count -= get_user_hdr_len(reader->r_ver);
 	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(log,
-				  reader->r_off + sizeof(struct logger_entry));
+	msg_start = logger_offset(log, reader->r_off + LOGGER_HDR_OFF +
+				  sizeof(struct logger_entry));
 
 	/*
 	 * We read from the msg in two disjoint operations. First, we read from
@@ -234,34 +319,115 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 		if (copy_to_user(buf + len, log->buffer, count - len))
 			return -EFAULT;
 
-	reader->r_off = logger_offset(log, reader->r_off +
-				      sizeof(struct logger_entry) + count);
+	reader->r_off += LOGGER_RECORD_LEN(count);
 
 	return count + get_user_hdr_len(reader->r_ver);
 }
 
 /*
- * get_next_entry_by_uid - Starting at 'off', returns an offset into
- * 'log->buffer' which contains the first entry readable by 'euid'
+ * get_next_entry_by_uid - Starting at 'off', returns the position of the
+ * first complete entry readable by 'euid', or 'w_off' if there is none.
  */
-static size_t get_next_entry_by_uid(struct logger_log *log,
-				    size_t off, kuid_t euid)
+static u64 get_next_entry_by_uid(struct logger_log *log,
+				 u64 off, u64 w_off, kuid_t euid)
 {
-	while (off != log->w_off) {
+	while (off < w_off) {
 		struct logger_entry *entry;
 		struct logger_entry scratch;
-		size_t next_len;
 
 		entry = get_entry_header(log, off, &scratch);
 
 		if (uid_eq(entry->euid, euid))
 			return off;
 
-		next_len = sizeof(struct logger_entry) + entry->len;
-		off = logger_offset(log, off + next_len);
+		off += LOGGER_RECORD_LEN(entry->len);
+	}
+
+	return w_off;
+}
+
+/*
+ * logger_lapped - has a writer reserved space over the entry at 'pos'?
+ * Readers call this after looking at an entry to know if what they saw
+ * may have been overwritten under them.
+ */
+static inline bool logger_lapped(struct logger_log *log, u64 pos)
+{
+	smp_rmb();
+	return atomic64_read(&log->ctl->w_head) - pos > log->size;
+}
+
+/*
+ * logger_resync - returns the first complete entry at or after 'from',
+ * using the sync points left by writers, or 'w_off' if there is none.
+ */
+static u64 logger_resync(struct logger_log *log, u64 from, u64 w_off)
+{
+	u64 chunk, pos;
+
+	for (chunk = round_up(from, LOGGER_SYNC_CHUNK); chunk < w_off;
+	     chunk += LOGGER_SYNC_CHUNK) {
+		pos = READ_ONCE(log->sync[(chunk >> LOGGER_SYNC_SHIFT) &
+					  (log->nr_sync - 1)]);
+		/* skip points left from an earlier lap */
+		if (pos >= chunk && pos - chunk <= LOGGER_RECORD_MAX &&
+		    pos <= w_off)
+			return pos;
+	}
+
+	return w_off;
+}
+
+/*
+ * fix_up_reader - pull a reader that was lapped by the writers forward to
+ * the first entry still intact, leaving one sync chunk of headroom. Writers
+ * never walk the readers; each reader catches up lazily here instead.
+ *
+ * Caller must hold log->mutex.
+ */
+static void fix_up_reader(struct logger_log *log, struct logger_reader *reader)
+{
+	u64 w_head = atomic64_read(&log->ctl->w_head);
+
+	if (w_head - reader->r_off > log->size)
+		reader->r_off = logger_resync(log,
+					      w_head - log->size + LOGGER_SYNC_CHUNK,
+					      atomic64_read(&log->ctl->w_off));
+}
+
+/*
+ * logger_reader_next - fix up 'reader' and move it to the next entry it may
+ * read. Returns the complete position it was checked against; the reader
+ * has nothing to read if that equals reader->r_off. A reader that keeps
+ * being lapped while it looks for its next entry gives up and skips to
+ * w_off, which writers never lap.
+ *
+ * Caller must hold log->mutex.
+ */
+static u64 logger_reader_next(struct logger_log *log,
+			      struct logger_reader *reader)
+{
+	u64 w_off, off;
+	int tries;
+
+	for (tries = 0; tries < LOGGER_LAP_RETRIES; tries++) {
+		fix_up_reader(log, reader);
+		w_off = atomic64_read(&log->ctl->w_off);
+		/* pairs with the barrier in logger_commit() */
+		smp_rmb();
+		if (reader->r_all)
+			return w_off;
+
+		off = get_next_entry_by_uid(log, reader->r_off, w_off,
+					    current_euid());
+		if (!logger_lapped(log, reader->r_off)) {
+			reader->r_off = off;
+			return w_off;
+		}
 	}
 
-	return off;
+	reader->r_off = w_off;
+	return w_off;
 }
 
 /*
@@ -281,7 +447,9 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
+	u64 r_off;
 	ssize_t ret;
+	int tries = 0;
 	DEFINE_WAIT(wait);
 
 start:
@@ -290,7 +458,7 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		ret = (log->w_off == reader->r_off);
+		ret = (atomic64_read(&log->ctl->w_off) == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
 			break;
@@ -314,20 +482,26 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 
 	mutex_lock(&log->mutex);
 
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-						      reader->r_off, current_euid());
+retry:
+	/* lapped over and over by the writers: drop what we missed */
+	if (unlikely(++tries > LOGGER_LAP_RETRIES)) {
+		reader->r_off = atomic64_read(&log->ctl->w_off);
+		tries = 0;
+	}
 
 	/* is there still something to read or did we race? */
-	if (unlikely(log->w_off == reader->r_off)) {
+	if (unlikely(logger_reader_next(log, reader) == reader->r_off)) {
 		mutex_unlock(&log->mutex);
 		goto start;
 	}
 
 	/* get the size of the next entry */
+	r_off = reader->r_off;
 	ret = get_user_hdr_len(reader->r_ver) +
-		get_entry_msg_len(log, reader->r_off);
+		get_entry_msg_len(log, r_off);
 	if (count < ret) {
+		if (logger_lapped(log, r_off))
+			goto retry;
 		ret = -EINVAL;
 		goto out;
 	}
@@ -335,6 +509,12 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 	/* get exactly one entry from the log */
 	ret = do_read_log_to_user(log, reader, buf, ret);
 
+	/* the entry was overwritten while we copied it, the copy is torn */
+	if (ret > 0 && logger_lapped(log, r_off)) {
+		reader->r_off = r_off;
+		goto retry;
+	}
+
 out:
 	mutex_unlock(&log->mutex);
 
@@ -342,74 +522,89 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 }
 
 /*
- * get_next_entry - return the offset of the first valid entry at least 'len'
- * bytes after 'off'.
+ * logger_reserve - reserve 'len' bytes at the write head and store their
+ * position in 'posp'. The space is the caller's until it passes it to
+ * logger_commit(). Returns false, reserving nothing, if the space would
+ * reach within LOGGER_RECORD_MAX of an entry that is still being written:
+ * a writer stalled that long loses new entries rather than being lapped.
  *
- * Caller must hold log->mutex.
+ * Callers keep preemption disabled until logger_commit() and must not
+ * fault in between, so w_off is never held back for long.
  */
-static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
+static bool logger_reserve(struct logger_log *log, size_t len, u64 *posp)
 {
-	size_t count = 0;
+	u64 pos = atomic64_read(&log->ctl->w_head);
+	u64 chunk, old;
+
+	for (;;) {
+		if (pos + len - atomic64_read(&log->ctl->w_off) >
+		    LOGGER_RESERVE_MAX(log))
+			return false;
+		old = atomic64_cmpxchg(&log->ctl->w_head, pos, pos + len);
+		if (old == pos)
+			break;
+		pos = old;
+	}
+	chunk = round_up(pos, LOGGER_SYNC_CHUNK);
 
-	do {
-		size_t nr = sizeof(struct logger_entry) +
-			get_entry_msg_len(log, off);
-		off = logger_offset(log, off + nr);
-		count += nr;
-	} while (count < len);
+	/* a chunk boundary falls in our entry: the next one starts there */
+	if (chunk < pos + len)
+		WRITE_ONCE(log->sync[(chunk >> LOGGER_SYNC_SHIFT) &
+				     (log->nr_sync - 1)],
+			   chunk == pos ? pos : pos + len);
 
-	return off;
+	*posp = pos;
+	return true;
 }
 
 /*
- * is_between - is a < c < b, accounting for wrapping of a, b, and c
- *    positions in the buffer
- *
- * That is, if a<b, check for c between a and b
- * and if a>b, check for c outside (not between) a and b
- *
- * |------- a xxxxxxxx b --------|
- *               c^
- *
- * |xxxxx b --------- a xxxxxxxxx|
- *    c^
- *  or                    c^
+ * logger_commit - mark the entry at 'pos' complete, then move w_off past
+ * every complete entry in order. Whoever completes the oldest pending entry
+ * carries w_off over the later ones that are already done, so no writer
+ * ever waits for another.
  */
-static inline int is_between(size_t a, size_t b, size_t c)
+static void logger_commit(struct logger_log *log, u64 pos)
 {
-	if (a < b) {
-		/* is c between a and b? */
-		if (a < c && c <= b)
-			return 1;
-	} else {
-		/* is c outside of b through a? */
-		if (c <= b || a < c)
-			return 1;
-	}
+	struct logger_entry scratch;
+	struct logger_entry *entry;
+	u64 w_off, next, old;
 
-	return 0;
+	smp_wmb();
+	WRITE_ONCE(*logger_commit_word(log, pos), pos + 1);
+	/*
+	 * Either we see the commit word of the writer holding w_off back, or
+	 * it sees ours once it has moved w_off up to us.
+	 */
+	smp_mb();
+
+	w_off = atomic64_read(&log->ctl->w_off);
+	while (w_off < atomic64_read(&log->ctl->w_head) &&
+	       READ_ONCE(*logger_commit_word(log, w_off)) == w_off + 1) {
+		smp_rmb();
+		entry = get_entry_header(log, w_off, &scratch);
+		next = w_off + LOGGER_RECORD_LEN(entry->len);
+		old = atomic64_cmpxchg(&log->ctl->w_off, w_off, next);
+		w_off = old == w_off ? next : old;
+	}
 }
 
-/*
- * fix_up_readers - walk the list of all readers and "fix up" any who were
- * lapped by the writer; also do the same for the default "start head".
- * We do this by "pulling forward" the readers and start head to the first
- * entry after the new write head.
- *
- * The caller needs to hold log->mutex.
- */
-static void fix_up_readers(struct logger_log *log, size_t len)
+static inline void logger_wake_readers(struct logger_log *log)
 {
-	size_t old = log->w_off;
-	size_t new = logger_offset(log, old + len);
-	struct logger_reader *reader;
-
-	if (is_between(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
+	if (wq_has_sleeper(&log->wq))
+		wake_up_interruptible(&log->wq);
+}
 
-	list_for_each_entry(reader, &log->readers, list)
-		if (is_between(old, new, reader->r_off))
-			reader->r_off = get_next_entry(log, reader->r_off, len);
+static void logger_fill_header(struct logger_entry *header, size_t count)
+{
+	struct timespec now = current_kernel_time();
+
+	header->pid = current->tgid;
+	header->tid = current->pid;
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+	header->euid = current_euid();
+	header->len = count;
+	header->hdr_size = sizeof(struct logger_entry);
 }
 
 /*
@@ -421,67 +616,61 @@ static ssize_t logger_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
 	struct logger_entry header;
-	struct timespec now;
-	size_t len, count, w_off;
+	size_t count, copied;
+	char *buf, *slow = NULL;
+	ssize_t ret;
+	u64 pos;
 
 	count = min_t(size_t, iov_iter_count(from), LOGGER_ENTRY_MAX_PAYLOAD);
 
-	now = current_kernel_time();
-
-	header.pid = current->tgid;
-	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
-	header.euid = current_euid();
-	header.len = count;
-	header.hdr_size = sizeof(struct logger_entry);
-
 	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
+	if (unlikely(!count))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
 	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
+	 * Take the payload out of user memory before reserving any space, so
+	 * a fault can never stall us while w_off waits for our commit. Try
+	 * this cpu's bounce buffer without faulting first; if the payload is
+	 * not resident, copy it into a buffer of our own instead.
 	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	len = min(sizeof(header), log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, &header, len);
-	memcpy(log->buffer, (char *)&header + len, sizeof(header) - len);
-
-	/* Work with a copy until we are ready to commit the whole entry */
-	w_off =  logger_offset(log, log->w_off + sizeof(struct logger_entry));
-
-	len = min(count, log->size - w_off);
-
-	if (copy_from_iter(log->buffer + w_off, len, from) != len) {
-		/*
-		 * Note that by not updating log->w_off, this abandons the
-	 * portion of the new entry that *was* successfully
-		 * copied, just above.  This is intentional to avoid
-		 * message corruption from missing fragments.
-		 */
-		mutex_unlock(&log->mutex);
-		return -EFAULT;
+	preempt_disable();
+	buf = this_cpu_ptr(log->bounce);
+	pagefault_disable();
+	copied = copy_from_iter(buf, count, from);
+	pagefault_enable();
+	if (unlikely(copied != count)) {
+		preempt_enable();
+		iov_iter_revert(from, copied);
+		slow = kmalloc(count, GFP_KERNEL);
+		if (!slow)
+			return -ENOMEM;
+		if (copy_from_iter(slow, count, from) != count) {
+			kfree(slow);
+			return -EFAULT;
+		}
+		buf = slow;
+		preempt_disable();
 	}
 
-	if (copy_from_iter(log->buffer, count - len, from) != count - len) {
-		mutex_unlock(&log->mutex);
-		return -EFAULT;
-	}
+	logger_fill_header(&header, count);
+	ret = count;
 
-	log->w_off = logger_offset(log, w_off + count);
-	mutex_unlock(&log->mutex);
+	if (likely(logger_reserve(log, LOGGER_RECORD_LEN(count), &pos))) {
+		logger_put_header(log, pos, &header);
+		logger_copy_in(log, pos + LOGGER_HDR_OFF + sizeof(header),
+			       buf, count);
+		logger_commit(log, pos);
+	} else {
+		ret = -EAGAIN;
+	}
+	preempt_enable();
+	kfree(slow);
 
 	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	if (ret > 0)
+		logger_wake_readers(log);
 
-	return len;
+	return ret;
 }
 
 static struct logger_log *get_log_from_minor(int minor)
@@ -498,72 +687,43 @@ void logger_kmsg_nwrite(const char *tag, const char *msg, size_t len_msg)
 {
 	struct logger_log *log = global_log;
 	struct logger_entry header;
-	struct timespec now;
-	size_t len_tag, len;
-	size_t total, count, w_off = 0;
-	char *buf;
+	size_t len_tag, count;
+	u64 pos, w_off;
 
 	if (unlikely(!len_msg || !log)) {
 		return;
 	}
 
-	mutex_lock(&log->mutex);
-	if (!log->cache) {
-		log->cache = kmalloc(LOGGER_ENTRY_MAX_PAYLOAD, GFP_KERNEL);
-		if (!log->cache) {
-			mutex_unlock(&log->mutex);
-			return;
-		}
-	}
+	/* priority byte, tag and message, both nul terminated */
+	len_tag = min_t(size_t, strlen(tag), LOGGER_ENTRY_MAX_PAYLOAD - 3);
+	len_msg = min_t(size_t, len_msg, LOGGER_ENTRY_MAX_PAYLOAD - 3 - len_tag);
+	count = len_tag + len_msg + 3;
 
-	len_tag = strlen(tag);
-	total = len_tag + len_msg + 3;
-	buf = log->cache;
+	logger_fill_header(&header, count);
 
-	buf[w_off] = 0;
-	w_off += 1;
+	preempt_disable();
+	if (unlikely(!logger_reserve(log, LOGGER_RECORD_LEN(count), &pos))) {
+		preempt_enable();
+		return;
+	}
+	logger_put_header(log, pos, &header);
+	w_off = pos + LOGGER_HDR_OFF + sizeof(header);
 
-	memcpy(buf + w_off, tag, len_tag);
+	logger_copy_in(log, w_off, "", 1);
+	w_off += 1;
+	logger_copy_in(log, w_off, tag, len_tag);
 	w_off += len_tag;
-	buf[w_off++] = '\0';
-
-	memcpy(buf + w_off, msg, len_msg);
+	logger_copy_in(log, w_off, "", 1);
+	w_off += 1;
+	logger_copy_in(log, w_off, msg, len_msg);
 	w_off += len_msg;
-	buf[w_off++] = '\0';
-
-	count = min_t(size_t, total, LOGGER_ENTRY_MAX_PAYLOAD);
-
-	now = current_kernel_time();
-
-	header.pid = current->tgid;
-	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
-	header.euid = current_euid();
-	header.len = count;
-	header.hdr_size = sizeof(struct logger_entry);
-
+	logger_copy_in(log, w_off, "", 1);
 
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	len = min(sizeof(header), log->size - log->w_off);
-
-	memcpy(log->buffer + log->w_off, &header, len);
-	memcpy(log->buffer, (char *)&header + len, sizeof(header) - len);
-
-	/* Work with a copy until we are ready to commit the whole entry */
-	w_off = logger_offset(log, log->w_off + sizeof(struct logger_entry));
-
-	len = min(count, log->size - w_off);
-
-	memcpy(log->buffer + w_off, buf, len);
-	memcpy(log->buffer, buf + len, count - len);
-
-	log->w_off = logger_offset(log, w_off + count);
-	mutex_unlock(&log->mutex);
+	logger_commit(log, pos);
+	preempt_enable();
 
 	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	logger_wake_readers(log);
 }
 EXPORT_SYMBOL(logger_kmsg_nwrite);
 
@@ -601,6 +761,7 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		mutex_lock(&log->mutex);
 		reader->r_off = log->head;
+		fix_up_reader(log, reader);
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
 
@@ -635,7 +796,9 @@ static int logger_release(struct inode *ignored, struct file *file)
 /*
  * logger_poll - the log's poll file operation, for poll/select/epoll
  *
- * Note we always return POLLOUT, because you can always write() to the log.
+ * Note we always return POLLOUT. A write() only fails if an entry stays
+ * uncommitted while almost a whole log is written after it, and writers
+ * hold their reservations with preemption disabled and without faulting.
  * Note also that, strictly speaking, a return value of POLLIN does not
  * guarantee that the log is readable without blocking, as there is a small
  * chance that the writer can lap the reader in the interim between poll()
@@ -656,11 +819,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
-	if (!reader->r_all)
-		reader->r_off = get_next_entry_by_uid(log,
-						      reader->r_off, current_euid());
-
-	if (log->w_off != reader->r_off)
+	if (logger_reader_next(log, reader) != reader->r_off)
 		ret |= POLLIN | POLLRDNORM;
 	mutex_unlock(&log->mutex);
 
@@ -681,12 +840,48 @@ static long logger_set_version(struct logger_reader *reader, void __user *arg)
 	return 0;
 }
 
+/*
+ * logger_advance - move an mmap reader forward to the position it has
+ * consumed up to, then hand back its position after any fix-up. Positions
+ * at or before the current one just query it. Only readers of every uid
+ * may move themselves, and only onto the start of a committed entry or
+ * w_off, so read() never parses a header out of an entry's payload.
+ */
+static long logger_advance(struct logger_log *log, struct logger_reader *reader,
+			   u64 __user *arg)
+{
+	u64 pos, w_off;
+
+	if (!reader->r_all)
+		return -EPERM;
+
+	if (get_user(pos, arg))
+		return -EFAULT;
+
+	if (pos > reader->r_off) {
+		w_off = atomic64_read(&log->ctl->w_off);
+		if (pos > w_off || !IS_ALIGNED(pos, LOGGER_ALIGN))
+			return -EINVAL;
+		/* pairs with the barrier in logger_commit() */
+		smp_rmb();
+		if (pos != w_off &&
+		    READ_ONCE(*logger_commit_word(log, pos)) != pos + 1)
+			return -EINVAL;
+		reader->r_off = pos;
+	}
+
+	fix_up_reader(log, reader);
+
+	return put_user(reader->r_off, arg);
+}
+
 static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct logger_log *log = file_get_log(file);
 	struct logger_reader *reader;
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
+	u64 w_off;
 
 	mutex_lock(&log->mutex);
 
@@ -700,10 +895,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
-		else
-			ret = (log->size - reader->r_off) + log->w_off;
+		fix_up_reader(log, reader);
+		ret = atomic64_read(&log->ctl->w_off) - reader->r_off;
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -712,11 +905,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		reader = file->private_data;
 
-		if (!reader->r_all)
-			reader->r_off = get_next_entry_by_uid(log,
-							      reader->r_off, current_euid());
-
-		if (log->w_off != reader->r_off)
+		if (logger_reader_next(log, reader) != reader->r_off)
 			ret = get_user_hdr_len(reader->r_ver) +
 				get_entry_msg_len(log, reader->r_off);
 		else
@@ -732,9 +921,10 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			ret = -EPERM;
 			break;
 		}
+		w_off = atomic64_read(&log->ctl->w_off);
 		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+			reader->r_off = w_off;
+		log->head = w_off;
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -753,6 +943,14 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = logger_set_version(reader, argp);
 		break;
+	case LOGGER_ADVANCE:
+		if (!(file->f_mode & FMODE_READ)) {
+			ret = -EBADF;
+			break;
+		}
+		reader = file->private_data;
+		ret = logger_advance(log, reader, argp);
+		break;
 	}
 
 	mutex_unlock(&log->mutex);
@@ -760,11 +958,48 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+/*
+ * logger_mmap - map the control page and the log buffer read-only, so a
+ * reader can parse entries in place. Entries of every uid are visible, so
+ * only readers allowed to read all of them may map the log.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	log = reader->log;
+	if (!reader->r_all)
+		return -EPERM;
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start != PAGE_SIZE + log->size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	ret = remap_vmalloc_range_partial(vma, vma->vm_start, log->ctl,
+					  0, PAGE_SIZE);
+	if (ret)
+		return ret;
+
+	return remap_vmalloc_range_partial(vma, vma->vm_start + PAGE_SIZE,
+					   log->buffer, 0, log->size);
+}
+
 static const struct file_operations logger_fops = {
 	.owner = THIS_MODULE,
 	.read = logger_read,
 	.write_iter = logger_write_iter,
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -781,7 +1016,16 @@ static int __init create_log(char *log_name, int size)
 	struct logger_log *log;
 	unsigned char *buffer;
 
-	buffer = vmalloc(size);
+	BUILD_BUG_ON(offsetof(struct logger_ctl, w_off) !=
+		     offsetof(struct logger_mmap_ctl, w_off));
+	BUILD_BUG_ON(sizeof(struct logger_ctl) != sizeof(struct logger_mmap_ctl));
+	/* entries must not share a commit word */
+	BUILD_BUG_ON((1 << LOGGER_COMMIT_SHIFT) > LOGGER_RECORD_LEN(1));
+
+	if (!is_power_of_2(size) || size < 2 * LOGGER_SYNC_CHUNK)
+		return -EINVAL;
+
+	buffer = vmalloc_user(size);
 	if (buffer == NULL)
 		return -ENOMEM;
 
@@ -791,7 +1035,36 @@ static int __init create_log(char *log_name, int size)
 		goto out_free_buffer;
 	}
 	log->buffer = buffer;
-	log->cache = NULL;
+
+	log->ctl = vmalloc_user(PAGE_SIZE);
+	if (log->ctl == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
+	log->ctl->size = size;
+	log->ctl->hdr_off = LOGGER_HDR_OFF;
+	log->ctl->align = LOGGER_ALIGN;
+
+	/* zeroed, so no commit word matches a position before its commit */
+	log->nr_commit = size >> LOGGER_COMMIT_SHIFT;
+	log->commit = vzalloc(log->nr_commit * sizeof(*log->commit));
+	if (log->commit == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
+
+	log->bounce = __alloc_percpu(LOGGER_ENTRY_MAX_PAYLOAD, SMP_CACHE_BYTES);
+	if (log->bounce == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
+
+	log->nr_sync = size >> LOGGER_SYNC_SHIFT;
+	log->sync = kcalloc(log->nr_sync, sizeof(*log->sync), GFP_KERNEL);
+	if (log->sync == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
 
 	log->misc.minor = MISC_DYNAMIC_MINOR;
 	log->misc.name = kstrdup(log_name, GFP_KERNEL);
@@ -806,7 +1079,8 @@ static int __init create_log(char *log_name, int size)
 	init_waitqueue_head(&log->wq);
 	INIT_LIST_HEAD(&log->readers);
 	mutex_init(&log->mutex);
-	log->w_off = 0;
+	atomic64_set(&log->ctl->w_head, 0);
+	atomic64_set(&log->ctl->w_off, 0);
 	log->head = 0;
 	log->size = size;
 
@@ -831,6 +1105,10 @@ static int __init create_log(char *log_name, int size)
 	kfree(log->misc.name);
 
 out_free_log:
+	kfree(log->sync);
+	free_percpu(log->bounce);
+	vfree(log->commit);
+	vfree(log->ctl);
 	kfree(log);
 
 out_free_buffer:
@@ -842,7 +1120,7 @@ static int __init logger_init(void)
 {
 	int ret;
 
-	ret = create_log(LOGGER_LOG_MAIN, 3*1024*1024);
+	ret = create_log(LOGGER_LOG_MAIN, 4*1024*1024);
 	if (unlikely(ret))
 		goto out;
 out:
@@ -857,6 +1135,10 @@ static void __exit logger_exit(void)
 		/* we have to delete all the entry inside log_list */
 		misc_deregister(&current_log->misc);
 		vfree(current_log->buffer);
+		kfree(current_log->sync);
+		free_percpu(current_log->bounce);
+		vfree(current_log->commit);
+		vfree(current_log->ctl);
 		kfree(current_log->misc.name);
 		list_del(&current_log->logs);
 		kfree(current_log);
@@ -63,6 +63,42 @@ struct logger_entry {
 
 #define LOGGER_ENTRY_MAX_PAYLOAD	4076
 
+/**
+ * struct logger_mmap_ctl - control page of a reader mapping
+ * @w_head:	Position writers have reserved space up to
+ * @w_off:	Position below which every entry is complete
+ * @size:	Size of the log buffer, a power of two
+ * @hdr_off:	Offset of struct logger_entry from the start of an entry
+ * @align:	Entries start and are padded to this alignment
+ *
+ * A reader that mmap()s the log read-only at offset 0 with length
+ * PAGE_SIZE + @size gets this page followed by the log buffer. Positions
+ * count bytes since the log was created; position p is at byte
+ * (p & (@size - 1)) of the buffer, and an entry may wrap at its end.
+ *
+ * An entry at position p holds a struct logger_entry at p + @hdr_off,
+ * followed by its msg, and the next entry starts at
+ * p + ALIGN(@hdr_off + hdr_size + len, @align). Entries from the reader's
+ * position up to @w_off can be parsed in place. Once parsed, an entry is
+ * still intact only if @w_head - p <= @size; otherwise it may have been
+ * overwritten and must be discarded. A reader that finds its position
+ * lapped can restart from @w_off, which writers never lap.
+ *
+ * LOGGER_ADVANCE then consumes the parsed entries. It takes an entry
+ * boundary no later than @w_off and, like mmap(), is only allowed to
+ * readers that may read the entries of every uid.
+ */
+struct logger_mmap_ctl {
+	__u64		w_head;
+	__u64		w_off;
+	__u64		size;
+	__u32		hdr_off;
+	__u32		align;
+};
+
+#define LOGGER_MMAP_ALIGN	8
+#define LOGGER_MMAP_HDR_OFF	8
+
 #define __LOGGERIO	0xAE
 
 #define LOGGER_GET_LOG_BUF_SIZE		_IO(__LOGGERIO, 1) /* size of log */
@@ -71,5 +107,6 @@ struct logger_entry {
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
 #define LOGGER_GET_VERSION		_IO(__LOGGERIO, 5) /* abi version */
 #define LOGGER_SET_VERSION		_IO(__LOGGERIO, 6) /* abi version */
+#define LOGGER_ADVANCE			_IOWR(__LOGGERIO, 7, __u64) /* mmap read position */
 
 #endif /* _LINUX_LOGGER_H */
@@ -17,6 +17,8 @@
 #include <linux/version.h>
 #include <linux/freezer.h>
 #include <linux/workqueue.h>
+#include <linux/tick.h>
+#include <linux/energy_model.h>
 #include <linux/cpufreq_bouncing.h>
 
 #define NSEC_TO_MSEC(val) (val / NSEC_PER_MSEC)
@@ -25,6 +27,11 @@
 #define NR_FREQ 32
 #define NR_CLUS_MAX 3
 #define NR_CORE_MAX 8
+/* headroom required below the limit before the model raises the cap */
+#define MODEL_HYST_MC 1000
+/* idle time sampling period for the thermal model */
+#define MODEL_LOAD_PERIOD_MS 20
+#define MODEL_BUSY_UNKNOWN UINT_MAX
 
 /* cluster based */
 struct cpufreq_bouncing {
@@ -64,6 +71,27 @@ struct cpufreq_bouncing {
 	s64 up_limit_ns;
 	unsigned int min_freq;
 
+	/*
+	 * config: thermal model
+	 * first order RC model of the cluster, temperatures in milli-celsius,
+	 * resistance in milli-celsius per mW and time constant in ms
+	 */
+	bool model_enable;
+	unsigned int model_r;
+	unsigned int model_tau_ms;
+	int model_amb;
+	int model_limit;
+	unsigned int model_horizon_ms;
+
+	/* thermal model state */
+	s64 model_temp;
+	unsigned int model_power;
+	int model_target;
+
+	/* per cpu active power in mW of each freq level, from EM */
+	bool power_valid;
+	unsigned int power[NR_FREQ];
+
 	/*
 	 * check current limitation
 	 * if limitation higher than target, not count
@@ -95,6 +123,11 @@ struct cpufreq_bouncing {
 		.limit_level   = 12,
 		.down_speed    = 2,
 		.up_speed      = 1,
+		.model_r          = 10,
+		.model_tau_ms     = 3000,
+		.model_amb        = 35000,
+		.model_limit      = 75000,
+		.model_horizon_ms = 1000,
 		.freqs_resident[0 ... NR_FREQ - 1] = -1,
 		.freqs[0 ... NR_FREQ - 1] = UINT_MAX,
 	},
@@ -109,11 +142,29 @@ struct cpufreq_bouncing {
 		.limit_level   = 13,
 		.down_speed    = 2,
 		.up_speed      = 1,
+		.model_r          = 16,
+		.model_tau_ms     = 2000,
+		.model_amb        = 35000,
+		.model_limit      = 80000,
+		.model_horizon_ms = 1000,
 		.freqs_resident[0 ... NR_FREQ - 1] = -1,
 		.freqs[0 ... NR_FREQ - 1] = UINT_MAX,
 	}
 };
 
+/*
+ * idle accounting for the thermal model, sampled off the frequency update
+ * path by cb_load_work while any cluster runs the model
+ */
+struct cb_cpu_load {
+	u64 idle_us;
+	u64 wall_us;
+	unsigned int busy;	/* [0, SCHED_CAPACITY_SCALE] over the last period */
+};
+static DEFINE_PER_CPU(struct cb_cpu_load, cb_load);
+static void cb_load_sample(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(cb_load_work, cb_load_sample);
+
 /* main thread */
 static struct task_struct *cb_task;
 
@@ -220,6 +271,11 @@ static int enable_store(const char *buf, const struct kernel_param *kp)
 		cb->last_freq_update_ts = 0;
 		cb->acc = 0;
 		cb->cur_level = cb->max_level ? cb->max_level : NR_FREQ - 1;
+
+		/* reset thermal model */
+		cb->model_temp = cb->model_amb;
+		cb->model_power = 0;
+		cb->model_target = cb->cur_level;
 	}
 
 	if (self_activate)
@@ -455,6 +511,104 @@ static struct kernel_param_ops cb_trace_ops = {
 };
 module_param_cb(trace, &cb_trace_ops, NULL, 0444);
 
+static int cb_model_store(const char *buf, const struct kernel_param *kp)
+{
+	/*
+	 * temperatures use milli-celsius, r uses milli-celsius per mW
+	 * format: clus,enable,r,tau_ms,amb,limit,horizon_ms
+	 * echo "2,1,16,2000,35000,80000,1000" > model
+	 */
+	struct pack {
+		int clus;
+		int enable;
+		unsigned int r;
+		unsigned int tau_ms;
+		int amb;
+		int limit;
+		unsigned int horizon_ms;
+	} v;
+	struct cpufreq_bouncing *cb;
+	struct cb_cpu_load *load;
+	int cpu;
+
+	if (debug)
+		pr_info("%s\n", buf);
+
+	if (sscanf(buf, "%d,%d,%u,%u,%d,%d,%u\n",
+		&v.clus,
+		&v.enable,
+		&v.r,
+		&v.tau_ms,
+		&v.amb,
+		&v.limit,
+		&v.horizon_ms) != 7)
+		goto out;
+
+	if (v.clus < 0 || v.clus >= cb_pol_idx)
+		goto out;
+
+	cb = &cb_stuff[v.clus];
+
+	if (v.enable && !cb->power_valid)
+		goto out;
+
+	if (!v.r || !v.tau_ms || !v.horizon_ms || v.limit <= v.amb)
+		goto out;
+
+	/* begin update model */
+	cb->model_enable = false;
+	cb->model_r = v.r;
+	cb->model_tau_ms = v.tau_ms;
+	cb->model_amb = v.amb;
+	cb->model_limit = v.limit;
+	cb->model_horizon_ms = v.horizon_ms;
+	cb->model_temp = v.amb;
+	cb->model_power = 0;
+	cb->model_target = cb->max_level;
+	cb->cur_level = cb->max_level;
+	cb->last_freq_update_ts = 0;
+	for_each_possible_cpu(cpu) {
+		if (per_cpu(cbs, cpu) != cb)
+			continue;
+		load = &per_cpu(cb_load, cpu);
+		load->wall_us = 0;
+		WRITE_ONCE(load->busy, MODEL_BUSY_UNKNOWN);
+	}
+	cb->model_enable = !!v.enable;
+
+	if (cb->model_enable)
+		queue_delayed_work(system_power_efficient_wq, &cb_load_work, 0);
+
+	return 0;
+out:
+	pr_warn("model: invalid:%s\n", buf);
+	return -EINVAL;
+}
+
+static int cb_model_show(char *buf, const struct kernel_param *kp)
+{
+	struct cpufreq_bouncing *cb;
+	int i, cnt = 0;
+
+	/* format: clus,enable,r,tau_ms,amb,limit,horizon_ms,temp,power,target_freq,cur_freq */
+	for (i = 0; i < min(NR_CLUS_MAX, cb_pol_idx); ++i) {
+		cb = &cb_stuff[i];
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%d,%d,%u,%u,%d,%d,%u,%lld,%u,%u,%u\n",
+			i, cb->model_enable, cb->model_r, cb->model_tau_ms,
+			cb->model_amb, cb->model_limit, cb->model_horizon_ms,
+			cb->model_temp, cb->model_power,
+			cb->freqs[cb->model_target], cb->freqs[cb->cur_level]);
+	}
+
+	return cnt;
+}
+
+static struct kernel_param_ops cb_model_ops = {
+	.set = cb_model_store,
+	.get = cb_model_show,
+};
+module_param_cb(model, &cb_model_ops, NULL, 0664);
+
 static inline bool clus_isolated(struct cpufreq_policy *pol)
 {
 	cpumask_t active;
@@ -517,6 +671,157 @@ void cb_reset(int cpu, u64 time)
 	cb->cur_level = cb->max_level;
 }
 
+/* sample the busy ratio of every cpu in a cluster running the model */
+static void cb_load_sample(struct work_struct *work)
+{
+	struct cpufreq_bouncing *cb;
+	struct cb_cpu_load *load;
+	u64 idle, wall, idle_delta, wall_delta;
+	bool active = false;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		cb = per_cpu(cbs, cpu);
+		if (!cb || !cb->model_enable)
+			continue;
+
+		active = true;
+		load = &per_cpu(cb_load, cpu);
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		if (idle == -1ULL) {
+			WRITE_ONCE(load->busy, MODEL_BUSY_UNKNOWN);
+			continue;
+		}
+
+		idle_delta = idle - load->idle_us;
+		wall_delta = wall - load->wall_us;
+		if (load->wall_us && wall_delta)
+			WRITE_ONCE(load->busy, idle_delta >= wall_delta ? 0 :
+				div64_u64((wall_delta - idle_delta) << SCHED_CAPACITY_SHIFT,
+					wall_delta));
+		load->idle_us = idle;
+		load->wall_us = wall;
+	}
+
+	if (active)
+		queue_delayed_work(system_power_efficient_wq, &cb_load_work,
+				msecs_to_jiffies(MODEL_LOAD_PERIOD_MS));
+}
+
+/* latest sampled busy ratio of each cpu in pol */
+static int cb_model_load(struct cpufreq_policy *pol, unsigned int *busy)
+{
+	int cpu, nr = 0;
+
+	for_each_cpu(cpu, pol->related_cpus) {
+		if (nr >= NR_CORE_MAX)
+			break;
+
+		busy[nr] = READ_ONCE(per_cpu(cb_load, cpu).busy);
+		if (busy[nr] == MODEL_BUSY_UNKNOWN)
+			return -EAGAIN;
+		++nr;
+	}
+
+	return nr;
+}
+
+/* lowest level running at or above freq */
+static int cb_freq_level(struct cpufreq_bouncing *cb, unsigned int freq)
+{
+	int level;
+
+	for (level = cb->min_level; level < cb->max_level; ++level) {
+		if (cb->freqs[level] >= freq)
+			break;
+	}
+
+	return level;
+}
+
+/*
+ * cluster power when capped at level. the same amount of work at a lower
+ * clock keeps the cpu busy for longer, so busy ratios measured at cur are
+ * rescaled before being weighted with the per cpu power of the level.
+ */
+static unsigned int cb_model_power(struct cpufreq_bouncing *cb,
+		unsigned int *busy, int nr, unsigned int cur, int level)
+{
+	unsigned int freq = max(cb->freqs[level], 1U);
+	u64 power = 0, demand;
+	int i;
+
+	for (i = 0; i < nr; ++i) {
+		demand = div_u64((u64)busy[i] * cur, freq);
+		power += min_t(u64, demand, SCHED_CAPACITY_SCALE) * cb->power[level];
+	}
+
+	return power >> SCHED_CAPACITY_SHIFT;
+}
+
+/*
+ * temperature after dt_ns with constant power, using an implicit euler step
+ * of the RC response so it stays stable for any dt:
+ * T' = Tss + (T - Tss) * tau / (tau + dt), Tss = Tamb + P * R
+ */
+static s64 cb_model_settle(struct cpufreq_bouncing *cb, s64 temp,
+		unsigned int power, u64 dt_ns)
+{
+	s64 steady = cb->model_amb + (s64)power * cb->model_r;
+	u64 tau = MSEC_TO_NSEC((u64)cb->model_tau_ms);
+
+	return steady + div64_s64((temp - steady) * (s64)tau, tau + dt_ns);
+}
+
+/*
+ * advance the thermal model by the time since the last update, then pick
+ * the highest level whose projected temperature at the end of the horizon
+ * stays under the limit. the cap drops straight to the sustainable level
+ * and climbs back up_speed levels at a time with some headroom, so the
+ * cluster settles on a steady cap instead of bouncing around the limit.
+ */
+static void cb_model_update(struct cpufreq_bouncing *cb,
+		struct cpufreq_policy *pol, u64 time, u64 update_delta)
+{
+	unsigned int busy[NR_CORE_MAX];
+	u64 horizon = MSEC_TO_NSEC((u64)cb->model_horizon_ms);
+	int nr, level, next, prev_level = cb->cur_level;
+	unsigned int power;
+
+	nr = cb_model_load(pol, busy);
+	if (nr < 0)
+		return;
+
+	cb->model_power = cb_model_power(cb, busy, nr, pol->cur,
+			cb_freq_level(cb, pol->cur));
+	cb->model_temp = cb_model_settle(cb, cb->model_temp, cb->model_power,
+			time - cb->last_ts);
+
+	for (level = cb->max_level; level > cb->min_level; --level) {
+		power = cb_model_power(cb, busy, nr, pol->cur, level);
+		if (cb_model_settle(cb, cb->model_temp, power, horizon) <= cb->model_limit)
+			break;
+	}
+	cb->model_target = level;
+
+	if (level < prev_level) {
+		if (update_delta >= cb->down_limit_ns)
+			cb->cur_level = level;
+	} else if (level > prev_level) {
+		next = min(prev_level + max(cb->up_speed, 1), level);
+		power = cb_model_power(cb, busy, nr, pol->cur, next);
+		if (update_delta >= cb->up_limit_ns &&
+				cb_model_settle(cb, cb->model_temp, power, horizon) <=
+				cb->model_limit - MODEL_HYST_MC)
+			cb->cur_level = next;
+	}
+
+	if (cb->cur_level != prev_level) {
+		cb->last_freq_update_ts = time;
+		cb->freqs_resident[prev_level] += update_delta;
+	}
+}
+
 void cb_update(struct cpufreq_policy *pol, u64 time)
 {
 	struct cpufreq_bouncing *cb;
@@ -555,6 +860,12 @@ void cb_update(struct cpufreq_policy *pol, u64 time)
 	delta = (min_over_target_freq || isolated) ? 0 : time - cb->last_ts;
 	update_delta = time - cb->last_freq_update_ts;
 
+	prev_level = cb->cur_level;
+	if (cb->model_enable) {
+		cb_model_update(cb, pol, time, update_delta);
+		goto unlock;
+	}
+
 	/* check cpufreq */
 	if (pol->cur >= cb->limit_freq) {
 		/* accumulate delta time */
@@ -565,7 +876,6 @@ void cb_update(struct cpufreq_policy *pol, u64 time)
 	}
 
 	/* check if need to update limitation */
-	prev_level = cb->cur_level;
 	if (cb->acc >= cb->limit_thres) {
 		/* check last update */
 		if (update_delta >= cb->down_limit_ns) {
@@ -582,6 +892,7 @@ void cb_update(struct cpufreq_policy *pol, u64 time)
 		}
 	}
 
+unlock:
 	/* when min bar is higher than cb limit, unlock immediately */
 	if (min_over_target_freq || isolated)
 		cb->cur_level = cb->max_level;
@@ -590,10 +901,11 @@ void cb_update(struct cpufreq_policy *pol, u64 time)
 	//cb_core_boost(time);
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
-	/* queue qos request */
+	/* queue qos request, model changes are already rate limited */
 	if (freq_qos_check &&
 			cb->qos_req.pnode.prio != cb->freqs[cb->cur_level] &&
-			update_delta >= max(cb->down_limit_ns, cb->up_limit_ns) &&
+			((cb->model_enable && cb->cur_level != prev_level) ||
+			update_delta >= max(cb->down_limit_ns, cb->up_limit_ns)) &&
 			likely(cb_qos_wq))
 		queue_work(cb_qos_wq, &cb->qos_work);
 #endif
@@ -617,11 +929,28 @@ void cb_update(struct cpufreq_policy *pol, u64 time)
 }
 EXPORT_SYMBOL(cb_update);
 
+#ifdef CONFIG_ENERGY_MODEL
+static unsigned int cb_em_power(struct em_perf_domain *pd, unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < pd->nr_cap_states; ++i) {
+		if (pd->table[i].frequency >= freq)
+			return pd->table[i].power;
+	}
+
+	return pd->table[pd->nr_cap_states - 1].power;
+}
+#endif
+
 static int __cpufreq_policy_parser(int cpu, int cb_idx)
 {
 	struct cpufreq_policy *pol = cpufreq_cpu_get_raw(cpu);
 	struct cpufreq_frequency_table *table, *pos;
 	struct cpufreq_bouncing *cb;
+#ifdef CONFIG_ENERGY_MODEL
+	struct em_perf_domain *pd;
+#endif
 
 	unsigned int freq = 0, max_freq = 0, min_freq = UINT_MAX;
 	int idx, freq_levels = 0;
@@ -660,6 +989,19 @@ static int __cpufreq_policy_parser(int cpu, int cb_idx)
 		}
 	}
 	cb->freq_levels = freq_levels;
+
+#ifdef CONFIG_ENERGY_MODEL
+	/* power table for the thermal model */
+	pd = em_cpu_get(cpu);
+	if (pd && pd->nr_cap_states) {
+		cpufreq_for_each_valid_entry_idx(pos, table, idx)
+			cb->power[idx] = cb_em_power(pd, pos->frequency);
+		cb->power_valid = true;
+	}
+#endif
+	cb->model_temp = cb->model_amb;
+	cb->model_target = cb->max_level;
+
 	return cpu + cpumask_weight(pol->related_cpus);
 }
 
@@ -729,6 +729,26 @@ static struct kernel_param_ops tpd_pt_ops = {
 };
 module_param_cb(tpd_dynamic, &tpd_pt_ops, NULL, 0664);
 
+/*
+ * In-kernel users (game_opt task placement) tag threads by measured demand
+ * rather than by name. They hold one tpd_enable/tpd_ctl reference while
+ * any of their decisions are in effect.
+ */
+void tpd_auto_enable(bool enable)
+{
+	set_tpd_ctl(enable);
+
+	if (should_update_tpd_enable(enable))
+		tpd_enable = enable;
+}
+EXPORT_SYMBOL_GPL(tpd_auto_enable);
+
+void tpd_auto_tag(struct task_struct *tsk, int decision)
+{
+	tagging(tsk, decision);
+}
+EXPORT_SYMBOL_GPL(tpd_auto_tag);
+
 //#ifndef task_is_fg
 //static __always_inline bool task_is_fg(struct task_struct *task)
 //{
@@ -830,13 +850,13 @@ void tpd_mask(struct task_struct* tsk, cpumask_t *request)
 
 	tmp_tpd = (tsk->tpd_st > 0) ? tsk->tpd_st : tsk->tpd;
 
-	while (tmp_tpd > 0) {
+	while (tmp_tpd > 0 && i < cluster_total) {
 		if (tmp_tpd & 1) {
 			for_each_cpu(j, &clusters[i].related_cpus)
 				cpumask_set_cpu(j, &mask);
-			i++;
 		}
 		tmp_tpd = tmp_tpd >> 1;
+		i++;
 	}
 	cpumask_copy(request, &mask);
 	tpd_logi("tpd_mask: related_cpus = ");
@@ -68,6 +68,23 @@ struct erofs_sb_info {
 	/* threshold for decompression synchronously */
 	unsigned int max_sync_decompress_pages;
 
+	/* spread large background queues over idle cpus */
+	bool decomp_fanout;
+	/* queues with fewer pclusters stay on the completing cpu */
+	unsigned int fanout_min_pclusters;
+	/* latency-sensitive readers decompress inline above this delay */
+	unsigned int sync_queue_thresh_us;
+
+	/* decompression statistics, exported through sysfs */
+	atomic64_t decomp_bytes;
+	atomic64_t decomp_ns;
+	atomic64_t queue_cnt;
+	atomic64_t queue_ns;
+	atomic64_t queue_max_ns;
+	atomic64_t queue_ewma_ns;
+	atomic64_t fanout_cnt;
+	atomic64_t latency_sync_cnt;
+
 	unsigned int shrinker_run_no;
 	u16 available_compr_algs;
 
@@ -103,6 +120,10 @@ struct erofs_sb_info {
 	u32 feature_incompat;
 
 	unsigned int mount_opt;
+
+	/* sysfs support */
+	struct kobject s_kobj;		/* /sys/fs/erofs/<devname> */
+	struct completion s_kobj_unregister;
 };
 
 #define EROFS_SB(sb) ((struct erofs_sb_info *)(sb)->s_fs_info)
@@ -418,6 +439,12 @@ int erofs_pcpubuf_growsize(unsigned int nrpages);
 void erofs_pcpubuf_init(void);
 void erofs_pcpubuf_exit(void);
 
+/* sysfs.c */
+int erofs_register_sysfs(struct super_block *sb);
+void erofs_unregister_sysfs(struct super_block *sb);
+int __init erofs_init_sysfs(void);
+void erofs_exit_sysfs(void);
+
 /* utils.c / zdata.c */
 struct page *erofs_allocpage(struct list_head *pool, gfp_t gfp);
 
@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Per-filesystem tunables and statistics under /sys/fs/erofs/<dev>/
+ */
+#include <linux/sysfs.h>
+#include <linux/kobject.h>
+
+#include "internal.h"
+
+enum {
+	attr_pointer_ui,
+	attr_pointer_bool,
+	attr_decomp_stat,
+};
+
+enum {
+	struct_erofs_sb_info,
+};
+
+struct erofs_attr {
+	struct attribute attr;
+	short attr_id;
+	int struct_type, offset;
+};
+
+#define EROFS_ATTR(_name, _mode, _id)					\
+static struct erofs_attr erofs_attr_##_name = {				\
+	.attr = {.name = __stringify(_name), .mode = _mode },		\
+	.attr_id = attr_##_id,						\
+}
+#define EROFS_ATTR_FUNC(_name, _mode)	EROFS_ATTR(_name, _mode, _name)
+
+#define EROFS_ATTR_OFFSET(_name, _mode, _id, _struct)			\
+static struct erofs_attr erofs_attr_##_name = {				\
+	.attr = {.name = __stringify(_name), .mode = _mode },		\
+	.attr_id = attr_##_id,						\
+	.struct_type = struct_##_struct,				\
+	.offset = offsetof(struct _struct, _name),			\
+}
+
+#define EROFS_ATTR_RW(_name, _id, _struct)				\
+	EROFS_ATTR_OFFSET(_name, 0644, _id, _struct)
+#define EROFS_ATTR_RW_UI(_name, _struct)				\
+	EROFS_ATTR_RW(_name, pointer_ui, _struct)
+#define EROFS_ATTR_RW_BOOL(_name, _struct)				\
+	EROFS_ATTR_RW(_name, pointer_bool, _struct)
+
+#define ATTR_LIST(name) (&erofs_attr_##name.attr)
+
+#ifdef CONFIG_EROFS_FS_ZIP
+EROFS_ATTR_RW_BOOL(decomp_fanout, erofs_sb_info);
+EROFS_ATTR_RW_UI(fanout_min_pclusters, erofs_sb_info);
+EROFS_ATTR_RW_UI(sync_queue_thresh_us, erofs_sb_info);
+EROFS_ATTR_FUNC(decomp_stat, 0444);
+#endif
+
+static struct attribute *erofs_attrs[] = {
+#ifdef CONFIG_EROFS_FS_ZIP
+	ATTR_LIST(decomp_fanout),
+	ATTR_LIST(fanout_min_pclusters),
+	ATTR_LIST(sync_queue_thresh_us),
+	ATTR_LIST(decomp_stat),
+#endif
+	NULL,
+};
+
+
+static unsigned char *__struct_ptr(struct erofs_sb_info *sbi,
+				   int struct_type, int offset)
+{
+	if (struct_type == struct_erofs_sb_info)
+		return (unsigned char *)sbi + offset;
+	return NULL;
+}
+
+#ifdef CONFIG_EROFS_FS_ZIP
+static ssize_t erofs_decomp_stat_show(struct erofs_sb_info *sbi, char *buf)
+{
+	u64 bytes = atomic64_read(&sbi->decomp_bytes);
+	u64 ns = atomic64_read(&sbi->decomp_ns);
+	u64 qcnt = atomic64_read(&sbi->queue_cnt);
+	u64 qns = atomic64_read(&sbi->queue_ns);
+
+	return sprintf(buf,
+		"decompressed_kb: %llu\n"
+		"decompress_ms: %llu\n"
+		"throughput_kbps: %llu\n"
+		"queued: %llu\n"
+		"queue_avg_us: %llu\n"
+		"queue_max_us: %llu\n"
+		"queue_ewma_us: %llu\n"
+		"fanout: %llu\n"
+		"latency_sync: %llu\n",
+		bytes >> 10, div_u64(ns, NSEC_PER_MSEC),
+		ns ? div64_u64(bytes * (NSEC_PER_SEC >> 10), ns) : 0,
+		qcnt, qcnt ? div64_u64(qns, qcnt * NSEC_PER_USEC) : 0,
+		div_u64(atomic64_read(&sbi->queue_max_ns), NSEC_PER_USEC),
+		div_u64(atomic64_read(&sbi->queue_ewma_ns), NSEC_PER_USEC),
+		atomic64_read(&sbi->fanout_cnt),
+		atomic64_read(&sbi->latency_sync_cnt));
+}
+#endif
+
+static ssize_t erofs_attr_show(struct kobject *kobj,
+			       struct attribute *attr, char *buf)
+{
+	struct erofs_sb_info *sbi = container_of(kobj, struct erofs_sb_info,
+						 s_kobj);
+	struct erofs_attr *a = container_of(attr, struct erofs_attr, attr);
+	unsigned char *ptr = __struct_ptr(sbi, a->struct_type, a->offset);
+
+	switch (a->attr_id) {
+	case attr_pointer_ui:
+		if (!ptr)
+			return 0;
+		return sprintf(buf, "%u\n", *(unsigned int *)ptr);
+	case attr_pointer_bool:
+		if (!ptr)
+			return 0;
+		return sprintf(buf, "%d\n", *(bool *)ptr);
+#ifdef CONFIG_EROFS_FS_ZIP
+	case attr_decomp_stat:
+		return erofs_decomp_stat_show(sbi, buf);
+#endif
+	}
+	return 0;
+}
+
+static ssize_t erofs_attr_store(struct kobject *kobj, struct attribute *attr,
+				const char *buf, size_t len)
+{
+	struct erofs_sb_info *sbi = container_of(kobj, struct erofs_sb_info,
+						 s_kobj);
+	struct erofs_attr *a = container_of(attr, struct erofs_attr, attr);
+	unsigned char *ptr = __struct_ptr(sbi, a->struct_type, a->offset);
+	unsigned long t;
+	int ret;
+
+	switch (a->attr_id) {
+	case attr_pointer_ui:
+		if (!ptr)
+			return 0;
+		ret = kstrtoul(skip_spaces(buf), 0, &t);
+		if (ret)
+			return ret;
+		if (t != (unsigned int)t)
+			return -ERANGE;
+		*(unsigned int *)ptr = t;
+		return len;
+	case attr_pointer_bool:
+		if (!ptr)
+			return 0;
+		ret = kstrtoul(skip_spaces(buf), 0, &t);
+		if (ret)
+			return ret;
+		if (t != 0 && t != 1)
+			return -EINVAL;
+		*(bool *)ptr = !!t;
+		return len;
+	}
+	return 0;
+}
+
+static void erofs_sb_release(struct kobject *kobj)
+{
+	struct erofs_sb_info *sbi = container_of(kobj, struct erofs_sb_info,
+						 s_kobj);
+	complete(&sbi->s_kobj_unregister);
+}
+
+static const struct sysfs_ops erofs_attr_ops = {
+	.show	= erofs_attr_show,
+	.store	= erofs_attr_store,
+};
+
+static struct kobj_type erofs_sb_ktype = {
+	.default_attrs	= erofs_attrs,
+	.sysfs_ops	= &erofs_attr_ops,
+	.release	= erofs_sb_release,
+};
+
+static struct kobj_type erofs_ktype = {
+	.sysfs_ops	= &erofs_attr_ops,
+};
+
+static struct kset erofs_root = {
+	.kobj	= {.ktype = &erofs_ktype},
+};
+
+int erofs_register_sysfs(struct super_block *sb)
+{
+	struct erofs_sb_info *sbi = EROFS_SB(sb);
+	int err;
+
+	sbi->s_kobj.kset = &erofs_root;
+	init_completion(&sbi->s_kobj_unregister);
+	err = kobject_init_and_add(&sbi->s_kobj, &erofs_sb_ktype, NULL,
+				   "%s", sb->s_id);
+	if (err)
+		goto put_sb_kobj;
+	return 0;
+
+put_sb_kobj:
+	kobject_put(&sbi->s_kobj);
+	wait_for_completion(&sbi->s_kobj_unregister);
+	return err;
+}
+
+void erofs_unregister_sysfs(struct super_block *sb)
+{
+	struct erofs_sb_info *sbi = EROFS_SB(sb);
+
+	/* fill_super may have failed before the kobject was added */
+	if (!sbi->s_kobj.state_in_sysfs)
+		return;
+
+	kobject_del(&sbi->s_kobj);
+	kobject_put(&sbi->s_kobj);
+	wait_for_completion(&sbi->s_kobj_unregister);
+}
+
+int __init erofs_init_sysfs(void)
+{
+	int ret;
+
+	kobject_set_name(&erofs_root.kobj, "erofs");
+	erofs_root.kobj.parent = fs_kobj;
+	ret = kset_register(&erofs_root);
+	if (ret)
+		kset_unregister(&erofs_root);
+	return ret;
+}
+
+void erofs_exit_sysfs(void)
+{
+	kset_unregister(&erofs_root);
+}
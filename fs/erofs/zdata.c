@@ -7,7 +7,11 @@
 #include "compress.h"
 #include <linux/prefetch.h>
 #include <linux/cpuhotplug.h>
+#include <linux/sched/rt.h>
 #include <trace/events/erofs.h>
+#ifdef OPLUS_FEATURE_SCHED_ASSIST
+#include <linux/sched_assist/sched_assist_common.h>
+#endif
 
 /*
  * since pclustersize is variable for big pcluster feature, introduce slab
@@ -903,6 +907,38 @@ static void z_erofs_decompressqueue_kthread_work(struct kthread_work *work)
 	z_erofs_decompressqueue_work((struct work_struct *)work);
 }
 #endif
+
+static void z_erofs_decompressqueue_init_work(struct z_erofs_decompressqueue *q)
+{
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	kthread_init_work(&q->u.kthread_work,
+			  z_erofs_decompressqueue_kthread_work);
+#else
+	INIT_WORK(&q->u.work, z_erofs_decompressqueue_work);
+#endif
+}
+
+/* queue @io to the worker of @cpu, or to the unbound workqueue */
+static void z_erofs_schedule_decompress(struct z_erofs_decompressqueue *io,
+					int cpu)
+{
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	struct kthread_worker *worker;
+
+	rcu_read_lock();
+	worker = rcu_dereference(z_erofs_pcpu_workers[cpu]);
+	if (!worker) {
+		INIT_WORK(&io->u.work, z_erofs_decompressqueue_work);
+		queue_work(z_erofs_workqueue, &io->u.work);
+	} else {
+		kthread_queue_work(worker, &io->u.kthread_work);
+	}
+	rcu_read_unlock();
+#else
+	queue_work(z_erofs_workqueue, &io->u.work);
+#endif
+}
+
 static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 				       bool sync, int bios)
 {
@@ -920,25 +956,13 @@ static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 		return;
 	/* Use workqueue and sync decompression for atomic contexts only */
 	if (in_atomic() || irqs_disabled()) {
-#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
-		struct kthread_worker *worker;
-
-		rcu_read_lock();
-		worker = rcu_dereference(
-				z_erofs_pcpu_workers[raw_smp_processor_id()]);
-		if (!worker) {
-			INIT_WORK(&io->u.work, z_erofs_decompressqueue_work);
-			queue_work(z_erofs_workqueue, &io->u.work);
-		} else {
-			kthread_queue_work(worker, &io->u.kthread_work);
-		}
-		rcu_read_unlock();
-#else
-		queue_work(z_erofs_workqueue, &io->u.work);
-#endif
+		io->queued_ns = ktime_get_ns();
+		z_erofs_schedule_decompress(io, raw_smp_processor_id());
 		sbi->readahead_sync_decompress = true;
 		return;
 	}
+	/* never queued, keep it out of the queueing statistics */
+	io->queued_ns = 0;
 	z_erofs_decompressqueue_work(&io->u.work);
 }
 
@@ -1178,7 +1202,9 @@ static int z_erofs_decompress_pcluster(struct super_block *sb,
 static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 				     struct list_head *pagepool)
 {
+	struct erofs_sb_info *const sbi = EROFS_SB(io->sb);
 	z_erofs_next_pcluster_t owned = io->head;
+	u64 start = ktime_get_ns(), bytes = 0;
 
 	while (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
 		struct z_erofs_pcluster *pcl;
@@ -1192,8 +1218,122 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 		pcl = container_of(owned, struct z_erofs_pcluster, next);
 		owned = READ_ONCE(pcl->next);
 
+		bytes += (u64)READ_ONCE(z_erofs_primarycollection(pcl)->nr_pages)
+				<< PAGE_SHIFT;
 		z_erofs_decompress_pcluster(io->sb, pcl, pagepool);
 	}
+
+	if (bytes) {
+		atomic64_add(bytes, &sbi->decomp_bytes);
+		atomic64_add(ktime_get_ns() - start, &sbi->decomp_ns);
+	}
+}
+
+static void z_erofs_account_queue(const struct z_erofs_decompressqueue *io)
+{
+	struct erofs_sb_info *const sbi = EROFS_SB(io->sb);
+	s64 delay;
+
+	if (!io->queued_ns)
+		return;
+
+	delay = ktime_get_ns() - io->queued_ns;
+	if (delay < 0)
+		return;
+
+	atomic64_inc(&sbi->queue_cnt);
+	atomic64_add(delay, &sbi->queue_ns);
+	/* racy, but good enough for a statistic and an estimate */
+	if (delay > atomic64_read(&sbi->queue_max_ns))
+		atomic64_set(&sbi->queue_max_ns, delay);
+	atomic64_set(&sbi->queue_ewma_ns,
+		     (atomic64_read(&sbi->queue_ewma_ns) * 7 + delay) >> 3);
+}
+
+#define Z_EROFS_MAX_FANOUT	8
+
+/* close the chain after its first @n pclusters and return the remainder */
+static z_erofs_next_pcluster_t z_erofs_cut_chain(z_erofs_next_pcluster_t head,
+						 unsigned int n)
+{
+	struct z_erofs_pcluster *pcl;
+	z_erofs_next_pcluster_t next;
+
+	while (1) {
+		pcl = container_of(head, struct z_erofs_pcluster, next);
+		next = READ_ONCE(pcl->next);
+		if (!--n || next == Z_EROFS_PCLUSTER_TAIL_CLOSED)
+			break;
+		head = next;
+	}
+
+	if (next != Z_EROFS_PCLUSTER_TAIL_CLOSED)
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL_CLOSED);
+	return next;
+}
+
+/*
+ * A whole readahead batch usually completes on one cpu, which would then
+ * decompress every pcluster of it in turn.  Keep the first share here and
+ * hand the rest to the workers of idle cpus instead.  Small queues stay
+ * local, where the compressed pages are still cache hot.
+ */
+static void z_erofs_decompress_fanout(struct z_erofs_decompressqueue *io)
+{
+	struct erofs_sb_info *const sbi = EROFS_SB(io->sb);
+	struct z_erofs_decompressqueue *qs[Z_EROFS_MAX_FANOUT - 1];
+	int cpus[Z_EROFS_MAX_FANOUT - 1];
+	z_erofs_next_pcluster_t owned;
+	unsigned int nr = 0, nr_cpus = 0, share, i;
+	int cpu, this_cpu = raw_smp_processor_id();
+
+	if (!READ_ONCE(sbi->decomp_fanout))
+		return;
+
+	for (owned = io->head; owned != Z_EROFS_PCLUSTER_TAIL_CLOSED; ++nr)
+		owned = READ_ONCE(container_of(owned, struct z_erofs_pcluster,
+					       next)->next);
+	if (nr < max(READ_ONCE(sbi->fanout_min_pclusters), 2U))
+		return;
+
+	for_each_online_cpu(cpu) {
+		if (cpu == this_cpu || !available_idle_cpu(cpu))
+			continue;
+		cpus[nr_cpus++] = cpu;
+		if (nr_cpus == ARRAY_SIZE(cpus) || nr_cpus + 1 >= nr)
+			break;
+	}
+
+	/* allocate up front so that a failure never orphans a sub-chain */
+	for (i = 0; i < nr_cpus; ++i) {
+		qs[i] = kvzalloc(sizeof(*qs[i]), GFP_NOIO | __GFP_NOWARN);
+		if (!qs[i])
+			break;
+	}
+	nr_cpus = i;
+	if (!nr_cpus)
+		return;
+
+	share = DIV_ROUND_UP(nr, nr_cpus + 1);
+	owned = z_erofs_cut_chain(io->head, share);
+	for (i = 0; i < nr_cpus; ++i) {
+		struct z_erofs_decompressqueue *q = qs[i];
+
+		if (owned == Z_EROFS_PCLUSTER_TAIL_CLOSED) {
+			kvfree(q);
+			continue;
+		}
+
+		q->sb = io->sb;
+		q->head = owned;
+		q->split = true;
+		owned = z_erofs_cut_chain(owned, share);
+
+		z_erofs_decompressqueue_init_work(q);
+		q->queued_ns = ktime_get_ns();
+		z_erofs_schedule_decompress(q, cpus[i]);
+		atomic64_inc(&sbi->fanout_cnt);
+	}
 }
 
 static void z_erofs_decompressqueue_work(struct work_struct *work)
@@ -1203,6 +1343,9 @@ static void z_erofs_decompressqueue_work(struct work_struct *work)
 	LIST_HEAD(pagepool);
 
 	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL_CLOSED);
+	z_erofs_account_queue(bgq);
+	if (!bgq->split)
+		z_erofs_decompress_fanout(bgq);
 	z_erofs_decompress_queue(bgq, &pagepool);
 
 	put_pages_list(&pagepool);
@@ -1343,12 +1486,7 @@ jobqueue_init(struct super_block *sb,
 			*fg = true;
 			goto fg_out;
 		}
-#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
-		kthread_init_work(&q->u.kthread_work,
-				  z_erofs_decompressqueue_kthread_work);
-#else
-		INIT_WORK(&q->u.work, z_erofs_decompressqueue_work);
-#endif
+		z_erofs_decompressqueue_init_work(q);
 	} else {
 fg_out:
 		q = fgq;
@@ -1546,6 +1684,26 @@ static int z_erofs_readpage(struct file *file, struct page *page)
 	return err;
 }
 
+/*
+ * Faults on mmapped libraries stall the faulting task until a worker gets
+ * to run.  For RT tasks and the UX tasks marked by sched_assist, decompress
+ * in the reader's own context right after the bios complete whenever the
+ * worker queueing delay is expected to be long.
+ */
+static bool z_erofs_latency_sync_decompress(struct erofs_sb_info *sbi)
+{
+	bool latency_sensitive = rt_task(current);
+
+#ifdef OPLUS_FEATURE_SCHED_ASSIST
+	latency_sensitive |= test_task_ux(current);
+#endif
+	if (!latency_sensitive)
+		return false;
+
+	return atomic64_read(&sbi->queue_ewma_ns) >=
+		(u64)READ_ONCE(sbi->sync_queue_thresh_us) * NSEC_PER_USEC;
+}
+
 static int z_erofs_readpages(struct file *filp, struct address_space *mapping,
 			     struct list_head *pages, unsigned int nr_pages)
 {
@@ -1554,6 +1712,7 @@ static int z_erofs_readpages(struct file *filp, struct address_space *mapping,
 
 	bool sync = (sbi->readahead_sync_decompress &&
 			nr_pages <= sbi->max_sync_decompress_pages);
+	bool latency_sync = !sync && z_erofs_latency_sync_decompress(sbi);
 	struct z_erofs_decompress_frontend f = DECOMPRESS_FRONTEND_INIT(inode);
 	gfp_t gfp = mapping_gfp_constraint(mapping, GFP_KERNEL);
 	struct page *head = NULL;
@@ -1564,6 +1723,7 @@ static int z_erofs_readpages(struct file *filp, struct address_space *mapping,
 
 	f.headoffset = (erofs_off_t)lru_to_page(pages)->index << PAGE_SHIFT;
 
+	sync |= latency_sync;
 	for (; nr_pages; --nr_pages) {
 		struct page *page = lru_to_page(pages);
 
@@ -1603,6 +1763,8 @@ static int z_erofs_readpages(struct file *filp, struct address_space *mapping,
 
 	(void)z_erofs_collector_end(&f.clt);
 
+	if (sync && latency_sync)
+		atomic64_inc(&sbi->latency_sync_cnt);
 	z_erofs_runqueue(inode->i_sb, &f.clt, &pagepool, sync);
 
 	if (f.map.mpage)
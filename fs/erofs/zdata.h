@@ -89,6 +89,11 @@ struct z_erofs_decompressqueue {
 	atomic_t pending_bios;
 	z_erofs_next_pcluster_t head;
 
+	/* when the queue was handed over to a worker */
+	u64 queued_ns;
+	/* a share of a fanned-out queue, never split again */
+	bool split;
+
 	union {
 		struct completion done;
 		struct work_struct work;
@@ -237,6 +237,11 @@ enum {
 #define DEF_DISCARD_BALANCE_TIME	8000	/* 8000 ms */
 #define DEF_URGENT_DISCARD_ISSUE_TIME	50	/* 50 ms, if force */
 #define DEF_DISCARD_EMPTY_ISSUE_TIME	600000	/* 10 min, undiscard block=0 */
+#define DEF_DISCARD_PLAN_BUDGET_MS	20	/* latency budget per round */
+#define DEF_DISCARD_PLAN_IDLE_MS	200	/* quiet time before issuing */
+#define DEF_DISCARD_PLAN_BACKLOG	65536	/* 256MB, issue unaligned too */
+#define DEF_DISCARD_NS_PER_BLK		1000	/* initial discard cost */
+#define NR_DISCARD_LAT_BUCKETS		16	/* log2(us), last one >= 16ms */
 /*
  * 2019/08/12, set default idle interval to 1s
  */
@@ -252,6 +257,12 @@ enum {
 #define DEF_DISABLE_INTERVAL		5	/* 5 secs */
 #define DEF_DISABLE_QUICK_INTERVAL	1	/* 1 secs */
 #define DEF_UMOUNT_DISCARD_TIMEOUT	5	/* 5 secs */
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+#define DEF_HC_LEARN_HOT_MS		30000	/* rewritten every writeback */
+#define DEF_HC_LEARN_COLD_MS		3600000	/* rewritten less than hourly */
+#define HC_LEARN_MERGE_MS		100	/* one flush of many pages */
+#define IDLE_GAP_MIN_MS			50	/* shorter gaps are one burst */
+#endif
 
 struct cp_control {
 	int reason;
@@ -358,7 +369,7 @@ struct discard_cmd {
 	int error;			/* bio error */
 	spinlock_t lock;		/* for state/bio_ref updating */
 	unsigned short bio_ref;		/* bio reference count */
-#ifdef CONFIG_F2FS_BD_STAT
+#if defined(CONFIG_F2FS_BD_STAT) || defined(CONFIG_OPLUS_FEATURE_OF2FS)
 	u64 discard_time;
 #endif
 };
@@ -417,6 +428,18 @@ struct discard_cmd_control {
 	atomic_t discard_cmd_cnt;		/* # of cached cmd count */
 	struct rb_root_cached root;		/* root of discard rb-tree */
 	bool rbtree_check;			/* config for consistence check */
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	/* erase unit aligned planner for background discard */
+	unsigned int plan_enable;
+	unsigned int erase_unit;		/* in blocks of the device */
+	unsigned int plan_budget_ms;		/* latency budget per round */
+	unsigned int plan_idle_ms;		/* quiet time before a round */
+	unsigned int plan_backlog;		/* pending blocks to issue all */
+	unsigned int ns_per_blk;		/* averaged discard cost */
+	unsigned long aligned_blks;		/* blocks issued in whole units */
+	unsigned long unaligned_blks;		/* blocks issued under backlog */
+	unsigned long lat_hist[NR_DISCARD_LAT_BUCKETS];
+#endif
 };
 
 /* for the list of fsync inodes, used only during recovery */
@@ -885,6 +908,8 @@ struct f2fs_inode_info {
 	struct timespec64 i_disk_time[4];/* inode disk times */
 #ifdef CONFIG_OPLUS_FEATURE_OF2FS
 	unsigned int skip_count;
+	unsigned long i_last_rewrite;	/* jiffies of last rewrite flush */
+	unsigned long i_rewrite_intv;	/* averaged rewrite interval, jiffies */
 #endif
 
 	/* for file compress */
@@ -1276,6 +1301,9 @@ struct f2fs_io_info {
 	struct bio **bio;		/* bio for ipu */
 	sector_t *last_block;		/* last block number in bio */
 	unsigned char version;		/* version of the node */
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	bool hc_learned;		/* temperature picked by hc learner */
+#endif
 };
 
 struct bio_entry {
@@ -1723,6 +1751,12 @@ struct f2fs_sb_info {
 	bool dc_opt_enable;
 	int dpolicy_expect;
 	bool fsync_protect;
+	/* hot/cold learner for data placement */
+	unsigned int hc_learn_enable;
+	unsigned int hc_learn_hot_ms;		/* rewrite interval of hot data */
+	unsigned int hc_learn_cold_ms;		/* rewrite interval of cold data */
+	/* idle gap prediction for background GC */
+	unsigned long idle_gap_avg;		/* averaged idle gap in jiffies */
 #endif
 
 	struct kmem_cache *inline_xattr_slab;	/* inline xattr entry */
@@ -1789,6 +1823,16 @@ static inline void f2fs_update_time(struct f2fs_sb_info *sbi, int type)
 {
 	unsigned long now = jiffies;
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	/* learn how long the device usually stays quiet between bursts */
+	if (type == REQ_TIME) {
+		unsigned long gap = now - sbi->last_time[REQ_TIME];
+
+		if (gap >= msecs_to_jiffies(IDLE_GAP_MIN_MS))
+			WRITE_ONCE(sbi->idle_gap_avg,
+				(sbi->idle_gap_avg * 7 + gap) >> 3);
+	}
+#endif
 	sbi->last_time[type] = now;
 
 	/* DISCARD_TIME and GC_TIME are based on REQ_TIME */
@@ -2608,6 +2652,35 @@ static inline bool is_idle(struct f2fs_sb_info *sbi, int type)
 	return f2fs_time_over(sbi, type);
 }
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+static inline bool f2fs_io_inflight(struct f2fs_sb_info *sbi)
+{
+	return get_pages(sbi, F2FS_RD_DATA) || get_pages(sbi, F2FS_RD_NODE) ||
+		get_pages(sbi, F2FS_RD_META) || get_pages(sbi, F2FS_WB_DATA) ||
+		get_pages(sbi, F2FS_WB_CP_DATA) ||
+		get_pages(sbi, F2FS_DIO_READ) ||
+		get_pages(sbi, F2FS_DIO_WRITE);
+}
+
+/*
+ * Predict how much longer the device stays idle, 0 while it is busy or has
+ * been quiet for less than min_idle_ms. The rest of the average gap is
+ * expected first; once the gap outlives the average, the time already idle
+ * is, since long idle periods tend to last.
+ */
+static inline unsigned int f2fs_idle_window_ms(struct f2fs_sb_info *sbi,
+						unsigned int min_idle_ms)
+{
+	unsigned long idle = jiffies - READ_ONCE(sbi->last_time[REQ_TIME]);
+	unsigned long avg = READ_ONCE(sbi->idle_gap_avg);
+
+	if (f2fs_io_inflight(sbi) || idle < msecs_to_jiffies(min_idle_ms))
+		return 0;
+
+	return jiffies_to_msecs(avg > idle ? max(avg - idle, idle) : idle);
+}
+#endif
+
 static inline void f2fs_radix_tree_insert(struct radix_tree_root *root,
 				unsigned long index, void *item)
 {
@@ -119,12 +119,19 @@ static inline bool is_gc_lifetime(struct f2fs_sb_info *sbi)
 	return written_block_count(sbi) / 90 > sbi->user_block_count / 100;
 }
 
+/* idle predicting GC owns the thread until free space gets close to FG_GC */
+static inline bool of2fs_gc_sched_on(struct f2fs_sb_info *sbi)
+{
+	return sbi->gc_thread->sched_enable &&
+		!has_not_enough_free_secs(sbi, 0, reserved_sections(sbi));
+}
+
 static inline void of2fs_tune_wait_ms(struct f2fs_sb_info *sbi, unsigned int *wait_ms)
 {
 	unsigned int min_wait_ms;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
-	if (sbi->gc_mode == GC_URGENT) {
-		// do nothing in GC_URGENT mode
+	if (sbi->gc_mode == GC_URGENT || of2fs_gc_sched_on(sbi)) {
+		// do nothing in GC_URGENT mode or under the idle scheduler
 		return ;
 	} else if (is_gc_frag(sbi)) {
 		*wait_ms = DEF_GC_FRAG_MIN_SLEEP_TIME;
@@ -181,6 +188,76 @@ static inline bool of2fs_gc_wait(struct f2fs_sb_info *sbi, wait_queue_head_t *wq
 
 	return false;
 }
+
+/*
+ * Idle predicting background GC.
+ *
+ * Once nothing has been issued for sched_idle_ms, victims are collected one
+ * at a time while the averaged cost of a victim still fits in the predicted
+ * idle window and no new request came in. Close to the FG_GC threshold the
+ * prediction is bypassed and the regular policy runs instead.
+ */
+static bool of2fs_gc_sched(struct f2fs_sb_info *sbi, unsigned int *wait_ms)
+{
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
+	unsigned long start, deadline;
+	unsigned int window, i;
+	bool sync_mode;
+	ktime_t begin;
+	u64 cost;
+
+	if (!of2fs_gc_sched_on(sbi))
+		return false;
+
+	if (!has_enough_invalid_blocks(sbi)) {
+		increase_sleep_time(gc_th, wait_ms);
+		stat_other_skip_bggc_count(sbi);
+		return true;
+	}
+
+	window = f2fs_idle_window_ms(sbi, gc_th->sched_idle_ms);
+	if ((u64)window * USEC_PER_MSEC < gc_th->slice_avg_us) {
+		/* come back when the burst is over or the window has grown */
+		*wait_ms = max(gc_th->sched_idle_ms,
+				gc_th->slice_avg_us / USEC_PER_MSEC);
+		stat_io_skip_bggc_count(sbi);
+		return true;
+	}
+
+	sync_mode = F2FS_OPTION(sbi).bggc_mode == BGGC_MODE_SYNC;
+	start = READ_ONCE(sbi->last_time[REQ_TIME]);
+	deadline = jiffies + msecs_to_jiffies(window);
+	*wait_ms = gc_th->sched_idle_ms;
+
+	for (i = 0; i < gc_th->sched_max_slices; i++) {
+		if (!down_write_trylock(&sbi->gc_lock))
+			break;
+
+		stat_inc_bggc_count(sbi->stat_info);
+		begin = ktime_get();
+		/* f2fs_gc() releases gc_lock */
+		if (f2fs_gc(sbi, sync_mode, true, NULL_SEGNO)) {
+			*wait_ms = gc_th->no_gc_sleep_time;
+			break;
+		}
+		cost = ktime_us_delta(ktime_get(), begin);
+		gc_th->slice_avg_us = (gc_th->slice_avg_us * 3 + cost) >> 2;
+
+		if (READ_ONCE(sbi->last_time[REQ_TIME]) != start ||
+			f2fs_io_inflight(sbi) ||
+			time_after(jiffies +
+				usecs_to_jiffies(gc_th->slice_avg_us), deadline) ||
+			!has_enough_invalid_blocks(sbi))
+			break;
+	}
+
+	trace_f2fs_background_gc(sbi->sb, *wait_ms,
+			prefree_segments(sbi), free_segments(sbi));
+
+	/* balancing f2fs's metadata periodically */
+	f2fs_balance_fs_bg(sbi, true);
+	return true;
+}
 #endif
 
 static int gc_thread_func(void *data)
@@ -254,6 +331,10 @@ static int gc_thread_func(void *data)
 			down_write(&sbi->gc_lock);
 			goto do_gc;
 		}
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+		if (of2fs_gc_sched(sbi, &wait_ms))
+			goto next;
+#endif
 
 		if (!down_write_trylock(&sbi->gc_lock)) {
 			stat_other_skip_bggc_count(sbi);
@@ -319,6 +400,11 @@ int f2fs_start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->dirty_rate_threshold = DEF_GC_THREAD_DIRTY_RATE_THRESHOLD;
 	gc_th->dirty_count_threshold = DEF_GC_THREAD_DIRTY_COUNT_THRESHOLD;
 	gc_th->age_weight = DEF_GC_THREAD_AGE_WEIGHT;
+
+	gc_th->sched_enable = 1;
+	gc_th->sched_idle_ms = DEF_GC_SCHED_IDLE_MS;
+	gc_th->sched_max_slices = DEF_GC_SCHED_MAX_SLICES;
+	gc_th->slice_avg_us = DEF_GC_SCHED_SLICE_US;
 #endif
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
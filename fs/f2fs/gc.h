@@ -22,6 +22,10 @@
 #define DEF_GC_THREAD_DIRTY_COUNT_THRESHOLD	10	/* select at least 10 dirty section */
 #define DEF_GC_THREAD_AGE_WEIGHT	60	/* age weight */
 #define DEFAULT_ACCURACY_CLASS		10000
+#define DEF_GC_SCHED_IDLE_MS		500	/* quiet time before a window */
+#define MIN_GC_SCHED_IDLE_MS		100	/* also the shortest retry sleep */
+#define DEF_GC_SCHED_MAX_SLICES		16	/* victims per idle window */
+#define DEF_GC_SCHED_SLICE_US		20000	/* initial cost of one victim */
 #endif
 
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
@@ -58,6 +62,12 @@ struct f2fs_gc_kthread {
 	unsigned int dirty_rate_threshold;
 	unsigned long long age_threshold;
 	unsigned int age_weight;
+
+	/* for idle predicting BG GC */
+	unsigned int sched_enable;
+	unsigned int sched_idle_ms;	/* quiet time before a window opens */
+	unsigned int sched_max_slices;	/* upper bound of victims per window */
+	unsigned int slice_avg_us;	/* averaged cost of one BG GC victim */
 #endif
 };
 
@@ -74,6 +74,9 @@ struct f2fs_bigdata_info {
 	unsigned long hotcold_count[NR_HOTCOLD_TYPE];
 	unsigned long hotcold_gc_segments[NR_CURSEG];
 	unsigned long hotcold_gc_blocks[NR_CURSEG];
+
+	/* Data writes placed by the hot/cold learner, by CURSEG_*_DATA */
+	unsigned long hc_learn_count[3];
 };
 
 static inline struct f2fs_bigdata_info *F2FS_BD_STAT(struct f2fs_sb_info *sbi)
@@ -370,12 +370,76 @@ static ssize_t of2fs_hotcold_info_write(struct file *file,
 	return length;
 }
 
+/* valid blocks moved per reclaimed data segment, scaled by 100 */
+static unsigned int of2fs_gc_wa(struct f2fs_bigdata_info *bd, int gc_type)
+{
+	if (!bd->gc_data_segments[gc_type])
+		return 0;
+	return div_u64((u64)bd->gc_data_blocks[gc_type] * 100,
+		       bd->gc_data_segments[gc_type]);
+}
+
+static int of2fs_hc_learn_info_show(struct seq_file *seq, void *p)
+{
+	struct super_block *sb = seq->private;
+	struct f2fs_sb_info *sbi = F2FS_SB(sb);
+	struct f2fs_bigdata_info *bd = F2FS_BD_STAT(sbi);
+
+	bd_lock(sbi);
+	/*
+	 * each colum indicates: enable, hot_ms, cold_ms, learn_hot_data_cnt,
+	 * learn_warm_data_cnt, learn_cold_data_cnt, bggc_moved_per_seg*100,
+	 * fggc_moved_per_seg*100
+	 *
+	 * the GC columns follow gc_info, so clear gc_info when switching the
+	 * learner to compare write amplification before and after.
+	 */
+	seq_printf(seq, "%u %u %u %lu %lu %lu %u %u\n",
+		   sbi->hc_learn_enable, sbi->hc_learn_hot_ms,
+		   sbi->hc_learn_cold_ms,
+		   bd->hc_learn_count[CURSEG_HOT_DATA],
+		   bd->hc_learn_count[CURSEG_WARM_DATA],
+		   bd->hc_learn_count[CURSEG_COLD_DATA],
+		   of2fs_gc_wa(bd, BG_GC), of2fs_gc_wa(bd, FG_GC));
+	bd_unlock(sbi);
+	return 0;
+}
+
+static ssize_t of2fs_hc_learn_info_write(struct file *file,
+					   const char __user *buf,
+					   size_t length, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct super_block *sb = seq->private;
+	struct f2fs_sb_info *sbi = F2FS_SB(sb);
+	struct f2fs_bigdata_info *bd = F2FS_BD_STAT(sbi);
+	char buffer[3] = {0};
+	int i;
+
+	if (!buf || length > 2 || length <= 0)
+		return -EINVAL;
+
+	if (copy_from_user(&buffer, buf, length))
+		return -EFAULT;
+
+	if (buffer[0] != '0')
+		return -EINVAL;
+
+	bd_lock(sbi);
+	for (i = 0; i < ARRAY_SIZE(bd->hc_learn_count); i++)
+		bd->hc_learn_count[i] = 0;
+	bd_unlock(sbi);
+
+	return length;
+}
+
 OF2FS_PROC_DEF(base_info);
 OF2FS_PROC_DEF(discard_info);
 OF2FS_PROC_DEF(gc_info);
 OF2FS_PROC_DEF(cp_info);
 OF2FS_PROC_DEF(fsync_info);
 OF2FS_PROC_DEF(hotcold_info);
+OF2FS_PROC_DEF(hc_learn_info);
 
 void f2fs_build_bd_stat(struct f2fs_sb_info *sbi)
 {
@@ -393,6 +457,8 @@ void f2fs_build_bd_stat(struct f2fs_sb_info *sbi)
 				&of2fs_fsync_info_fops, sb);
 	proc_create_data("hotcold_info", S_IRUGO | S_IWUGO, sbi->s_proc,
 				&of2fs_hotcold_info_fops, sb);
+	proc_create_data("hc_learn_info", S_IRUGO | S_IWUGO, sbi->s_proc,
+				&of2fs_hc_learn_info_fops, sb);
 }
 
 void f2fs_destroy_bd_stat(struct f2fs_sb_info *sbi)
@@ -1162,7 +1162,7 @@ static struct discard_cmd *__create_discard_cmd(struct f2fs_sb_info *sbi,
 	dc->state = D_PREP;
 	dc->queued = 0;
 	dc->error = 0;
-#ifdef CONFIG_F2FS_BD_STAT
+#if defined(CONFIG_F2FS_BD_STAT) || defined(CONFIG_OPLUS_FEATURE_OF2FS)
 	dc->discard_time = 0;
 #endif
 	init_completion(&dc->wait);
@@ -1232,6 +1232,17 @@ static void __remove_discard_cmd(struct f2fs_sb_info *sbi,
 		bd_max_val(sbi, max_discard_time, dc->discard_time);
 		bd_unlock(sbi);
 	}
+#endif
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	/* cmd_lock is held by all callers */
+	if (dc->state == D_DONE && !dc->error && dc->discard_time && dc->len) {
+		u64 us = div_u64(dc->discard_time, NSEC_PER_USEC);
+		u32 ns = div_u64(dc->discard_time, dc->len);
+
+		dcc->lat_hist[min_t(unsigned int, fls64(us),
+				NR_DISCARD_LAT_BUCKETS - 1)]++;
+		dcc->ns_per_blk = (dcc->ns_per_blk * 7 + ns) >> 3;
+	}
 #endif
 	if (dc->error == -EOPNOTSUPP)
 		dc->error = 0;
@@ -1255,7 +1266,7 @@ static void f2fs_submit_discard_endio(struct bio *bio)
 	dc->bio_ref--;
 	if (!dc->bio_ref && dc->state == D_SUBMIT) {
 		dc->state = D_DONE;
-#ifdef CONFIG_F2FS_BD_STAT
+#if defined(CONFIG_F2FS_BD_STAT) || defined(CONFIG_OPLUS_FEATURE_OF2FS)
 		if (dc->discard_time) {
 			u64 discard_end_time = (u64)ktime_get();
 			if (discard_end_time > dc->discard_time)
@@ -1442,7 +1453,7 @@ static int __submit_discard_cmd(struct f2fs_sb_info *sbi,
 		 * right away
 		 */
 		spin_lock_irqsave(&dc->lock, flags);
-#ifdef CONFIG_F2FS_BD_STAT
+#if defined(CONFIG_F2FS_BD_STAT) || defined(CONFIG_OPLUS_FEATURE_OF2FS)
 		if (dc->state == D_PREP)
 			dc->discard_time = (u64)ktime_get();
 #endif
@@ -1811,6 +1822,144 @@ static int __issue_discard_cmd(struct f2fs_sb_info *sbi,
 	return issued;
 }
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+/*
+ * Erase unit aligned background discard.
+ *
+ * Commands covering at least one whole erase unit are trimmed to the units
+ * they cover and issued in LBA order; the unaligned head and tail stay
+ * pending so they can merge with neighbours freed later. Leftovers smaller
+ * than a unit are only issued once the backlog passes plan_backlog or the
+ * device is nearly full. A round runs only inside a predicted idle window,
+ * unless it is draining, and stops when the averaged cost of what was issued
+ * reaches the latency budget, or, for io_aware policies, as soon as new I/O
+ * shows up.
+ */
+static block_t __aligned_discard_len(struct discard_cmd *dc,
+					unsigned int unit)
+{
+	block_t head = (unit - dc->start % unit) % unit;
+
+	if (dc->len < head + unit)
+		return 0;
+	return rounddown(dc->len - head, unit);
+}
+
+/* Trim dc to the erase units it covers, requeueing head and tail */
+static void __align_discard_cmd(struct f2fs_sb_info *sbi,
+				struct discard_cmd *dc, unsigned int unit)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_info di = dc->di;
+	block_t head, body, tail;
+
+	head = (unit - di.start % unit) % unit;
+	body = rounddown(di.len - head, unit);
+	tail = di.len - head - body;
+	if (!head && !tail)
+		return;
+
+	dcc->undiscard_blks -= di.len;
+	dc->lstart += head;
+	dc->start += head;
+	dc->len = body;
+	dcc->undiscard_blks += body;
+	__relocate_discard_cmd(dcc, dc);
+
+	if (head)
+		__insert_discard_tree(sbi, dc->bdev, di.lstart, di.start,
+							head, NULL, NULL);
+	if (tail)
+		__insert_discard_tree(sbi, dc->bdev, di.lstart + head + body,
+					di.start + head + body, tail, NULL, NULL);
+}
+
+static int __issue_discard_cmd_planned(struct f2fs_sb_info *sbi,
+					struct discard_policy *dpolicy)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc;
+	struct rb_node *node;
+	struct blk_plug plug;
+	unsigned int window = dcc->plan_budget_ms, issued = 0;
+	u64 budget, cost = 0;
+	bool drain, io_interrupted = false;
+
+	drain = dcc->undiscard_blks > dcc->plan_backlog ||
+			utilization(sbi) > DEF_DISCARD_URGENT_UTIL;
+	if (!drain) {
+		window = f2fs_idle_window_ms(sbi, dcc->plan_idle_ms);
+		if (!window) {
+			dpolicy->io_busy = true;
+			return -1;
+		}
+	}
+	budget = (u64)min(window, dcc->plan_budget_ms) * NSEC_PER_MSEC;
+
+	mutex_lock(&dcc->cmd_lock);
+	blk_start_plug(&plug);
+
+	node = rb_first_cached(&dcc->root);
+	while (node) {
+		bool aligned;
+		block_t len;
+		int err;
+
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (dc->state != D_PREP || dc->len < dpolicy->granularity)
+			goto next;
+
+		len = __aligned_discard_len(dc, dcc->erase_unit);
+		aligned = len;
+		if (!aligned) {
+			if (!drain)
+				goto next;
+			len = dc->len;
+		}
+
+		if (cost && cost + (u64)len * dcc->ns_per_blk > budget)
+			break;
+
+		if (dpolicy->io_aware &&
+			plist_idx(dc->len) < dpolicy->io_aware_gran &&
+			(f2fs_io_inflight(sbi) ||
+			time_before(jiffies, sbi->last_time[REQ_TIME] +
+				msecs_to_jiffies(dcc->plan_idle_ms)))) {
+			dpolicy->io_busy = true;
+			io_interrupted = true;
+			break;
+		}
+
+		/* only split once the command is known to be issued */
+		if (aligned)
+			__align_discard_cmd(sbi, dc, dcc->erase_unit);
+
+		err = __submit_discard_cmd(sbi, dpolicy, dc, &issued);
+		cost += (u64)len * dcc->ns_per_blk;
+		if (aligned)
+			dcc->aligned_blks += len;
+		else
+			dcc->unaligned_blks += len;
+
+		node = rb_next(&dc->rb_node);
+		if (err)
+			__remove_discard_cmd(sbi, dc);
+		if (issued >= dpolicy->max_requests)
+			break;
+		continue;
+next:
+		node = rb_next(&dc->rb_node);
+	}
+
+	blk_finish_plug(&plug);
+	mutex_unlock(&dcc->cmd_lock);
+
+	if (!issued && io_interrupted)
+		return -1;
+	return issued;
+}
+#endif
+
 static bool __drop_discard_cmd(struct f2fs_sb_info *sbi)
 {
 	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
@@ -2106,6 +2255,11 @@ static int issue_discard_thread(void *data)
 #endif
 		sb_start_intwrite(sbi->sb);
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+		if (dpolicy.type == DPOLICY_BG && dcc->plan_enable)
+			issued = __issue_discard_cmd_planned(sbi, &dpolicy);
+		else
+#endif
 		issued = __issue_discard_cmd(sbi, &dpolicy);
 		if (issued > 0) {
 			__wait_all_discard_cmd(sbi, &dpolicy);
@@ -2127,6 +2281,13 @@ static int issue_discard_thread(void *data)
 		} else {
 			wait_ms = dpolicy.max_interval;
 		}
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+		/* the planner looks for the next idle window by itself */
+		if (dpolicy.type == DPOLICY_BG && dcc->plan_enable &&
+				dpolicy.io_busy)
+			wait_ms = max_t(unsigned int, dcc->plan_idle_ms,
+					DEF_MIN_DISCARD_ISSUE_TIME);
+#endif
 
 		sb_end_intwrite(sbi->sb);
 
@@ -2444,6 +2605,16 @@ static int create_discard_cmd_control(struct f2fs_sb_info *sbi)
 	dcc->next_pos = 0;
 	dcc->root = RB_ROOT_CACHED;
 	dcc->rbtree_check = false;
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	dcc->plan_enable = 1;
+	dcc->erase_unit = max_t(unsigned int, sbi->blocks_per_seg,
+		bdev_get_queue(sbi->sb->s_bdev)->limits.discard_granularity >>
+							F2FS_BLKSIZE_BITS);
+	dcc->plan_budget_ms = DEF_DISCARD_PLAN_BUDGET_MS;
+	dcc->plan_idle_ms = DEF_DISCARD_PLAN_IDLE_MS;
+	dcc->plan_backlog = DEF_DISCARD_PLAN_BACKLOG;
+	dcc->ns_per_blk = DEF_DISCARD_NS_PER_BLK;
+#endif
 
 	init_waitqueue_head(&dcc->discard_wait_queue);
 	SM_I(sbi)->dcc_info = dcc;
@@ -3858,6 +4029,49 @@ static int __get_segment_type_4(struct f2fs_io_info *fio)
 	}
 }
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+/*
+ * Pick the data log from how often the inode is actually rewritten.
+ *
+ * Only overwrites of valid blocks are sampled, and pages flushed together
+ * within HC_LEARN_MERGE_MS count as one rewrite. The interval is averaged
+ * per inode, but a file that has gone quiet since its last rewrite is
+ * judged by the idle time, so it cools down without having to be written.
+ * Returns -1 until the inode has been rewritten twice.
+ */
+static int __get_segment_type_learn(struct f2fs_io_info *fio,
+						struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = fio->sbi;
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	unsigned long now = jiffies;
+	unsigned long last = READ_ONCE(fi->i_last_rewrite);
+	unsigned long intv = READ_ONCE(fi->i_rewrite_intv);
+
+	if (__is_valid_data_blkaddr(fio->old_blkaddr) &&
+		(!last || time_after(now, last +
+				msecs_to_jiffies(HC_LEARN_MERGE_MS)))) {
+		if (last)
+			intv = intv ? (intv * 3 + (now - last)) >> 2 :
+					now - last;
+		WRITE_ONCE(fi->i_rewrite_intv, intv);
+		WRITE_ONCE(fi->i_last_rewrite, now);
+		last = now;
+	}
+
+	if (!intv)
+		return -1;
+
+	intv = max(intv, now - last);
+	fio->hc_learned = true;
+	if (intv <= msecs_to_jiffies(sbi->hc_learn_hot_ms))
+		return CURSEG_HOT_DATA;
+	if (intv >= msecs_to_jiffies(sbi->hc_learn_cold_ms))
+		return CURSEG_COLD_DATA;
+	return CURSEG_WARM_DATA;
+}
+#endif
+
 static int __get_segment_type_6(struct f2fs_io_info *fio)
 {
 	if (fio->type == DATA) {
@@ -3884,6 +4098,15 @@ static int __get_segment_type_6(struct f2fs_io_info *fio)
 				f2fs_is_atomic_file(inode) ||
 				f2fs_is_volatile_file(inode))
 			return CURSEG_HOT_DATA;
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+		if (fio->sbi->hc_learn_enable &&
+				inode->i_write_hint == WRITE_LIFE_NOT_SET) {
+			int type = __get_segment_type_learn(fio, inode);
+
+			if (type >= 0)
+				return type;
+		}
+#endif
 		return f2fs_rw_hint_to_seg_type(inode->i_write_hint);
 	} else {
 		if (IS_DNODE(fio->page))
@@ -4005,6 +4228,10 @@ void f2fs_allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 		bd_inc_val(sbi, curr_node_alloc_count, 1);
 	}
 	bd_inc_array_val(sbi, hotcold_count, type + 1, 1UL);
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	if (fio && fio->hc_learned && type <= CURSEG_COLD_DATA)
+		bd_inc_array_val(sbi, hc_learn_count, type, 1UL);
+#endif
 	bd_unlock(sbi);
 #endif
 	/*
@@ -3645,6 +3645,9 @@ static int f2fs_fill_super(struct super_block *sb, void *data, int silent)
 	sbi->dc_opt_enable = true;
 	sbi->dpolicy_expect = DPOLICY_BG;
 	sbi->fsync_protect = false;
+	sbi->hc_learn_enable = 0;	/* opt in through sysfs */
+	sbi->hc_learn_hot_ms = DEF_HC_LEARN_HOT_MS;
+	sbi->hc_learn_cold_ms = DEF_HC_LEARN_COLD_MS;
 #endif
 	/* init iostat info */
 	spin_lock_init(&sbi->iostat_lock);
@@ -201,6 +201,36 @@ static ssize_t mounted_time_sec_show(struct f2fs_attr *a,
 	return sprintf(buf, "%llu", SIT_I(sbi)->mounted_time);
 }
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+/* pending cmds, pending blocks, blocks issued aligned and unaligned */
+static ssize_t discard_backlog_show(struct f2fs_attr *a,
+		struct f2fs_sb_info *sbi, char *buf)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return sprintf(buf, "0 0 0 0\n");
+
+	return sprintf(buf, "%d %u %lu %lu\n",
+			atomic_read(&dcc->discard_cmd_cnt),
+			dcc->undiscard_blks, dcc->aligned_blks,
+			dcc->unaligned_blks);
+}
+
+/* completed discards by latency, bucket i holds [2^(i-1), 2^i) us */
+static ssize_t discard_lat_hist_show(struct f2fs_attr *a,
+		struct f2fs_sb_info *sbi, char *buf)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	int i, len = 0;
+
+	for (i = 0; i < NR_DISCARD_LAT_BUCKETS; i++)
+		len += sprintf(buf + len, "%lu%s", dcc ? dcc->lat_hist[i] : 0,
+				i == NR_DISCARD_LAT_BUCKETS - 1 ? "\n" : " ");
+	return len;
+}
+#endif
+
 #ifdef CONFIG_F2FS_STAT_FS
 static ssize_t moved_blocks_foreground_show(struct f2fs_attr *a,
 				struct f2fs_sb_info *sbi, char *buf)
@@ -350,6 +380,21 @@ static ssize_t __sbi_store(struct f2fs_attr *a,
 		return count;
 	}
 
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	if (!strcmp(a->attr.name, "discard_erase_unit")) {
+		if (t == 0 || t > BLKS_PER_SEC(sbi))
+			return -EINVAL;
+		*ui = t;
+		return count;
+	}
+
+	/* gc thread sleeps this long between idle checks */
+	if (!strcmp(a->attr.name, "gc_sched_idle_ms")) {
+		if (t < MIN_GC_SCHED_IDLE_MS || t > UINT_MAX)
+			return -EINVAL;
+	}
+#endif
+
 	if (!strcmp(a->attr.name, "migration_granularity")) {
 		if (t == 0 || t > sbi->segs_per_sec)
 			return -EINVAL;
@@ -410,6 +455,25 @@ static ssize_t __sbi_store(struct f2fs_attr *a,
 		return count;
 	}
 
+	if (!strcmp(a->attr.name, "hc_learn_enable")) {
+		sbi->hc_learn_enable = !!t;
+		return count;
+	}
+
+	if (!strcmp(a->attr.name, "hc_learn_hot_ms")) {
+		if (!t || t >= sbi->hc_learn_cold_ms)
+			return -EINVAL;
+		sbi->hc_learn_hot_ms = t;
+		return count;
+	}
+
+	if (!strcmp(a->attr.name, "hc_learn_cold_ms")) {
+		if (t <= sbi->hc_learn_hot_ms || t > UINT_MAX)
+			return -EINVAL;
+		sbi->hc_learn_cold_ms = t;
+		return count;
+	}
+
 	if (!strcmp(a->attr.name, "dpolicy_expect")) {
 		if (!sbi->dc_opt_enable)
 			return count;
@@ -568,9 +632,21 @@ F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, main_blkaddr, main_blkaddr);
 #ifdef CONFIG_OPLUS_FEATURE_OF2FS
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_age_threshold, age_threshold);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_dirty_rate_threshold, dirty_rate_threshold);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_sched_enable, sched_enable);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_sched_idle_ms, sched_idle_ms);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_sched_max_slices, sched_max_slices);
+/* averaged by the GC thread after every victim, so only shown */
+F2FS_STAT_ATTR(GC_THREAD, f2fs_gc_kthread, gc_sched_slice_us, slice_avg_us);
 #endif
 F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, max_small_discards, max_discards);
 F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_granularity, discard_granularity);
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_plan_enable, plan_enable);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_erase_unit, erase_unit);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_plan_budget_ms, plan_budget_ms);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_plan_idle_ms, plan_idle_ms);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_plan_backlog, plan_backlog);
+#endif
 F2FS_RW_ATTR(RESERVED_BLOCKS, f2fs_sb_info, reserved_blocks, reserved_blocks);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, batched_trim_sections, trim_sections);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
@@ -605,6 +681,9 @@ F2FS_ATTR_OFFSET(F2FS_SBI, fsync_protect, 0666, f2fs_sbi_show, f2fs_sbi_store,
 		 offsetof(struct f2fs_sb_info, fsync_protect));
 F2FS_ATTR_OFFSET(F2FS_SBI, dpolicy_expect, 0666, f2fs_sbi_show, f2fs_sbi_store,
 		 offsetof(struct f2fs_sb_info, dpolicy_expect));
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, hc_learn_enable, hc_learn_enable);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, hc_learn_hot_ms, hc_learn_hot_ms);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, hc_learn_cold_ms, hc_learn_cold_ms);
 #endif
 #ifdef CONFIG_F2FS_GRADING_SSR
 F2FS_RW_ATTR(F2FS_HOT_COLD_PARAMS, f2fs_hot_cold_params, hc_hot_data_lower_limit, hot_data_lower_limit);
@@ -632,6 +711,10 @@ F2FS_GENERAL_RO_ATTR(current_reserved_blocks);
 F2FS_GENERAL_RO_ATTR(unusable);
 F2FS_GENERAL_RO_ATTR(encoding);
 F2FS_GENERAL_RO_ATTR(mounted_time_sec);
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+F2FS_GENERAL_RO_ATTR(discard_backlog);
+F2FS_GENERAL_RO_ATTR(discard_lat_hist);
+#endif
 #ifdef CONFIG_F2FS_STAT_FS
 F2FS_STAT_ATTR(STAT_INFO, f2fs_stat_info, cp_foreground_calls, cp_count);
 F2FS_STAT_ATTR(STAT_INFO, f2fs_stat_info, cp_background_calls, bg_cp_count);
@@ -680,11 +763,22 @@ static struct attribute *f2fs_attrs[] = {
 #ifdef CONFIG_OPLUS_FEATURE_OF2FS
 	ATTR_LIST(gc_age_threshold),
 	ATTR_LIST(gc_dirty_rate_threshold),
+	ATTR_LIST(gc_sched_enable),
+	ATTR_LIST(gc_sched_idle_ms),
+	ATTR_LIST(gc_sched_max_slices),
+	ATTR_LIST(gc_sched_slice_us),
 #endif
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(main_blkaddr),
 	ATTR_LIST(max_small_discards),
 	ATTR_LIST(discard_granularity),
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	ATTR_LIST(discard_plan_enable),
+	ATTR_LIST(discard_erase_unit),
+	ATTR_LIST(discard_plan_budget_ms),
+	ATTR_LIST(discard_plan_idle_ms),
+	ATTR_LIST(discard_plan_backlog),
+#endif
 	ATTR_LIST(batched_trim_sections),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
@@ -714,6 +808,9 @@ static struct attribute *f2fs_attrs[] = {
 	 */
 	ATTR_LIST(fsync_protect),
 	ATTR_LIST(dpolicy_expect),
+	ATTR_LIST(hc_learn_enable),
+	ATTR_LIST(hc_learn_hot_ms),
+	ATTR_LIST(hc_learn_cold_ms),
 #endif
 #ifdef CONFIG_F2FS_GRADING_SSR
 	ATTR_LIST(hc_hot_data_lower_limit),
@@ -742,6 +839,10 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(current_reserved_blocks),
 	ATTR_LIST(encoding),
 	ATTR_LIST(mounted_time_sec),
+#ifdef CONFIG_OPLUS_FEATURE_OF2FS
+	ATTR_LIST(discard_backlog),
+	ATTR_LIST(discard_lat_hist),
+#endif
 #ifdef CONFIG_F2FS_STAT_FS
 	ATTR_LIST(cp_foreground_calls),
 	ATTR_LIST(cp_background_calls),
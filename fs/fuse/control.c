@@ -170,6 +170,68 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static ssize_t fuse_conn_passthrough_attr_cache_read(struct file *file,
+						     char __user *buf,
+						     size_t len, loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	unsigned val;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	val = READ_ONCE(fc->passthrough_attr_cache);
+	fuse_conn_put(fc);
+
+	return fuse_conn_limit_read(file, buf, len, ppos, val);
+}
+
+static ssize_t fuse_conn_passthrough_attr_cache_write(struct file *file,
+						      const char __user *buf,
+						      size_t count, loff_t *ppos)
+{
+	unsigned val;
+	ssize_t ret;
+
+	ret = fuse_conn_limit_write(file, buf, count, ppos, &val, 1);
+	if (ret > 0 && val > 1)
+		return -EINVAL;
+	if (ret > 0) {
+		struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+		if (fc) {
+			WRITE_ONCE(fc->passthrough_attr_cache, val);
+			fuse_conn_put(fc);
+		}
+	}
+
+	return ret;
+}
+
+static ssize_t fuse_conn_passthrough_cache_read(struct file *file,
+						char __user *buf, size_t len,
+						loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	char tmp[128];
+	size_t size;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	size = scnprintf(tmp, sizeof(tmp),
+			 "attr_hit %ld\nattr_miss %ld\n"
+			 "lookup_hit %ld\nlookup_miss %ld\n",
+			 atomic_long_read(&fc->pt_attr_hit),
+			 atomic_long_read(&fc->pt_attr_miss),
+			 atomic_long_read(&fc->pt_lookup_hit),
+			 atomic_long_read(&fc->pt_lookup_miss));
+	fuse_conn_put(fc);
+
+	return simple_read_from_buffer(buf, len, ppos, tmp, size);
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -182,6 +244,19 @@ static const struct file_operations fuse_ctl_waiting_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_conn_passthrough_cache_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_passthrough_cache_read,
+	.llseek = no_llseek,
+};
+
+static const struct file_operations fuse_conn_passthrough_attr_cache_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_passthrough_attr_cache_read,
+	.write = fuse_conn_passthrough_attr_cache_write,
+	.llseek = no_llseek,
+};
+
 static const struct file_operations fuse_conn_max_background_ops = {
 	.open = nonseekable_open,
 	.read = fuse_conn_max_background_read,
@@ -264,7 +339,13 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
 				 S_IFREG | 0600, 1, NULL,
-				 &fuse_conn_congestion_threshold_ops))
+				 &fuse_conn_congestion_threshold_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "passthrough_cache",
+				 S_IFREG | 0400, 1, NULL,
+				 &fuse_conn_passthrough_cache_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "passthrough_attr_cache",
+				 S_IFREG | 0600, 1, NULL,
+				 &fuse_conn_passthrough_attr_cache_ops))
 		goto err;
 
 	return 0;
@@ -109,6 +109,7 @@ static u64 entry_attr_timeout(struct fuse_entry_out *o)
 void fuse_invalidate_attr(struct inode *inode)
 {
 	get_fuse_inode(inode)->i_time = 0;
+	clear_bit(FUSE_I_LOWER_VALID, &get_fuse_inode(inode)->state);
 }
 
 /**
@@ -205,12 +206,25 @@ static int fuse_dentry_revalidate(struct dentry *entry, unsigned int flags)
 		if (!inode)
 			goto invalid;
 
+		/*
+		 * Unlink and rename both change the ctime of the lower inode,
+		 * so an unchanged lower ctime means the name still maps to it.
+		 */
+		fc = get_fuse_conn(inode);
+		if (!(flags & LOOKUP_REVAL) &&
+		    READ_ONCE(fc->passthrough_attr_cache) &&
+		    READ_ONCE(get_fuse_inode(inode)->lower_path.dentry)) {
+			if (fuse_passthrough_lower_valid(inode)) {
+				atomic_long_inc(&fc->pt_lookup_hit);
+				goto valid;
+			}
+			atomic_long_inc(&fc->pt_lookup_miss);
+		}
+
 		ret = -ECHILD;
 		if (flags & LOOKUP_RCU)
 			goto out;
 
-		fc = get_fuse_conn(inode);
-
 		forget = fuse_alloc_forget();
 		ret = -ENOMEM;
 		if (!forget)
@@ -259,6 +273,7 @@ static int fuse_dentry_revalidate(struct dentry *entry, unsigned int flags)
 			dput(parent);
 		}
 	}
+valid:
 	ret = 1;
 out:
 	return ret;
@@ -437,6 +452,9 @@ static struct dentry *fuse_lookup(struct inode *dir, struct dentry *entry,
 	else
 		fuse_invalidate_entry_cache(entry);
 
+	if (inode)
+		fuse_passthrough_lookup_lower(dir, &entry->d_name, inode);
+
 	fuse_advise_use_readdirplus(dir);
 	return newent;
 
@@ -1051,6 +1069,20 @@ static int fuse_update_get_attr(struct inode *inode, struct file *file,
 	else
 		sync = time_before64(fi->i_time, get_jiffies_64());
 
+	/* timed out, but the lower inode may vouch for the cached copy */
+	if (sync && !(flags & AT_STATX_FORCE_SYNC) &&
+	    READ_ONCE(get_fuse_conn(inode)->passthrough_attr_cache) &&
+	    READ_ONCE(fi->lower_path.dentry)) {
+		struct fuse_conn *fc = get_fuse_conn(inode);
+
+		if (fuse_passthrough_lower_valid(inode)) {
+			atomic_long_inc(&fc->pt_attr_hit);
+			sync = false;
+		} else {
+			atomic_long_inc(&fc->pt_attr_miss);
+		}
+	}
+
 	if (sync) {
 		forget_all_cached_acls(inode);
 		err = fuse_do_getattr(inode, stat, file);
@@ -1406,6 +1438,7 @@ static int fuse_direntplus_link(struct file *file,
 	if (fc->readdirplus_auto)
 		set_bit(FUSE_I_INIT_RDPLUS, &get_fuse_inode(inode)->state);
 	fuse_change_entry_timeout(dentry, o);
+	fuse_passthrough_lookup_lower(dir, &name, d_inode(dentry));
 
 	dput(dentry);
 	return 0;
@@ -200,6 +200,9 @@ void fuse_finish_open(struct inode *inode, struct file *file)
 
 	if ((file->f_mode & FMODE_WRITE) && fc->writeback_cache)
 		fuse_link_write_file(file);
+
+	if (ff->passthrough.filp)
+		fuse_passthrough_attach_lower(file);
 }
 
 int fuse_open_common(struct inode *inode, struct file *file, bool isdir)
@@ -958,6 +961,17 @@ static ssize_t fuse_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	return generic_file_read_iter(iocb, to);
 }
 
+static ssize_t fuse_file_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	struct fuse_file *ff = in->private_data;
+
+	if (ff->passthrough.filp)
+		return fuse_passthrough_splice_read(in, ppos, pipe, len, flags);
+	return generic_file_splice_read(in, ppos, pipe, len, flags);
+}
+
 static void fuse_write_fill(struct fuse_req *req, struct fuse_file *ff,
 			    loff_t pos, size_t count)
 {
@@ -3078,6 +3092,36 @@ static long fuse_file_fallocate(struct file *file, int mode, loff_t offset,
 	return err;
 }
 
+static ssize_t fuse_file_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags)
+{
+	struct fuse_file *ff = out->private_data;
+
+	if (ff->passthrough.filp)
+		return fuse_passthrough_splice_write(pipe, out, ppos, len,
+						     flags);
+	return iter_file_splice_write(pipe, out, ppos, len, flags);
+}
+
+static ssize_t fuse_copy_file_range(struct file *file_in, loff_t pos_in,
+				    struct file *file_out, loff_t pos_out,
+				    size_t len, unsigned int flags)
+{
+	return fuse_passthrough_copy_file_range(file_in, pos_in, file_out,
+						pos_out, len, flags);
+}
+
+static int fuse_file_fadvise(struct file *file, loff_t offset, loff_t len,
+			     int advice)
+{
+	struct fuse_file *ff = file->private_data;
+
+	if (ff->passthrough.filp)
+		return fuse_passthrough_fadvise(file, offset, len, advice);
+	return generic_fadvise(file, offset, len, advice);
+}
+
 static const struct file_operations fuse_file_operations = {
 	.llseek		= fuse_file_llseek,
 	.read_iter	= fuse_file_read_iter,
@@ -3089,11 +3133,14 @@ static const struct file_operations fuse_file_operations = {
 	.fsync		= fuse_fsync,
 	.lock		= fuse_file_lock,
 	.flock		= fuse_file_flock,
-	.splice_read	= generic_file_splice_read,
+	.splice_read	= fuse_file_splice_read,
+	.splice_write	= fuse_file_splice_write,
 	.unlocked_ioctl	= fuse_file_ioctl,
 	.compat_ioctl	= fuse_file_compat_ioctl,
 	.poll		= fuse_file_poll,
 	.fallocate	= fuse_file_fallocate,
+	.copy_file_range = fuse_copy_file_range,
+	.fadvise	= fuse_file_fadvise,
 };
 
 static const struct file_operations fuse_direct_io_file_operations = {
@@ -38,7 +38,7 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 7
 
 /** Number of page pointers embedded in fuse_req */
 #define FUSE_REQ_INLINE_PAGES 1
@@ -108,6 +108,16 @@ struct fuse_inode {
 
 	/** Lock for serializing lookup and readdir for back compatibility*/
 	struct mutex mutex;
+
+	/** Lower path backing passthrough opens, pinned until eviction */
+	struct path lower_path;
+
+	/** Credentials to look up names below lower_path with */
+	const struct cred *lower_cred;
+
+	/** Lower ctime at the time the cached attributes were last
+	 * confirmed by userspace */
+	struct timespec64 lower_ctime;
 };
 
 /** FUSE inode state bits */
@@ -120,6 +130,8 @@ enum {
 	FUSE_I_SIZE_UNSTABLE,
 	/* Bad inode */
 	FUSE_I_BAD,
+	/** Cached attributes match the lower inode as of lower_ctime */
+	FUSE_I_LOWER_VALID,
 };
 
 struct fuse_conn;
@@ -711,6 +723,16 @@ struct fuse_conn {
 
 	/** Protects passthrough_req */
 	spinlock_t passthrough_req_lock;
+
+	/** Trust cached attributes and entries past their timeout while the
+	    lower inode is unchanged, set through the control filesystem */
+	unsigned int passthrough_attr_cache;
+
+	/** Attribute and lookup requests answered from the lower inode */
+	atomic_long_t pt_attr_hit;
+	atomic_long_t pt_attr_miss;
+	atomic_long_t pt_lookup_hit;
+	atomic_long_t pt_lookup_miss;
 };
 
 static inline struct fuse_conn *get_fuse_conn_super(struct super_block *sb)
@@ -1046,9 +1068,27 @@ int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd);
 int fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
 			   struct fuse_open_out *openarg);
 void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_attach_lower(struct file *file);
+void fuse_passthrough_lookup_lower(struct inode *dir, const struct qstr *name,
+				   struct inode *inode);
+void fuse_passthrough_put_lower(struct inode *inode);
+void fuse_passthrough_update_lower(struct inode *inode,
+				   struct fuse_attr *attr);
+bool fuse_passthrough_lower_valid(struct inode *inode);
 ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
 ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
 ssize_t fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags);
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags);
+ssize_t fuse_passthrough_copy_file_range(struct file *file_in, loff_t pos_in,
+					 struct file *file_out, loff_t pos_out,
+					 size_t len, unsigned int flags);
+int fuse_passthrough_fadvise(struct file *file, loff_t offset, loff_t len,
+			     int advice);
 
 #ifdef CONFIG_OPLUS_FEATURE_ACM
 void acm_fuse_init_cache(void);
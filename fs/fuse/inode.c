@@ -101,6 +101,9 @@ static struct inode *fuse_alloc_inode(struct super_block *sb)
 	INIT_LIST_HEAD(&fi->writepages);
 	init_waitqueue_head(&fi->page_waitq);
 	mutex_init(&fi->mutex);
+	fi->lower_path.mnt = NULL;
+	fi->lower_path.dentry = NULL;
+	fi->lower_cred = NULL;
 	fi->forget = fuse_alloc_forget();
 	if (!fi->forget) {
 		kmem_cache_free(fuse_inode_cachep, inode);
@@ -139,6 +142,7 @@ static void fuse_evict_inode(struct inode *inode)
 		fuse_queue_forget(fc, fi->forget, fi->nodeid, fi->nlookup);
 		fi->forget = NULL;
 	}
+	fuse_passthrough_put_lower(inode);
 }
 
 static int fuse_remount_fs(struct super_block *sb, int *flags, char *data)
@@ -228,6 +232,7 @@ void fuse_change_attributes(struct inode *inode, struct fuse_attr *attr,
 
 	old_mtime = inode->i_mtime;
 	fuse_change_attributes_common(inode, attr, attr_valid);
+	fuse_passthrough_update_lower(inode, attr);
 
 	oldsize = inode->i_size;
 	/*
@@ -630,6 +635,10 @@ void fuse_conn_init(struct fuse_conn *fc, struct user_namespace *user_ns)
 	INIT_LIST_HEAD(&fc->devices);
 	idr_init(&fc->passthrough_req);
 	atomic_set(&fc->num_waiting, 0);
+	atomic_long_set(&fc->pt_attr_hit, 0);
+	atomic_long_set(&fc->pt_attr_miss, 0);
+	atomic_long_set(&fc->pt_lookup_hit, 0);
+	atomic_long_set(&fc->pt_lookup_miss, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
 	fc->khctr = 0;
@@ -2,9 +2,11 @@
 
 #include "fuse_i.h"
 
+#include <linux/fadvise.h>
 #include <linux/file.h>
 #include <linux/fuse.h>
 #include <linux/idr.h>
+#include <linux/namei.h>
 #include <linux/uio.h>
 
 #define PASSTHROUGH_IOCB_MASK                                                  \
@@ -207,6 +209,128 @@ ssize_t fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
 	return ret;
 }
 
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	ssize_t ret;
+	const struct cred *old_cred;
+	struct fuse_file *ff = in->private_data;
+	struct file *passthrough_filp = ff->passthrough.filp;
+
+	if (!passthrough_filp->f_op->splice_read)
+		return generic_file_splice_read(in, ppos, pipe, len, flags);
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = passthrough_filp->f_op->splice_read(passthrough_filp, ppos, pipe,
+						  len, flags);
+	revert_creds(old_cred);
+
+	fuse_file_accessed(in, passthrough_filp);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
+				      struct file *out, loff_t *ppos,
+				      size_t len, unsigned int flags)
+{
+	ssize_t ret;
+	const struct cred *old_cred;
+	struct fuse_file *ff = out->private_data;
+	struct inode *fuse_inode = file_inode(out);
+	struct file *passthrough_filp = ff->passthrough.filp;
+
+	if (!passthrough_filp->f_op->splice_write)
+		return iter_file_splice_write(pipe, out, ppos, len, flags);
+
+	inode_lock(fuse_inode);
+
+	fuse_copyattr(out, passthrough_filp);
+
+	old_cred = override_creds(ff->passthrough.cred);
+	file_start_write(passthrough_filp);
+	ret = passthrough_filp->f_op->splice_write(pipe, passthrough_filp, ppos,
+						   len, flags);
+	file_end_write(passthrough_filp);
+	revert_creds(old_cred);
+
+	if (ret > 0)
+		fuse_copyattr(out, passthrough_filp);
+
+	inode_unlock(fuse_inode);
+
+	return ret;
+}
+
+/*
+ * Both ends must be in passthrough mode. If the lower files cannot copy
+ * between themselves, -EOPNOTSUPP makes the VFS fall back to splicing,
+ * which is served by the lower files as well.
+ */
+ssize_t fuse_passthrough_copy_file_range(struct file *file_in, loff_t pos_in,
+					 struct file *file_out, loff_t pos_out,
+					 size_t len, unsigned int flags)
+{
+	ssize_t ret;
+	const struct cred *old_cred;
+	struct fuse_file *ff_in = file_in->private_data;
+	struct fuse_file *ff_out = file_out->private_data;
+	struct inode *fuse_inode = file_inode(file_out);
+	struct file *passthrough_in = ff_in->passthrough.filp;
+	struct file *passthrough_out = ff_out->passthrough.filp;
+
+	if (!passthrough_in || !passthrough_out)
+		return -EOPNOTSUPP;
+
+	inode_lock(fuse_inode);
+
+	old_cred = override_creds(ff_out->passthrough.cred);
+	ret = vfs_copy_file_range(passthrough_in, pos_in, passthrough_out,
+				  pos_out, len, flags);
+	revert_creds(old_cred);
+
+	if (ret > 0)
+		fuse_copyattr(file_out, passthrough_out);
+
+	inode_unlock(fuse_inode);
+
+	if (ret == -EXDEV)
+		ret = -EOPNOTSUPP;
+
+	return ret;
+}
+
+/*
+ * Readahead hints and readahead(2) land on the lower file, which owns the
+ * page cache. Only hints that drop pages are passed on to the FUSE mapping,
+ * for whatever it cached before passthrough was set up: anything that reads
+ * ahead there would send FUSE_READ to the daemon and read the data twice.
+ */
+int fuse_passthrough_fadvise(struct file *file, loff_t offset, loff_t len,
+			     int advice)
+{
+	int ret;
+	const struct cred *old_cred;
+	struct fuse_file *ff = file->private_data;
+	struct file *passthrough_filp = ff->passthrough.filp;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = vfs_fadvise(passthrough_filp, offset, len, advice);
+	revert_creds(old_cred);
+
+	if (ret)
+		return ret;
+
+	switch (advice) {
+	case POSIX_FADV_DONTNEED:
+	case POSIX_FADV_NOREUSE:
+		return generic_fadvise(file, offset, len, advice);
+	default:
+		return 0;
+	}
+}
+
 int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd)
 {
 	int res;
@@ -304,3 +428,185 @@ void fuse_passthrough_release(struct fuse_passthrough *passthrough)
 		passthrough->cred = NULL;
 	}
 }
+
+static inline struct inode *fuse_lower_inode(struct fuse_inode *fi)
+{
+	struct dentry *lower = smp_load_acquire(&fi->lower_path.dentry);
+
+	return lower ? d_inode(lower) : NULL;
+}
+
+/*
+ * Called with fc->lock held, trust the cached attributes if ctime agrees.
+ * ctime only moves once per clock tick, so a change later in the tick it
+ * was last set in would go unnoticed: only trust a ctime already past.
+ */
+static void fuse_lower_snapshot(struct fuse_inode *fi, struct inode *lower_inode,
+				u64 sec, u32 nsec)
+{
+	struct timespec64 ctime = lower_inode->i_ctime;
+	struct timespec64 now = current_time(lower_inode);
+
+	if (sec != ctime.tv_sec || nsec != ctime.tv_nsec ||
+	    timespec64_compare(&ctime, &now) >= 0) {
+		clear_bit(FUSE_I_LOWER_VALID, &fi->state);
+		return;
+	}
+
+	fi->lower_ctime = ctime;
+	smp_wmb();
+	set_bit(FUSE_I_LOWER_VALID, &fi->state);
+}
+
+/*
+ * Pin @lower behind @inode so that the cached attributes of @inode can later
+ * be checked against the lower inode without a round trip to the daemon.
+ * Holding the mount as well as the dentry keeps the lower filesystem busy
+ * for as long as the fuse inode lives, rather than leaving an inode behind
+ * on a superblock that has gone away. @cred is what names below a lower
+ * directory are looked up with.
+ */
+static void fuse_passthrough_set_lower(struct inode *inode,
+				       const struct path *lower,
+				       const struct cred *cred)
+{
+	struct fuse_conn *fc = get_fuse_conn(inode);
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct inode *lower_inode = d_inode(lower->dentry);
+	struct dentry *old;
+
+	old = smp_load_acquire(&fi->lower_path.dentry);
+	if (old) {
+		/* daemon moved the inode to another backing file */
+		if (d_inode(old) != lower_inode)
+			clear_bit(FUSE_I_LOWER_VALID, &fi->state);
+		return;
+	}
+
+	if ((inode->i_mode ^ lower_inode->i_mode) & S_IFMT)
+		return;
+
+	path_get(lower);
+	get_cred(cred);
+
+	spin_lock(&fc->lock);
+	old = fi->lower_path.dentry;
+	if (!old) {
+		fi->lower_path.mnt = lower->mnt;
+		fi->lower_cred = cred;
+		smp_store_release(&fi->lower_path.dentry, lower->dentry);
+		/* the attributes we hold may already describe the lower inode */
+		fuse_lower_snapshot(fi, lower_inode, inode->i_ctime.tv_sec,
+				    inode->i_ctime.tv_nsec);
+	}
+	spin_unlock(&fc->lock);
+
+	if (old) {
+		path_put(lower);
+		put_cred(cred);
+	}
+}
+
+/*
+ * Attach the lower file behind a passthrough open, and its directory behind
+ * the directory it was opened in, so that lookups of the other names there
+ * can find their lower inodes as well.
+ */
+void fuse_passthrough_attach_lower(struct file *file)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough.filp;
+	struct dentry *parent;
+	struct path lower_parent;
+
+	fuse_passthrough_set_lower(file_inode(file), &lower->f_path,
+				   ff->passthrough.cred);
+
+	parent = dget_parent(file->f_path.dentry);
+	lower_parent.mnt = lower->f_path.mnt;
+	lower_parent.dentry = dget_parent(lower->f_path.dentry);
+	fuse_passthrough_set_lower(d_inode(parent), &lower_parent,
+				   ff->passthrough.cred);
+	dput(lower_parent.dentry);
+	dput(parent);
+}
+
+/*
+ * Called once lookup or readdirplus has instantiated @name in @dir. If @dir
+ * has a lower directory, the same name below it backs @inode, so files that
+ * are only ever stat()ed reach the fast path without being opened. A lower
+ * name that does not back @inode never gets a matching ctime and so never
+ * produces a hit.
+ */
+void fuse_passthrough_lookup_lower(struct inode *dir, const struct qstr *name,
+				   struct inode *inode)
+{
+	struct fuse_inode *dfi = get_fuse_inode(dir);
+	struct dentry *lower_dir = smp_load_acquire(&dfi->lower_path.dentry);
+	const struct cred *old_cred;
+	struct path lower;
+
+	if (!lower_dir || !inode ||
+	    !READ_ONCE(get_fuse_conn(dir)->passthrough_attr_cache) ||
+	    READ_ONCE(get_fuse_inode(inode)->lower_path.dentry))
+		return;
+
+	old_cred = override_creds(dfi->lower_cred);
+	lower.dentry = lookup_one_len_unlocked(name->name, lower_dir, name->len);
+	revert_creds(old_cred);
+	if (IS_ERR(lower.dentry))
+		return;
+
+	if (d_is_positive(lower.dentry)) {
+		lower.mnt = dfi->lower_path.mnt;
+		fuse_passthrough_set_lower(inode, &lower, dfi->lower_cred);
+	}
+	dput(lower.dentry);
+}
+
+void fuse_passthrough_put_lower(struct inode *inode)
+{
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	if (!fi->lower_path.dentry)
+		return;
+
+	path_put(&fi->lower_path);
+	put_cred(fi->lower_cred);
+	fi->lower_path.dentry = NULL;
+	fi->lower_cred = NULL;
+}
+
+/*
+ * Called with fc->lock held whenever userspace hands us fresh attributes.
+ * They are only trusted past their timeout if they describe the lower inode
+ * as it is right now.
+ */
+void fuse_passthrough_update_lower(struct inode *inode, struct fuse_attr *attr)
+{
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct inode *lower_inode = fuse_lower_inode(fi);
+
+	if (lower_inode)
+		fuse_lower_snapshot(fi, lower_inode, attr->ctime,
+				    attr->ctimensec);
+}
+
+/*
+ * Safe under rcu-walk: the lower path stays pinned for as long as the fuse
+ * inode is alive and a torn ctime read can only turn a hit into a miss.
+ */
+bool fuse_passthrough_lower_valid(struct inode *inode)
+{
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct inode *lower_inode = fuse_lower_inode(fi);
+
+	if (!lower_inode || !test_bit(FUSE_I_LOWER_VALID, &fi->state))
+		return false;
+
+	smp_rmb();
+	if (!lower_inode->i_nlink)
+		return false;
+
+	return timespec64_equal(&fi->lower_ctime, &lower_inode->i_ctime);
+}
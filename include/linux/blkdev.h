@@ -170,6 +170,7 @@ struct request {
 	ktime_t req_ti;
 	ktime_t req_td;
 	ktime_t req_tc;
+	uid_t req_uid;
 #endif /*OPLUS_FEATURE_IOMONITOR*/
 	int internal_tag;
 
@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) 2018-2020 Oplus. All rights reserved.
+ */
+
+#ifndef _IOMONITOR_IOLAT_H
+#define _IOMONITOR_IOLAT_H
+
+#include <linux/types.h>
+
+/*
+ * Binary layout of /proc/IoMonitor/uid_iolat: one iolat_header followed by
+ * nr_records iolat_uid_record. hist bucket 0 counts latencies under 1us,
+ * bucket i > 0 counts [2^(i-1), 2^i) us, the last bucket is open ended.
+ * Requests of UIDs that did not fit in the per-cpu tables are reported
+ * under IOLAT_OVERFLOW_UID. I/O issued by kernel threads, such as
+ * writeback, is charged to the owner of the file it belongs to, or to
+ * IOLAT_WRITEBACK_UID when there is none.
+ */
+#define IOLAT_MAGIC		0x494f4c54	/* "IOLT" */
+#define IOLAT_VERSION		2
+#define IOLAT_BUCKETS		24
+#define IOLAT_OVERFLOW_UID	((__u32)-1)
+#define IOLAT_WRITEBACK_UID	((__u32)-2)
+
+enum {
+	IOLAT_READ,
+	IOLAT_WRITE,
+	IOLAT_DIRS,
+};
+
+enum {
+	IOLAT_QUEUE,	/* allocation to dispatch */
+	IOLAT_DEVICE,	/* dispatch to completion */
+	IOLAT_STAGES,
+};
+
+struct iolat_header {
+	__u32 magic;
+	__u32 version;
+	__u32 nr_buckets;
+	__u32 nr_records;
+	__u64 since_ns;		/* monotonic time of the last reset */
+};
+
+struct iolat_uid_record {
+	__u32 uid;
+	__u32 reserved;
+	__u64 count[IOLAT_DIRS];
+	__u64 sum_us[IOLAT_DIRS][IOLAT_STAGES];
+	__u32 hist[IOLAT_DIRS][IOLAT_STAGES][IOLAT_BUCKETS];
+};
+
+#ifdef __KERNEL__
+#include <linux/cred.h>
+#include <linux/sched.h>
+
+struct request;
+struct proc_dir_entry;
+
+/* kernel threads work on behalf of others, the owner is found at completion */
+static inline uid_t iomonitor_iolat_uid(void)
+{
+	if (current->flags & PF_KTHREAD)
+		return IOLAT_WRITEBACK_UID;
+	return from_kuid_munged(&init_user_ns, current_uid());
+}
+
+#if defined(OPLUS_FEATURE_IOMONITOR) && defined(CONFIG_IOMONITOR)
+extern void iomonitor_record_iolat(struct request *rq);
+extern struct proc_dir_entry *create_uid_iolat_proc(struct proc_dir_entry *parent);
+#else
+static inline void iomonitor_record_iolat(struct request *rq) {}
+#endif
+#endif /* __KERNEL__ */
+
+#endif /* _IOMONITOR_IOLAT_H */
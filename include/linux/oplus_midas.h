@@ -11,10 +11,12 @@
 
 #ifdef CONFIG_OPLUS_FEATURE_MIDAS
 void midas_record_task_times(uid_t uid, u64 cputime,
-                    struct task_struct *p, unsigned int state);
+                    struct task_struct *p, unsigned int state,
+                    unsigned int freq);
 #else
 static inline void midas_record_task_times(uid_t uid, u64 cputime,
-                    struct task_struct *p, unsigned int state) { }
+                    struct task_struct *p, unsigned int state,
+                    unsigned int freq) { }
 #endif
 
 #endif /* __OPLUS_MIDAS_H__ */
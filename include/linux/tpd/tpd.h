@@ -61,6 +61,8 @@ static inline bool is_st_tpd_task(struct task_struct *tsk) { return tsk ? (tsk->
 extern void tpd_tglist_del(struct task_struct *tsk);
 extern bool is_st_tpd_enable(void);
 extern void tpd_init_policy(struct cpufreq_policy *policy);
+extern void tpd_auto_enable(bool enable);
+extern void tpd_auto_tag(struct task_struct *tsk, int decision);
 #else
 static inline bool is_tpd_enable(void) { return false; }
 static inline int tpd_suggested(struct task_struct* tsk, int request_cluster) { return request_cluster; }
@@ -73,6 +75,8 @@ static inline bool is_st_tpd_task(struct task_struct *tsk) { return false; }
 static inline void tpd_tglist_del(struct task_struct *tsk) {};
 static inline bool is_st_tpd_enable(void) { return false; }
 static inline void tpd_init_policy(struct cpufreq_policy *policy) {}
+static inline void tpd_auto_enable(bool enable) {}
+static inline void tpd_auto_tag(struct task_struct *tsk, int decision) {}
 #endif
 
 #endif
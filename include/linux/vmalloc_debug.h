@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (C) 2018-2020 Oplus. All rights reserved.
+ */
+
+#ifndef _LINUX_VMALLOC_DEBUG_H
+#define _LINUX_VMALLOC_DEBUG_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * VMALLOC_DEBUG_TOP on /proc/.../vmalloc_debug returns the vmalloc call
+ * sites holding the most pages, largest first. On entry nr is the number
+ * of vmalloc_debug_site the buffer at sites can take; on return nr is the
+ * number filled in and total the number of live sites. Allocations that
+ * found no free site are reported with handle 0.
+ */
+struct vmalloc_debug_site {
+	__u32 handle;		/* stack depot handle */
+	__u32 nr_areas;
+	__u64 nr_pages;
+	__u64 caller;
+};
+
+struct vmalloc_debug_top {
+	__u32 nr;
+	__u32 total;
+	__u64 sites;		/* struct vmalloc_debug_site __user * */
+};
+
+#define __VMALLOC_DEBUG_IO	0xb6
+#define VMALLOC_DEBUG_TOP	_IOWR(__VMALLOC_DEBUG_IO, 1, struct vmalloc_debug_top)
+
+#endif /* _LINUX_VMALLOC_DEBUG_H */
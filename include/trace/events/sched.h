@@ -1616,6 +1616,28 @@ TRACE_EVENT(core_ctl_update_nr_need,
 		__entry->nrrun, __entry->max_nr, __entry->nr_prev_assist)
 );
 
+TRACE_EVENT(core_ctl_hist_sample,
+
+	TP_PROTO(int cpu, int nrrun, int nr_big),
+
+	TP_ARGS(cpu, nrrun, nr_big),
+
+	TP_STRUCT__entry(
+		__field(int, cpu)
+		__field(int, nrrun)
+		__field(int, nr_big)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->nrrun = nrrun;
+		__entry->nr_big = nr_big;
+	),
+
+	TP_printk("cpu=%d nrrun=%d nr_big=%d",
+		__entry->cpu, __entry->nrrun, __entry->nr_big)
+);
+
 TRACE_EVENT(core_ctl_notif_data,
 
 	TP_PROTO(u32 nr_big, u32 ta_load, u32 *ta_util, u32 *cur_cap),
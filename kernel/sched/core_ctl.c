@@ -19,6 +19,7 @@
 #include <trace/events/sched.h>
 #include "sched.h"
 #include "walt.h"
+#include "core_ctl_hist.h"
 
 struct cluster_data {
 	bool inited;
@@ -48,6 +49,9 @@ struct cluster_data {
 	unsigned int boost;
 	struct kobject kobj;
 	unsigned int strict_nrrun;
+	bool hist_mode;
+	struct core_ctl_hist hist;
+	struct core_ctl_hist_params hist_params;
 };
 
 struct cpu_data {
@@ -274,6 +278,87 @@ static ssize_t show_enable(const struct cluster_data *state, char *buf)
 	return scnprintf(buf, PAGE_SIZE, "%u\n", state->enable);
 }
 
+static ssize_t store_hist_mode(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+	unsigned long flags;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	spin_lock_irqsave(&state_lock, flags);
+	state->hist_mode = !!val;
+	spin_unlock_irqrestore(&state_lock, flags);
+	apply_need(state);
+
+	return count;
+}
+
+static ssize_t show_hist_mode(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->hist_mode);
+}
+
+static ssize_t store_hist_windows(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+	unsigned long flags;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	if (!val || val > CORE_CTL_HIST_MAX_WINDOWS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&state_lock, flags);
+	state->hist_params.windows = val;
+	core_ctl_hist_reset(&state->hist);
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	return count;
+}
+
+static ssize_t show_hist_windows(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->hist_params.windows);
+}
+
+/*
+ * hist_pct takes "<up_pct> <down_pct> <big_pct>". down_pct must not be
+ * below up_pct, the gap between them is the hysteresis band.
+ */
+static ssize_t store_hist_pct(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int up, down, big;
+	unsigned long flags;
+
+	if (sscanf(buf, "%u %u %u\n", &up, &down, &big) != 3)
+		return -EINVAL;
+
+	if (up > 100 || down > 100 || big > 100 || down < up)
+		return -EINVAL;
+
+	spin_lock_irqsave(&state_lock, flags);
+	state->hist_params.up_pct = up;
+	state->hist_params.down_pct = down;
+	state->hist_params.big_pct = big;
+	spin_unlock_irqrestore(&state_lock, flags);
+	apply_need(state);
+
+	return count;
+}
+
+static ssize_t show_hist_pct(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u %u %u\n",
+			 state->hist_params.up_pct,
+			 state->hist_params.down_pct,
+			 state->hist_params.big_pct);
+}
+
 static ssize_t show_need_cpus(const struct cluster_data *state, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%u\n", state->need_cpus);
@@ -408,6 +493,9 @@ core_ctl_attr_ro(active_cpus);
 core_ctl_attr_ro(global_state);
 core_ctl_attr_rw(not_preferred);
 core_ctl_attr_rw(enable);
+core_ctl_attr_rw(hist_mode);
+core_ctl_attr_rw(hist_windows);
+core_ctl_attr_rw(hist_pct);
 
 static struct attribute *default_attrs[] = {
 	&min_cpus.attr,
@@ -422,6 +510,9 @@ static struct attribute *default_attrs[] = {
 	&active_cpus.attr,
 	&global_state.attr,
 	&not_preferred.attr,
+	&hist_mode.attr,
+	&hist_windows.attr,
+	&hist_pct.attr,
 	NULL
 };
 
@@ -672,7 +763,7 @@ static void update_running_avg(void)
 
 	spin_lock_irqsave(&state_lock, flags);
 	for_each_cluster(cluster, index) {
-		int nr_need, prev_misfit_need;
+		int nr_need, prev_misfit_need, nr_big;
 
 		if (!cluster->inited)
 			continue;
@@ -692,7 +783,13 @@ static void update_running_avg(void)
 					cluster->nrrun, cluster->max_nr,
 					cluster->nr_prev_assist);
 
-		big_avg += cluster_real_big_tasks(index);
+		nr_big = cluster_real_big_tasks(index);
+		core_ctl_hist_add(&cluster->hist, cluster->hist_params.windows,
+				  cluster->nrrun, nr_big);
+		trace_core_ctl_hist_sample(cluster->first_cpu, cluster->nrrun,
+					   nr_big);
+
+		big_avg += nr_big;
 	}
 	spin_unlock_irqrestore(&state_lock, flags);
 
@@ -789,6 +886,16 @@ static bool eval_need(struct cluster_data *cluster)
 
 	if (cluster->boost || !cluster->enable || need_all_cpus(cluster)) {
 		need_cpus = cluster->max_cpus;
+	} else if (cluster->hist_mode) {
+		/*
+		 * The need comes from the runnable/big-task percentiles
+		 * instead of the instantaneous busy state, so CPUs used by
+		 * a recent burst stay unisolated.
+		 */
+		cluster->active_cpus = get_active_cpu_count(cluster);
+		need_cpus = core_ctl_hist_need(&cluster->hist,
+					       &cluster->hist_params,
+					       cluster->need_cpus);
 	} else {
 		cluster->active_cpus = get_active_cpu_count(cluster);
 		thres_idx = cluster->active_cpus ? cluster->active_cpus - 1 : 0;
@@ -1303,6 +1410,14 @@ static int cluster_init(const struct cpumask *mask)
 	cluster->enable = true;
 	cluster->nr_not_preferred_cpus = 0;
 	cluster->strict_nrrun = 0;
+	cluster->hist_mode = false;
+	cluster->hist_params.windows = 10;
+	cluster->hist_params.up_pct = 70;
+	cluster->hist_params.down_pct = 95;
+	cluster->hist_params.big_pct = 90;
+	cluster->hist_params.num_cpus = cluster->num_cpus;
+	cluster->hist_params.big_cluster = !is_min_capacity_cpu(first_cpu);
+	core_ctl_hist_reset(&cluster->hist);
 	INIT_LIST_HEAD(&cluster->lru);
 	spin_lock_init(&cluster->pending_lock);
 
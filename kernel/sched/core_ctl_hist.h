@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Runnable-history based core count decision for core_ctl.
+ *
+ * This header carries no kernel dependencies so that the very same
+ * decision function can be built into tools/sched/core_ctl_replay and fed
+ * with recorded core_ctl_hist_sample trace events for offline tuning.
+ */
+
+#ifndef __CORE_CTL_HIST_H
+#define __CORE_CTL_HIST_H
+
+#define CORE_CTL_HIST_MAX_WINDOWS	32
+#define CORE_CTL_HIST_BINS		16
+
+/*
+ * Sliding histogram over the last @windows samples. The ring keeps the raw
+ * samples so that the oldest one can be retired from the bins when a new
+ * sample arrives; percentile lookups are O(CORE_CTL_HIST_BINS).
+ */
+struct core_ctl_hist {
+	unsigned char nr_ring[CORE_CTL_HIST_MAX_WINDOWS];
+	unsigned char big_ring[CORE_CTL_HIST_MAX_WINDOWS];
+	unsigned short nr_bins[CORE_CTL_HIST_BINS];
+	unsigned short big_bins[CORE_CTL_HIST_BINS];
+	unsigned int head;
+	unsigned int count;
+};
+
+struct core_ctl_hist_params {
+	unsigned int windows;
+	unsigned int up_pct;
+	unsigned int down_pct;
+	unsigned int big_pct;
+	unsigned int num_cpus;
+	int big_cluster;
+};
+
+static inline unsigned int core_ctl_hist_bin(unsigned int val)
+{
+	return val < CORE_CTL_HIST_BINS ? val : CORE_CTL_HIST_BINS - 1;
+}
+
+static inline void core_ctl_hist_reset(struct core_ctl_hist *hist)
+{
+	unsigned int i;
+
+	for (i = 0; i < CORE_CTL_HIST_BINS; i++) {
+		hist->nr_bins[i] = 0;
+		hist->big_bins[i] = 0;
+	}
+	hist->head = 0;
+	hist->count = 0;
+}
+
+static inline void core_ctl_hist_add(struct core_ctl_hist *hist,
+				     unsigned int windows,
+				     unsigned int nr, unsigned int big)
+{
+	unsigned int slot;
+
+	if (windows > CORE_CTL_HIST_MAX_WINDOWS)
+		windows = CORE_CTL_HIST_MAX_WINDOWS;
+	if (!windows)
+		windows = 1;
+
+	/* retire the oldest sample once the window is full */
+	while (hist->count >= windows) {
+		slot = (hist->head + CORE_CTL_HIST_MAX_WINDOWS - hist->count) %
+					CORE_CTL_HIST_MAX_WINDOWS;
+		hist->nr_bins[hist->nr_ring[slot]]--;
+		hist->big_bins[hist->big_ring[slot]]--;
+		hist->count--;
+	}
+
+	slot = hist->head;
+	hist->nr_ring[slot] = core_ctl_hist_bin(nr);
+	hist->big_ring[slot] = core_ctl_hist_bin(big);
+	hist->nr_bins[hist->nr_ring[slot]]++;
+	hist->big_bins[hist->big_ring[slot]]++;
+	hist->head = (slot + 1) % CORE_CTL_HIST_MAX_WINDOWS;
+	hist->count++;
+}
+
+/* smallest value v such that at least @pct percent of samples are <= v */
+static inline unsigned int core_ctl_hist_pct(const unsigned short *bins,
+					     unsigned int count,
+					     unsigned int pct)
+{
+	unsigned int i, seen = 0, target;
+
+	if (!count)
+		return 0;
+
+	target = (count * pct + 99) / 100;
+	if (!target)
+		target = 1;
+
+	for (i = 0; i < CORE_CTL_HIST_BINS; i++) {
+		seen += bins[i];
+		if (seen >= target)
+			return i;
+	}
+
+	return CORE_CTL_HIST_BINS - 1;
+}
+
+/*
+ * Compute the number of CPUs to keep unisolated given the current need.
+ *
+ * The need is raised as soon as the up_pct percentile of the runnable
+ * history exceeds it, and only lowered once the (higher) down_pct
+ * percentile falls below it, so the down_pct/up_pct gap acts as the
+ * hysteresis band. Non-minimum clusters additionally never drop below the
+ * big_pct percentile of the big-task history: big CPUs are parked only
+ * when the history says they will not be needed.
+ */
+static inline unsigned int
+core_ctl_hist_need(const struct core_ctl_hist *hist,
+		   const struct core_ctl_hist_params *p,
+		   unsigned int cur_need)
+{
+	unsigned int up, down, big, need;
+
+	up = core_ctl_hist_pct(hist->nr_bins, hist->count, p->up_pct);
+	down = core_ctl_hist_pct(hist->nr_bins, hist->count, p->down_pct);
+	if (down < up)
+		down = up;
+
+	if (p->big_cluster) {
+		big = core_ctl_hist_pct(hist->big_bins, hist->count,
+					p->big_pct);
+		if (up < big)
+			up = big;
+		if (down < big)
+			down = big;
+	}
+
+	if (up > cur_need)
+		need = up;
+	else if (down < cur_need)
+		need = down;
+	else
+		need = cur_need;
+
+	return need < p->num_cpus ? need : p->num_cpus;
+}
+
+#endif /* __CORE_CTL_HIST_H */
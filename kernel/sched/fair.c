@@ -8313,6 +8313,10 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
 		tpp_find_cpu(&best_energy_cpu, p);
 #endif /* CONFIG_OPLUS_FEATURE_TPP */
 
+#ifdef CONFIG_OPLUS_FEATURE_GAME_OPT
+	best_energy_cpu = g_rt_coloc_select_cpu(p, prev_cpu, best_energy_cpu);
+#endif
+
 done:
 #ifdef CONFIG_OPLUS_FEATURE_INPUT_BOOST_V4
 frame_done:
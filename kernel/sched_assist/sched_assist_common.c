@@ -7,6 +7,7 @@
 #include <linux/sched.h>
 #include <linux/list.h>
 #include <linux/jiffies.h>
+#include <linux/module.h>
 #include <trace/events/sched.h>
 #include <../kernel/sched/sched.h>
 #include <linux/fs.h>
@@ -217,6 +218,7 @@ inline bool test_task_ux(struct task_struct *task)
 
 	return false;
 }
+EXPORT_SYMBOL_GPL(test_task_ux);
 
 #ifdef CONFIG_OPLUS_FEATURE_SCHED_SPREAD
 #define NR_IMBALANCE_THRESHOLD (24)
@@ -327,6 +327,231 @@ int kbuf_dump_kmalloc_debug(struct kmem_cache *s, char *kbuf, int buff_len)
 	return kd_list_locations(s, kbuf, buff_len);
 }
 
+/*
+ * Live objects per allocation call site, kept up to date at alloc and free
+ * of every SLAB_STORE_USER cache, so a report costs O(call sites) rather
+ * than a walk of every slab under n->list_lock. Sites are keyed by the
+ * stack hash set_track() already keeps in the track and live in one shared
+ * open addressed table that is never shrunk; the counts are per cpu, since
+ * objects are often freed on another cpu than the one they came from.
+ * Objects allocated before the table existed are left out entirely, so
+ * their frees cannot pull a site below its live count.
+ */
+#define KD_SITES		1024
+#define KD_SITE_MAX_PROBE	16
+
+struct kd_site {
+	u32 hash;
+	u32 depth;
+	bool ready;		/* set once the stack below is filled in */
+	unsigned long addr;
+	unsigned long addrs[KD_SLABTRACE_STACK_CNT];
+};
+
+struct kd_site_count {
+	long objs;
+	long bytes;
+};
+
+struct kd_site_report {
+	unsigned int idx;
+	long objs;
+	long bytes;
+};
+
+static struct kd_site *kd_sites;
+/*
+ * KD_SITES + 1 counts, the last one counting every alloc that found no site.
+ * Frees never find a site for those, so it is a running total of untracked
+ * allocs rather than a live count.
+ */
+static DEFINE_PER_CPU(struct kd_site_count *, kd_site_counts);
+/* jiffies once the counts were published, 0 before */
+static unsigned long kd_sites_since;
+
+static void kd_site_fill(struct kd_site *site, const struct track *t)
+{
+	site->addr = t->addr;
+	site->depth = min_t(u32, ARRAY_SIZE(site->addrs), t->depth);
+#ifdef COMPACT_OPLUS_SLUB_TRACK
+	{
+		int i;
+		for (i = 0; i < site->depth; i++)
+			site->addrs[i] = t->addrs[i] + MODULES_VADDR;
+	}
+#else
+	memcpy(site->addrs, t->addrs, sizeof(site->addrs[0]) * site->depth);
+#endif
+	smp_store_release(&site->ready, true);
+}
+
+static unsigned int kd_site_index(const struct track *t, bool add)
+{
+	unsigned int i, idx = t->hash & (KD_SITES - 1);
+	struct kd_site *site;
+	u32 hash;
+
+	for (i = 0; i < KD_SITE_MAX_PROBE; i++, idx = (idx + 1) & (KD_SITES - 1)) {
+		site = &kd_sites[idx];
+		hash = READ_ONCE(site->hash);
+		if (hash == t->hash)
+			return idx;
+		if (hash)
+			continue;
+		/* sites are never removed, the first hole ends the chain */
+		if (!add)
+			break;
+
+		hash = cmpxchg(&site->hash, 0, t->hash);
+		if (!hash) {
+			kd_site_fill(site, t);
+			return idx;
+		}
+		if (hash == t->hash)
+			return idx;
+	}
+
+	return KD_SITES;
+}
+
+/* called with irqs disabled from the alloc and free debug paths */
+static void kd_site_account(struct kmem_cache *s, const struct track *t,
+			    int dir)
+{
+	unsigned long since = READ_ONCE(kd_sites_since);
+	struct kd_site_count *c;
+	unsigned int idx;
+
+	if (unlikely(!since) || !t->hash || !time_after(t->when, since))
+		return;
+
+	/* pairs with the barrier in kd_sites_init() */
+	smp_rmb();
+	c = this_cpu_read(kd_site_counts);
+
+	idx = kd_site_index(t, dir > 0);
+	/* the alloc found no site either, it was counted as untracked */
+	if (idx == KD_SITES && dir < 0)
+		return;
+	c[idx].objs += dir;
+	c[idx].bytes += dir * (long)s->object_size;
+}
+
+static int kd_site_report_cmp(const void *a, const void *b)
+{
+	const struct kd_site_report *ra = a, *rb = b;
+
+	if (ra->bytes == rb->bytes)
+		return 0;
+	return ra->bytes < rb->bytes ? 1 : -1;
+}
+
+static int kd_sites_show(struct seq_file *m, void *v)
+{
+	struct kd_site_report *r;
+	struct kd_site_count *c;
+	struct kd_site *site;
+	unsigned int i, j, nr = 0;
+	long objs, bytes;
+	int cpu;
+
+	r = kvmalloc_array(KD_SITES + 1, sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	for (i = 0; i <= KD_SITES; i++) {
+		if (i < KD_SITES && !smp_load_acquire(&kd_sites[i].ready))
+			continue;
+
+		objs = bytes = 0;
+		for_each_possible_cpu(cpu) {
+			c = per_cpu(kd_site_counts, cpu);
+			objs += READ_ONCE(c[i].objs);
+			bytes += READ_ONCE(c[i].bytes);
+		}
+		/* the per cpu sums are not a snapshot and may dip below 0 */
+		if (objs <= 0 || bytes <= 0)
+			continue;
+
+		r[nr].idx = i;
+		r[nr].objs = objs;
+		r[nr].bytes = bytes;
+		nr++;
+	}
+
+	sort(r, nr, sizeof(*r), kd_site_report_cmp, NULL);
+
+	for (i = 0; i < nr; i++) {
+		if (r[i].idx == KD_SITES) {
+			seq_printf(m, "%7ld KB %7ld objs <no free site, allocated in total>\n\n",
+				   r[i].bytes >> 10, r[i].objs);
+			continue;
+		}
+
+		site = &kd_sites[r[i].idx];
+		seq_printf(m, "%7ld KB %7ld objs %pS\n", r[i].bytes >> 10,
+			   r[i].objs, (void *)site->addr);
+		for (j = 0; j < site->depth; j++)
+			seq_printf(m, "%pS\n", (void *)site->addrs[j]);
+		seq_putc(m, '\n');
+	}
+
+	kvfree(r);
+	return 0;
+}
+
+static int kd_sites_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kd_sites_show, NULL);
+}
+
+static const struct file_operations kmalloc_sites_operations = {
+	.open		= kd_sites_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init kd_sites_init(void)
+{
+	struct kd_site_count **counts;
+	int cpu;
+
+	kd_sites = vzalloc(KD_SITES * sizeof(*kd_sites));
+	if (!kd_sites)
+		return -ENOMEM;
+
+	/* publish the counts only once all of them are allocated */
+	counts = kcalloc(nr_cpu_ids, sizeof(*counts), GFP_KERNEL);
+	if (!counts)
+		goto err;
+
+	for_each_possible_cpu(cpu) {
+		counts[cpu] = vzalloc((KD_SITES + 1) * sizeof(**counts));
+		if (!counts[cpu])
+			goto err;
+	}
+
+	for_each_possible_cpu(cpu)
+		per_cpu(kd_site_counts, cpu) = counts[cpu];
+	kfree(counts);
+
+	/* only objects allocated from the next tick on are counted */
+	smp_wmb();
+	WRITE_ONCE(kd_sites_since, jiffies ?: 1);
+	return 0;
+
+err:
+	if (counts) {
+		for_each_possible_cpu(cpu)
+			vfree(counts[cpu]);
+		kfree(counts);
+	}
+	vfree(kd_sites);
+	kd_sites = NULL;
+	return -ENOMEM;
+}
+
 #if defined(CONFIG_MEMLEAK_DETECT_THREAD) && defined(CONFIG_SVELTE)
 #define KMALLOC_DEBUG_MIN_WATERMARK 100u
 #define KMALLOC_DEBUG_DUMP_STEP 20u
@@ -924,6 +1149,7 @@ int __init create_kmalloc_debug(struct proc_dir_entry *parent)
 	struct proc_dir_entry *cpentry;
 	struct proc_dir_entry *epentry;
 	struct proc_dir_entry *upentry;
+	struct proc_dir_entry *spentry = NULL;
 #if defined(CONFIG_MEMLEAK_DETECT_THREAD) && defined(CONFIG_SVELTE)
 	struct proc_dir_entry *mpentry;
 #endif
@@ -975,11 +1201,27 @@ int __init create_kmalloc_debug(struct proc_dir_entry *parent)
 		return -ENOMEM;
 	}
 
+	if (!kd_sites_init()) {
+		spentry = proc_create("kmalloc_sites", S_IRUGO, parent,
+				&kmalloc_sites_operations);
+		if (!spentry) {
+			pr_err("create kmalloc_sites proc failed.\n");
+			proc_remove(cpentry);
+			proc_remove(upentry);
+			proc_remove(epentry);
+			proc_remove(opentry);
+			proc_remove(dpentry);
+			return -ENOMEM;
+		}
+	} else
+		pr_warn("kmalloc call site tracking disabled.\n");
+
 #if defined(CONFIG_MEMLEAK_DETECT_THREAD) && defined(CONFIG_SVELTE)
 	mpentry = proc_create("memleak_detect_thread", S_IRUGO|S_IWUGO, parent,
 			&memleak_detect_thread_operations);
 	if (!cpentry) {
 		pr_err("create memleak_detect_thread_operations proc failed.\n");
+		proc_remove(spentry);
 		proc_remove(cpentry);
 		proc_remove(upentry);
 		proc_remove(epentry);
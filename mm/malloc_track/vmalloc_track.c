@@ -5,14 +5,16 @@
 
 #ifndef _VMALLOC_DEBUG_
 #define _VMALLOC_DEBUG_
+#include <linux/capability.h>
+#include <linux/hash.h>
 #include <linux/sort.h>
 #include <linux/stacktrace.h>
 #include <linux/sched/clock.h>
 #include <linux/timer.h>
 #include <linux/timex.h>
 #include <linux/rtc.h>
-#include <linux/version.h>
 #include <linux/memleak_stackdepot.h>
+#include <linux/vmalloc_debug.h>
 
 /* remember the vmalloc info. */
 static atomic_t vmalloc_count = ATOMIC_INIT(0);
@@ -123,10 +125,147 @@ static unsigned int save_vmalloc_stack(unsigned long flags, struct vmap_area *va
 	return 0;
 }
 
+/*
+ * Live pages per allocation stack, kept up to date at vmalloc and vfree so
+ * a report costs O(distinct stacks) and never takes vmap_area_lock. Sites
+ * are keyed by the depot handle saved in vm->hash and live in one open
+ * addressed table that is never shrunk. The table is allocated when vmalloc
+ * debug is first enabled, before any area can carry a handle.
+ */
+#define VD_SITES		2048
+#define VD_SITE_MAX_PROBE	16
+
+struct vd_site {
+	ml_depot_stack_handle_t handle;
+	atomic_t nr_areas;
+	atomic_long_t nr_pages;
+	const void *caller;
+};
+
+/* VD_SITES + 1 sites, the last one for areas that found no free site */
+static struct vd_site *vd_sites;
+
+static struct vd_site *vd_site_find(struct vd_site *sites,
+		const struct vm_struct *v, bool add)
+{
+	unsigned int i, idx = hash_32(v->hash, ilog2(VD_SITES));
+	struct vd_site *site;
+	u32 handle;
+
+	for (i = 0; i < VD_SITE_MAX_PROBE; i++, idx = (idx + 1) & (VD_SITES - 1)) {
+		site = &sites[idx];
+		handle = READ_ONCE(site->handle);
+		if (handle == v->hash)
+			return site;
+		if (handle)
+			continue;
+		/* sites are never removed, the first hole ends the chain */
+		if (!add)
+			break;
+
+		handle = cmpxchg(&site->handle, 0, v->hash);
+		if (!handle) {
+			WRITE_ONCE(site->caller, v->caller);
+			return site;
+		}
+		if (handle == v->hash)
+			return site;
+	}
+
+	return &sites[VD_SITES];
+}
+
+static int vd_sites_init(void)
+{
+	struct vd_site *sites;
+
+	if (READ_ONCE(vd_sites))
+		return 0;
+
+	sites = vzalloc((VD_SITES + 1) * sizeof(*sites));
+	if (!sites)
+		return -ENOMEM;
+
+	if (cmpxchg(&vd_sites, NULL, sites))
+		vfree(sites);
+	return 0;
+}
+
+/* called once the area is populated, so nr_pages is final */
+static void account_vmalloc_stack(struct vm_struct *v)
+{
+	struct vd_site *sites = READ_ONCE(vd_sites);
+	struct vd_site *site;
+
+	if (!sites || !v->hash)
+		return;
+
+	site = vd_site_find(sites, v, true);
+	atomic_inc(&site->nr_areas);
+	atomic_long_add(v->nr_pages, &site->nr_pages);
+}
+
 static void dec_vmalloc_stat(struct vmap_area *va)
 {
-	if (va->vm->flags & VM_ALLOC)
-		atomic_dec(&vmalloc_count);
+	struct vd_site *sites = READ_ONCE(vd_sites);
+	struct vm_struct *v = va->vm;
+	struct vd_site *site;
+
+	if (!(v->flags & VM_ALLOC))
+		return;
+
+	atomic_dec(&vmalloc_count);
+
+	/* areas that failed to populate were never accounted */
+	if (!sites || !v->hash || (v->flags & VM_UNINITIALIZED))
+		return;
+
+	site = vd_site_find(sites, v, false);
+	atomic_dec(&site->nr_areas);
+	atomic_long_sub(v->nr_pages, &site->nr_pages);
+}
+
+static int vd_site_cmp(const void *a, const void *b)
+{
+	const struct vmalloc_debug_site *ra = a, *rb = b;
+
+	if (ra->nr_pages == rb->nr_pages)
+		return 0;
+	return ra->nr_pages < rb->nr_pages ? 1 : -1;
+}
+
+/* live sites, largest first; the caller kvfree()s the result */
+static struct vmalloc_debug_site *vd_sites_collect(unsigned int *nr)
+{
+	struct vd_site *sites = READ_ONCE(vd_sites);
+	struct vmalloc_debug_site *r;
+	struct vd_site *site;
+	unsigned int i, n = 0;
+	long nr_pages;
+
+	r = kvmalloc_array(VD_SITES + 1, sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return NULL;
+
+	for (i = 0; sites && i <= VD_SITES; i++) {
+		site = &sites[i];
+		if (i < VD_SITES && !READ_ONCE(site->handle))
+			continue;
+
+		nr_pages = atomic_long_read(&site->nr_pages);
+		if (nr_pages <= 0)
+			continue;
+
+		r[n].handle = i < VD_SITES ? site->handle : 0;
+		r[n].nr_areas = max(atomic_read(&site->nr_areas), 0);
+		r[n].nr_pages = nr_pages;
+		r[n].caller = (unsigned long)READ_ONCE(site->caller);
+		n++;
+	}
+
+	sort(r, n, sizeof(*r), vd_site_cmp, NULL);
+	*nr = n;
+	return r;
 }
 
 static ssize_t vmalloc_debug_enable_write(struct file *file,
@@ -151,6 +290,8 @@ static ssize_t vmalloc_debug_enable_write(struct file *file,
 		ret = ml_depot_init();
 		if (ret)
 			return  -ENOMEM;
+		if (vd_sites_init())
+			return -ENOMEM;
 		vmalloc_debug_enable = 1;
 	} else
 		vmalloc_debug_enable = 0;
@@ -214,6 +355,10 @@ void enable_vmalloc_debug(void)
 		pr_err("init depot failed, oom.\n");
 		return;
 	}
+	if (vd_sites_init()) {
+		pr_err("init vmalloc sites failed, oom.\n");
+		return;
+	}
 	vmalloc_debug_enable = 1;
 }
 EXPORT_SYMBOL(enable_vmalloc_debug);
@@ -233,142 +378,36 @@ static const struct file_operations proc_vmalloc_debug_enable_ops = {
 	.read		= vmalloc_debug_enable_read,
 };
 
-typedef struct {
-	const void *caller;
-	unsigned int hash;
-	unsigned int nr_pages;
-} vmalloc_debug_list;
-
-typedef struct {
-	unsigned long max;
-	unsigned long count;
-	vmalloc_debug_list *data;
-} vmalloc_record_t;
-
-static int add_record(vmalloc_record_t *t, struct vm_struct *v)
-{
-	long start, end, pos;
-	vmalloc_debug_list *l;
-	unsigned int hash;
-
-	start = -1;
-	end = t->count;
-
-	for ( ; ; ) {
-		pos = start + (end - start + 1) / 2;
-
-		/*
-		 * There is nothing at "end". If we end up there
-		 * we need to add something to before end.
-		 */
-		if (pos == end)
-			break;
-
-		hash = t->data[pos].hash;
-		if (v->hash == hash) {
-			l = &t->data[pos];
-			l->nr_pages += v->nr_pages;
-			return 1;
-		}
-
-		if (v->hash < hash)
-			end = pos;
-		else
-			start = pos;
-	}
-
-	/*
-	 * Not found. Insert new tracking element.
-	 */
-	if (t->count >= t->max)
-		return 0;
-
-	l = t->data + pos;
-	if (pos < t->count)
-		memmove(l + 1, l, (t->count - pos) * sizeof(vmalloc_record_t));
-	t->count++;
-	l->caller = v->caller;
-	l->hash = v->hash;
-	l->nr_pages = v->nr_pages;
-	return 1;
-}
-
-static int record_cmp(const void *la, const void *lb)
-{
-	return ((vmalloc_debug_list *)lb)->nr_pages - \
-		((vmalloc_debug_list *)la)->nr_pages;
-}
-
-static void record_swap(void *la, void *lb, int size)
-{
-	vmalloc_debug_list l_tmp;
-
-	memcpy(&l_tmp, la, size);
-	memcpy(la, lb, size);
-	memcpy(lb, &l_tmp, size);
-}
-
 static inline char *dump_vmalloc_debug_info(unsigned int inlen, unsigned int *outlen)
 {
-	unsigned int vmalloc_entry_count = atomic_read(&vmalloc_count);
-	vmalloc_record_t record;
+	struct vmalloc_debug_site *r;
 	char *kbuf;
-	struct vmap_area *va;
-	struct vm_struct *v;
-	unsigned int i, j;
-	int ret;
+	unsigned int i, j, nr;
 	unsigned int len = 0;
 	struct stack_trace trace;
-	unsigned int add_record_cnt = 0;
 
-	record.data = vmalloc((sizeof(vmalloc_debug_list) * vmalloc_entry_count));
-	if (!record.data) {
-		pr_err("vmalloc_debug : malloc record.data failed.\n");
+	r = vd_sites_collect(&nr);
+	if (!r) {
+		pr_err("vmalloc_debug : malloc sites failed.\n");
 		return NULL;
 	}
 
 	kbuf = kmalloc(inlen, GFP_KERNEL);
 	if (!kbuf) {
 		pr_err("vmalloc_debug : malloc kbuf failed.\n");
-		vfree(record.data);
+		kvfree(r);
 		return NULL;
 	}
 
-	record.max = vmalloc_entry_count;
-	record.count = 0;
-	spin_lock(&vmap_area_lock);
-	list_for_each_entry(va, &vmap_area_list, list) {
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5,4,0)
-		if (!(va->flags & VM_VM_AREA))
-			continue;
-#endif
-		v = va->vm;
-		if (!v)
-			continue;
-
-		if (!(v->flags & VM_ALLOC) || (v->hash == 0))
-			continue;
-
-		ret = add_record(&record, v);
-		if (!ret)
-			break;
-
-		add_record_cnt++;
-	}
-	spin_unlock(&vmap_area_lock);
-
-	sort(record.data, record.count, sizeof(vmalloc_debug_list),
-			record_cmp, record_swap);
-
 	/* reserve one byte for '\n' */
 	inlen--;
-	for (i = 0; i < record.count; i++) {
-		len += scnprintf(kbuf+len, inlen-len, "- %u KB -\n",
-				record.data[i].nr_pages << 2);
+	for (i = 0; i < nr; i++) {
+		len += scnprintf(kbuf+len, inlen-len, "- %llu KB -\n",
+				r[i].nr_pages << 2);
 
-		if (record.data[i].hash) {
+		if (r[i].handle) {
 			memset(&trace, 0, sizeof(trace));
-			ml_depot_fetch_stack(record.data[i].hash, &trace);
+			ml_depot_fetch_stack(r[i].handle, &trace);
 			for (j = 0; j < trace.nr_entries; j++) {
 				len += scnprintf(kbuf+len, inlen-len,
 						"%pS\n", (void *)trace.entries[j]);
@@ -384,7 +423,7 @@ static inline char *dump_vmalloc_debug_info(unsigned int inlen, unsigned int *ou
 	if ((len > 0) && (kbuf[len - 1] != '\n'))
 		kbuf[len++] = '\n';
 
-	vfree(record.data);
+	kvfree(r);
 	*outlen = len;
 	return kbuf;
 }
@@ -399,42 +438,16 @@ static inline char *dump_vmalloc_debug_info(unsigned int inlen, unsigned int *ou
 static inline void dump_vmalloc_dmesg(unsigned long used_size, char *dump_buff,
 		int len)
 {
-	unsigned int vmalloc_entry_count = atomic_read(&vmalloc_count);
-	vmalloc_record_t record;
-	struct vmap_area *va;
-	struct vm_struct *v;
-	unsigned int i, j;
+	struct vmalloc_debug_site *r;
+	unsigned int i, j, nr;
 	struct stack_trace trace;
 	int dump_buff_len = 0;
 
-	record.data = vmalloc((sizeof(vmalloc_debug_list) * vmalloc_entry_count));
-	if (!record.data) {
-		pr_err("[vmalloc_debug] : malloc record.data failed.\n");
+	r = vd_sites_collect(&nr);
+	if (!r) {
+		pr_err("[vmalloc_debug] : malloc sites failed.\n");
 		return;
 	}
-	record.max = vmalloc_entry_count;
-	record.count = 0;
-
-	spin_lock(&vmap_area_lock);
-	list_for_each_entry(va, &vmap_area_list, list) {
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5,4,0)
-		if (!(va->flags & VM_VM_AREA))
-			continue;
-#endif
-		v = va->vm;
-		if (!v)
-			continue;
-
-		if (!(v->flags & VM_ALLOC) || (v->hash == 0))
-			continue;
-
-		if (!add_record(&record, v))
-			break;
-	}
-	spin_unlock(&vmap_area_lock);
-
-	sort(record.data, record.count, sizeof(vmalloc_debug_list),
-			record_cmp, record_swap);
 
 	memset(dump_buff, 0, len);
 	dump_buff_len = scnprintf(dump_buff + dump_buff_len,
@@ -442,16 +455,16 @@ static inline void dump_vmalloc_dmesg(unsigned long used_size, char *dump_buff,
 			"used %u MB depot_index %d:\n", used_size,
 			ml_get_depot_index());
 
-	for (i = 0; i < record.count; i++) {
+	for (i = 0; i < nr; i++) {
 		dump_buff_len += scnprintf(dump_buff + dump_buff_len,
 				BUFLEN(len, dump_buff_len),
-				"%pS %u KB\n",
-				record.data[i].caller,
-				record.data[i].nr_pages << 2);
+				"%pS %llu KB\n",
+				(void *)(unsigned long)r[i].caller,
+				r[i].nr_pages << 2);
 
-		if (record.data[i].hash) {
+		if (r[i].handle) {
 			memset(&trace, 0, sizeof(trace));
-			ml_depot_fetch_stack(record.data[i].hash, &trace);
+			ml_depot_fetch_stack(r[i].handle, &trace);
 			for (j = 0; j < trace.nr_entries; j++)
 				dump_buff_len += scnprintf(dump_buff + dump_buff_len,
 						BUFLEN(len, dump_buff_len),
@@ -462,8 +475,8 @@ static inline void dump_vmalloc_dmesg(unsigned long used_size, char *dump_buff,
 				BUFLEN(len, dump_buff_len),
 				"-\n");
 	}
-	vfree(record.data);
-	if (!record.count)
+	kvfree(r);
+	if (!nr)
 		dump_buff_len += scnprintf(dump_buff + dump_buff_len,
 				BUFLEN_EXT(len, dump_buff_len),
 				"No Data\n");
@@ -557,8 +570,44 @@ static ssize_t vmalloc_used_read(struct file *filp,
 	return (len < count ? len : count);
 }
 
+static long vmalloc_debug_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg)
+{
+	struct vmalloc_debug_top __user *utop = (void __user *)arg;
+	struct vmalloc_debug_top top;
+	struct vmalloc_debug_site *r;
+	unsigned int nr;
+	long ret = 0;
+
+	if (cmd != VMALLOC_DEBUG_TOP)
+		return -ENOTTY;
+
+	/* callers are raw kernel addresses */
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (copy_from_user(&top, utop, sizeof(top)))
+		return -EFAULT;
+
+	r = vd_sites_collect(&nr);
+	if (!r)
+		return -ENOMEM;
+
+	top.total = nr;
+	top.nr = min(top.nr, nr);
+	if (copy_to_user(u64_to_user_ptr(top.sites), r,
+			top.nr * sizeof(*r)) ||
+	    copy_to_user(utop, &top, sizeof(top)))
+		ret = -EFAULT;
+
+	kvfree(r);
+	return ret;
+}
+
 static const struct file_operations vmalloc_debug_fops = {
 	.read = vmalloc_debug_read,
+	.unlocked_ioctl = vmalloc_debug_ioctl,
+	.compat_ioctl = vmalloc_debug_ioctl,
 };
 
 static const struct file_operations vmalloc_used_fops = {
@@ -1262,6 +1262,15 @@ static inline int alloc_consistency_checks(struct kmem_cache *s,
 	return 1;
 }
 
+#if defined(OPLUS_FEATURE_MEMLEAK_DETECT) && defined(CONFIG_KMALLOC_DEBUG)
+/* per call site live counters, see malloc_track/slub_track.c */
+static void kd_site_account(struct kmem_cache *s, const struct track *t,
+			    int dir);
+#else
+static inline void kd_site_account(struct kmem_cache *s,
+				   const struct track *t, int dir) {}
+#endif
+
 static noinline int alloc_debug_processing(struct kmem_cache *s,
 					struct page *page,
 					void *object, unsigned long addr)
@@ -1272,8 +1281,10 @@ static noinline int alloc_debug_processing(struct kmem_cache *s,
 	}
 
 	/* Success perform special debug activities for allocs */
-	if (s->flags & SLAB_STORE_USER)
+	if (s->flags & SLAB_STORE_USER) {
 		set_track(s, object, TRACK_ALLOC, addr);
+		kd_site_account(s, get_track(s, object, TRACK_ALLOC), 1);
+	}
 	trace(s, page, object, 1);
 	init_object(s, object, SLUB_RED_ACTIVE);
 	return 1;
@@ -1352,6 +1363,9 @@ static noinline int free_debug_processing(
 			goto out;
 	}
 
+	/* the alloc track is still intact, charge the free to its site */
+	if (s->flags & SLAB_STORE_USER)
+		kd_site_account(s, get_track(s, object, TRACK_ALLOC), -1);
 #if !defined(OPLUS_FEATURE_MEMLEAK_DETECT) || !defined(CONFIG_KMALLOC_DEBUG) || defined(CONFIG_SLUB_DEBUG_ON) || defined(CONFIG_OPLUS_FEATURE_SLABTRACE_DEBUG)
 	/* only record alloc stack.
 	*/
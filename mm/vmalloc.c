@@ -43,6 +43,7 @@
 /* used for vmalloc_debug */
 static unsigned int save_vmalloc_stack(unsigned long flags, struct vmap_area *va);
 static void dec_vmalloc_stat(struct vmap_area *va);
+static void account_vmalloc_stack(struct vm_struct *v);
 #endif
 
 struct vfree_deferred {
@@ -2488,6 +2489,11 @@ void *__vmalloc_node_range(unsigned long size, unsigned long align,
 	 */
 	vmalloc_sync_unmappings();
 
+#if defined(OPLUS_FEATURE_MEMLEAK_DETECT) && defined(CONFIG_VMALLOC_DEBUG)
+	/* charge the populated pages to the saved stack. */
+	account_vmalloc_stack(area);
+#endif
+
 	/*
 	 * In this function, newly allocated vm_struct has VM_UNINITIALIZED
 	 * flag. It means that vm_struct is not fully initialized.
@@ -0,0 +1,45 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Compare null_blk IOPS with iomonitor iotrace disabled and enabled.
+#
+# usage: iotrace_bench.sh [runtime_s] [jobs]
+#
+# Needs root, fio and null_blk built as a module. Every request on the
+# null device goes through the block tracepoints iotrace hooks, so the
+# difference between the two runs is the cost of recording.
+
+RUNTIME=${1:-20}
+JOBS=${2:-$(nproc)}
+ENABLE=/sys/io_log_data/iotrace/enable
+DEV=/dev/nullb0
+
+die() {
+	echo "$*" >&2
+	exit 1
+}
+
+[ -w "$ENABLE" ] || die "$ENABLE not writable, is iomonitor built in?"
+command -v fio >/dev/null || die "fio not found"
+
+ORIG=$(cat "$ENABLE")
+modprobe null_blk queue_mode=2 submit_queues="$JOBS" irqmode=0 \
+	completion_nsec=0 nr_devices=1 || die "failed to load null_blk"
+trap 'echo $ORIG > $ENABLE; rmmod null_blk' EXIT
+
+run() {
+	echo "$1" > "$ENABLE"
+	# terse field 8 is read IOPS
+	fio --name=iotrace --filename="$DEV" --direct=1 --rw=randread \
+		--bs=4k --ioengine=libaio --iodepth=32 --numjobs="$JOBS" \
+		--group_reporting --time_based --runtime="$RUNTIME" \
+		--minimal | awk -F';' '{ print $8 }'
+}
+
+OFF=$(run 0)
+ON=$(run 1)
+
+echo "iotrace off: $OFF IOPS"
+echo "iotrace on:  $ON IOPS"
+awk -v off="$OFF" -v on="$ON" \
+	'BEGIN { if (off > 0) printf("overhead:    %.2f%%\n", (off - on) * 100 / off) }'
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * core_ctl_replay: feed recorded core_ctl_hist_sample trace events to the
+ * core_ctl history decision function for offline tuning.
+ *
+ * Record with:
+ *   echo 1 > /sys/kernel/tracing/events/sched/core_ctl_hist_sample/enable
+ *   cat /sys/kernel/tracing/trace > trace.txt
+ *
+ * Replay with:
+ *   core_ctl_replay -c 0:4,4:3,7:1 -w 10 -p 70,95,90 [-v] < trace.txt
+ *
+ * The first cluster given with -c is treated as the minimum capacity
+ * cluster, all others as big clusters.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core_ctl_hist.h"
+
+#define MAX_CLUSTERS	3
+
+struct replay_cluster {
+	int first_cpu;
+	struct core_ctl_hist hist;
+	struct core_ctl_hist_params params;
+	unsigned int need;
+	unsigned long samples;
+	unsigned long need_sum;
+	unsigned long transitions;
+	unsigned long short_windows;
+	unsigned long idle_cpu_windows;
+};
+
+static struct replay_cluster clusters[MAX_CLUSTERS];
+static int nr_clusters;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -c first_cpu:num_cpus[,...] [-w windows]\n"
+		"          [-p up_pct,down_pct,big_pct] [-v] [file]\n", prog);
+	exit(1);
+}
+
+static int parse_clusters(char *arg)
+{
+	char *tok;
+	int first, num;
+
+	for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+		if (nr_clusters == MAX_CLUSTERS)
+			return -1;
+		if (sscanf(tok, "%d:%d", &first, &num) != 2 || num <= 0)
+			return -1;
+		clusters[nr_clusters].first_cpu = first;
+		clusters[nr_clusters].params.num_cpus = num;
+		clusters[nr_clusters].params.big_cluster = nr_clusters != 0;
+		clusters[nr_clusters].need = num;
+		core_ctl_hist_reset(&clusters[nr_clusters].hist);
+		nr_clusters++;
+	}
+
+	return nr_clusters ? 0 : -1;
+}
+
+static struct replay_cluster *find_cluster(int cpu)
+{
+	int i;
+
+	for (i = 0; i < nr_clusters; i++)
+		if (clusters[i].first_cpu == cpu)
+			return &clusters[i];
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int windows = 10, up = 70, down = 95, big = 90;
+	struct replay_cluster *c;
+	char line[1024], ts[64];
+	int verbose = 0, opt, i;
+	FILE *in = stdin;
+
+	while ((opt = getopt(argc, argv, "c:w:p:v")) != -1) {
+		switch (opt) {
+		case 'c':
+			if (parse_clusters(optarg))
+				usage(argv[0]);
+			break;
+		case 'w':
+			windows = atoi(optarg);
+			break;
+		case 'p':
+			if (sscanf(optarg, "%u,%u,%u", &up, &down, &big) != 3)
+				usage(argv[0]);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!nr_clusters || !windows || windows > CORE_CTL_HIST_MAX_WINDOWS ||
+	    down < up || down > 100 || big > 100)
+		usage(argv[0]);
+
+	if (optind < argc) {
+		in = fopen(argv[optind], "r");
+		if (!in) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < nr_clusters; i++) {
+		clusters[i].params.windows = windows;
+		clusters[i].params.up_pct = up;
+		clusters[i].params.down_pct = down;
+		clusters[i].params.big_pct = big;
+	}
+
+	while (fgets(line, sizeof(line), in)) {
+		char *p = strstr(line, "core_ctl_hist_sample:");
+		int cpu, nrrun, nr_big;
+		unsigned int need;
+
+		if (!p)
+			continue;
+		if (sscanf(p, "core_ctl_hist_sample: cpu=%d nrrun=%d nr_big=%d",
+			   &cpu, &nrrun, &nr_big) != 3)
+			continue;
+
+		c = find_cluster(cpu);
+		if (!c)
+			continue;
+
+		core_ctl_hist_add(&c->hist, c->params.windows, nrrun, nr_big);
+		need = core_ctl_hist_need(&c->hist, &c->params, c->need);
+
+		c->samples++;
+		c->need_sum += need;
+		if (need != c->need)
+			c->transitions++;
+		/* demand that had to wait for an unisolate */
+		if ((unsigned int)(c->params.big_cluster ? nr_big : nrrun) > need
+		    && need < c->params.num_cpus)
+			c->short_windows++;
+		c->idle_cpu_windows += c->params.num_cpus - need;
+		c->need = need;
+
+		if (verbose) {
+			if (sscanf(line, "%*s %*s %*s %63[0-9.]", ts) != 1)
+				strcpy(ts, "-");
+			printf("%s cpu=%d nrrun=%d nr_big=%d need=%u\n",
+			       ts, cpu, nrrun, nr_big, need);
+		}
+	}
+
+	printf("cluster  samples  avg_need  transitions  short_windows  parked_cpu_windows\n");
+	for (i = 0; i < nr_clusters; i++) {
+		c = &clusters[i];
+		printf("%7d  %7lu  %8.2f  %11lu  %13lu  %18lu\n",
+		       c->first_cpu, c->samples,
+		       c->samples ? (double)c->need_sum / c->samples : 0.0,
+		       c->transitions, c->short_windows, c->idle_cpu_windows);
+	}
+
+	if (in != stdin)
+		fclose(in);
+
+	return 0;
+}
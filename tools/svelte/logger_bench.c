@@ -0,0 +1,404 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * logger_bench: hammer the svelte logger with concurrent writers and report
+ * write throughput and latency, optionally with a reader checking that no
+ * entry comes back torn.
+ *
+ *   logger_bench [-d /dev/svelte_log] [-t threads] [-s msg_bytes]
+ *                [-T seconds] [-r | -m]
+ *
+ * Run as root. Every message carries its thread, sequence number and a fill
+ * pattern derived from both, so the reader can tell a complete entry from
+ * one that was overwritten while being written or read. -r reads with
+ * read(), -m parses the mmap()ed buffer in place and advances with
+ * LOGGER_ADVANCE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* struct logger_entry from svelte_logger.h, v2 ABI */
+struct bench_entry {
+	uint16_t len;
+	uint16_t hdr_size;
+	int32_t pid;
+	int32_t tid;
+	int32_t sec;
+	int32_t nsec;
+	uint32_t euid;
+	char msg[0];
+};
+
+/* struct logger_mmap_ctl from svelte_logger.h */
+struct bench_ctl {
+	uint64_t w_head;
+	uint64_t w_off;
+	uint64_t size;
+	uint32_t hdr_off;
+	uint32_t align;
+};
+
+#define LOGGER_GET_LOG_BUF_SIZE	_IO(0xAE, 1)
+#define LOGGER_SET_VERSION	_IO(0xAE, 6)
+#define LOGGER_ADVANCE		_IOWR(0xAE, 7, uint64_t)
+#define ENTRY_MAX_PAYLOAD	4076
+#define BENCH_TAG		"lbench"
+#define LAT_BUCKETS		32	/* log2 ns */
+
+struct writer {
+	pthread_t thread;
+	int id;
+	uint64_t writes;
+	uint64_t errors;
+	uint64_t max_ns;
+	uint64_t hist[LAT_BUCKETS];
+};
+
+static const char *dev = "/dev/svelte_log";
+static int nr_threads = 8;
+static int msg_bytes = 128;
+static int seconds = 10;
+static int with_reader;
+static int with_mmap;
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static char fill_char(int id, uint64_t seq, int i)
+{
+	return 'a' + (id * 7 + seq * 13 + i) % 26;
+}
+
+/* "<id> <seq> " then the fill pattern up to msg_bytes */
+static int format_msg(char *buf, int id, uint64_t seq)
+{
+	int n = snprintf(buf, msg_bytes, "%d %llu ", id,
+			 (unsigned long long)seq);
+	int i;
+
+	for (i = n; i < msg_bytes - 1; i++)
+		buf[i] = fill_char(id, seq, i);
+	buf[i] = '\0';
+	return msg_bytes;
+}
+
+static void *writer_fn(void *arg)
+{
+	struct writer *w = arg;
+	char prio = 4;
+	char *msg = malloc(msg_bytes);
+	struct iovec vec[3];
+	uint64_t seq = 0, t0, ns;
+	int fd, b;
+
+	fd = open(dev, O_WRONLY);
+	if (fd < 0 || !msg) {
+		perror(dev);
+		exit(1);
+	}
+
+	vec[0].iov_base = &prio;
+	vec[0].iov_len = 1;
+	vec[1].iov_base = BENCH_TAG;
+	vec[1].iov_len = sizeof(BENCH_TAG);
+	vec[2].iov_base = msg;
+
+	while (!stop) {
+		vec[2].iov_len = format_msg(msg, w->id, seq++);
+		t0 = now_ns();
+		if (writev(fd, vec, 3) < 0)
+			w->errors++;
+		ns = now_ns() - t0;
+
+		w->writes++;
+		if (ns > w->max_ns)
+			w->max_ns = ns;
+		b = 63 - __builtin_clzll(ns | 1);
+		w->hist[b < LAT_BUCKETS ? b : LAT_BUCKETS - 1]++;
+	}
+
+	close(fd);
+	free(msg);
+	return NULL;
+}
+
+struct reader_stats {
+	uint64_t entries;
+	uint64_t ours;
+	uint64_t torn;
+	uint64_t gaps;
+};
+
+static int check_msg(const char *msg, int len, uint64_t *last_seq, int nr)
+{
+	unsigned long long seq;
+	int id, n, i;
+
+	if (sscanf(msg, "%d %llu %n", &id, &seq, &n) != 2 || id < 0 || id >= nr)
+		return -1;
+	if (len != msg_bytes)
+		return -1;
+	for (i = n; i < msg_bytes - 1; i++)
+		if (msg[i] != fill_char(id, seq, i))
+			return -1;
+	if (msg[i])
+		return -1;
+
+	n = last_seq[id] != UINT64_MAX && seq != last_seq[id] + 1;
+	last_seq[id] = seq;
+	return n;
+}
+
+static void check_entry(struct reader_stats *rs, struct bench_entry *e,
+			uint64_t *last_seq)
+{
+	int tag_len = sizeof(BENCH_TAG);
+
+	rs->entries++;
+	if (e->len < 1 + tag_len || memcmp(e->msg + 1, BENCH_TAG, tag_len))
+		return;
+	rs->ours++;
+
+	switch (check_msg(e->msg + 1 + tag_len, e->len - 1 - tag_len,
+			  last_seq, nr_threads)) {
+	case -1:
+		rs->torn++;
+		break;
+	case 1:
+		/* the reader was lapped and skipped ahead */
+		rs->gaps++;
+		break;
+	}
+}
+
+static void read_loop(int fd, struct reader_stats *rs, uint64_t *last_seq)
+{
+	char buf[sizeof(struct bench_entry) + ENTRY_MAX_PAYLOAD + 1];
+	int ver = 2;
+
+	if (ioctl(fd, LOGGER_SET_VERSION, &ver) < 0) {
+		perror("LOGGER_SET_VERSION");
+		exit(1);
+	}
+
+	while (!stop) {
+		if (read(fd, buf, sizeof(buf) - 1) < 0) {
+			if (errno == EAGAIN)
+				usleep(1000);
+			continue;
+		}
+		check_entry(rs, (struct bench_entry *)buf, last_seq);
+	}
+}
+
+static void copy_out(const char *data, uint64_t size, uint64_t pos,
+		     void *dst, size_t len)
+{
+	size_t off = pos & (size - 1);
+	size_t n = len < size - off ? len : size - off;
+
+	memcpy(dst, data + off, n);
+	memcpy((char *)dst + n, data, len - n);
+}
+
+static void mmap_loop(int fd, struct reader_stats *rs, uint64_t *last_seq)
+{
+	char buf[sizeof(struct bench_entry) + ENTRY_MAX_PAYLOAD + 1];
+	struct bench_entry *e = (struct bench_entry *)buf;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	long page = sysconf(_SC_PAGESIZE);
+	struct bench_ctl *ctl;
+	const char *data;
+	uint64_t size, pos = 0, w_off, next;
+	int ret;
+
+	ret = ioctl(fd, LOGGER_GET_LOG_BUF_SIZE);
+	if (ret <= 0) {
+		perror("LOGGER_GET_LOG_BUF_SIZE");
+		exit(1);
+	}
+	size = ret;
+
+	ctl = mmap(NULL, page + size, PROT_READ, MAP_SHARED, fd, 0);
+	if (ctl == MAP_FAILED || ioctl(fd, LOGGER_ADVANCE, &pos) < 0) {
+		perror("mmap");
+		exit(1);
+	}
+	data = (const char *)ctl + page;
+
+	while (!stop) {
+		w_off = __atomic_load_n(&ctl->w_off, __ATOMIC_ACQUIRE);
+		if (pos == w_off) {
+			poll(&pfd, 1, 10);
+			continue;
+		}
+
+		while (pos < w_off) {
+			copy_out(data, size, pos + ctl->hdr_off, e, sizeof(*e));
+			if (e->len > ENTRY_MAX_PAYLOAD)
+				e->len = ENTRY_MAX_PAYLOAD;
+			copy_out(data, size, pos + ctl->hdr_off + sizeof(*e),
+				 e->msg, e->len);
+			next = pos + ((ctl->hdr_off + e->hdr_size + e->len +
+				       ctl->align - 1) & ~(uint64_t)(ctl->align - 1));
+
+			/* overwritten while we copied it, resync */
+			if (__atomic_load_n(&ctl->w_head, __ATOMIC_ACQUIRE) - pos > size)
+				break;
+
+			check_entry(rs, e, last_seq);
+			pos = next;
+		}
+
+		if (ioctl(fd, LOGGER_ADVANCE, &pos) < 0) {
+			perror("LOGGER_ADVANCE");
+			exit(1);
+		}
+	}
+
+	munmap(ctl, page + size);
+}
+
+static void *reader_fn(void *arg)
+{
+	struct reader_stats *rs = arg;
+	uint64_t *last_seq;
+	int fd;
+
+	last_seq = malloc(nr_threads * sizeof(*last_seq));
+	memset(last_seq, 0xff, nr_threads * sizeof(*last_seq));
+
+	fd = open(dev, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		perror(dev);
+		exit(1);
+	}
+
+	if (with_mmap)
+		mmap_loop(fd, rs, last_seq);
+	else
+		read_loop(fd, rs, last_seq);
+
+	close(fd);
+	free(last_seq);
+	return NULL;
+}
+
+static uint64_t percentile(const uint64_t *hist, uint64_t total, double pct)
+{
+	uint64_t want = total * pct / 100, seen = 0;
+	int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen > want)
+			return 2ull << i;
+	}
+	return 2ull << (LAT_BUCKETS - 1);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d dev] [-t threads] [-s msg_bytes] [-T seconds] [-r | -m]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct reader_stats rs = { 0 };
+	pthread_t reader;
+	struct writer *w;
+	uint64_t hist[LAT_BUCKETS] = { 0 }, writes = 0, errors = 0, max_ns = 0;
+	int opt, i, j;
+
+	while ((opt = getopt(argc, argv, "d:t:s:T:rm")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 's':
+			msg_bytes = atoi(optarg);
+			break;
+		case 'T':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			with_reader = 1;
+			break;
+		case 'm':
+			with_reader = 1;
+			with_mmap = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (nr_threads < 1 || seconds < 1 || msg_bytes < 32 ||
+	    msg_bytes > ENTRY_MAX_PAYLOAD - 1 - (int)sizeof(BENCH_TAG))
+		usage(argv[0]);
+
+	w = calloc(nr_threads, sizeof(*w));
+	if (!w)
+		return 1;
+
+	if (with_reader)
+		pthread_create(&reader, NULL, reader_fn, &rs);
+	for (i = 0; i < nr_threads; i++) {
+		w[i].id = i;
+		pthread_create(&w[i].thread, NULL, writer_fn, &w[i]);
+	}
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(w[i].thread, NULL);
+		writes += w[i].writes;
+		errors += w[i].errors;
+		if (w[i].max_ns > max_ns)
+			max_ns = w[i].max_ns;
+		for (j = 0; j < LAT_BUCKETS; j++)
+			hist[j] += w[i].hist[j];
+	}
+	if (with_reader)
+		pthread_join(reader, NULL);
+
+	printf("threads %d msg %d bytes %d s\n", nr_threads, msg_bytes, seconds);
+	printf("writes %llu (%llu/s) errors %llu\n", (unsigned long long)writes,
+	       (unsigned long long)(writes / seconds), (unsigned long long)errors);
+	printf("latency ns p50 <%llu p99 <%llu p99.9 <%llu max %llu\n",
+	       (unsigned long long)percentile(hist, writes, 50),
+	       (unsigned long long)percentile(hist, writes, 99),
+	       (unsigned long long)percentile(hist, writes, 99.9),
+	       (unsigned long long)max_ns);
+	if (with_reader)
+		printf("read %llu entries, %llu ours, %llu torn, %llu gaps\n",
+		       (unsigned long long)rs.entries, (unsigned long long)rs.ours,
+		       (unsigned long long)rs.torn, (unsigned long long)rs.gaps);
+
+	free(w);
+	return rs.torn ? 2 : 0;
+}